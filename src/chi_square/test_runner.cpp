@@ -5,6 +5,8 @@
 #include <iomanip>
 
 #include "test_runner.h"
+#include "../utils/singleton.h"
+#include "../utils/thread_pool.h"
 #include "../cdfs/normal_cdf.h"
 #include "../cdfs/uniform_cdf.h"
 #include "../cdfs/exponential_cdf.h"
@@ -21,27 +23,35 @@ namespace kiv_ppr
 
     void CTest_Runner::Run()
     {
+        // Make sure that the thread pool is not NULL.
+        auto thread_pool = Singleton<CThread_Pool>::Get_Instance();
+        if (nullptr == thread_pool)
+        {
+            std::cout << "Error: thread pool is NULL" << std::endl;
+            std::exit(24);
+        }
+
         // Container for all the tests.
-        // The tests are executed in parallel.
+        // The tests are executed in parallel (by the thread pool).
         std::vector<std::future<kiv_ppr::CChi_Square::TResult>> workers;
 
         // Add normal and uniform distribution tests (they are executed always
         // regardless of the input numbers are).
-        workers.push_back(std::async(std::launch::async, &CTest_Runner::Run_Normal, this));
-        workers.push_back(std::async(std::launch::async, &CTest_Runner::Run_Uniform, this));
+        workers.push_back(thread_pool->Submit(&CTest_Runner::Run_Normal, this));
+        workers.push_back(thread_pool->Submit(&CTest_Runner::Run_Uniform, this));
 
         // If the minimum is < 0, we can tell with certainty that the
         // data does come from the exponential or poisson distribution.
         if (m_values.first_iteration.min >= 0)
         {
             // Add exponential distribution test.
-            workers.push_back(std::async(std::launch::async, &CTest_Runner::Run_Exponential, this));
+            workers.push_back(thread_pool->Submit(&CTest_Runner::Run_Exponential, this));
 
             // If the data is not made up only of integers, they do not come from
             // the poisson distribution.
             if (m_values.first_iteration.all_ints)
             {
-                workers.push_back(std::async(std::launch::async, &CTest_Runner::Run_Poisson, this));
+                workers.push_back(thread_pool->Submit(&CTest_Runner::Run_Poisson, this));
             }
         }
      
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 #include <thread>
+#include <limits>
 
 namespace kiv_ppr::config
 {
@@ -19,11 +21,53 @@ namespace kiv_ppr::config
         /// Default block size (10 MB)
         static constexpr uint32_t Block_Size_Per_Read = 1024 * 1024 * 10;
 
+        /// Smallest block claimed by a worker towards the end of the input file (64 KB), see CWork_Scheduler
+        static constexpr uint32_t Min_Block_Size_Per_Read = 1024 * 64;
+
         // Default Watchdog sleep period (5s)
         static constexpr uint32_t Watchdog_Sleep_Sec = 5;
 
         // Scale factor for all the input values
         static constexpr double Scale_Factor = 2.0;
+
+        /// Number of blocks a worker keeps in flight on an OpenCL device (copying one block overlaps with processing another)
+        static constexpr uint32_t OpenCL_Blocks_In_Flight = 2;
+
+        /// Default directory of the cache of compiled OpenCL programs
+        static constexpr const char* OpenCL_Cache_Dir = "pprsolver_cl_cache";
+
+        /// Number of compute units of an OpenCL device per command queue (worker), when the number of queues is detected
+        static constexpr uint32_t Compute_Units_Per_Queue = 16;
+
+        /// Maximum number of command queues (workers) per OpenCL device, when the number of queues is detected
+        static constexpr uint32_t Max_Queues_Per_Device = 4;
+
+        /// Number of fine bins of the auto-ranging histogram used in the single pass mode (8 MB per worker)
+        static constexpr size_t Fine_Histogram_Bins = 1024 * 1024;
+
+        /// Number of independent SIMD accumulators the CPU kernels use (so the additions do not wait for each other)
+        static constexpr size_t SIMD_Accumulators = 4;
+
+        /// Number of interleaved copies of each bin of a histogram (one per AVX-512 lane), see CHistogram::Add_Block
+        static constexpr size_t Sub_Histograms = 8;
+
+        /// Number of values the CPU kernels of the second iteration pass into the histogram at once
+        static constexpr size_t Histogram_Chunk_Size = 1024;
+
+        /// Extension of the sidecar file the statistics of an input file are cached in (see CStats_Cache)
+        static constexpr const char* Stats_Cache_Extension = ".pprstats";
+
+        /// Number of evenly spaced samples of a file hashed to detect a modification of its content (see utils::serialization::Hash_File_Samples)
+        static constexpr size_t Content_Hash_Samples = 64;
+
+        /// Size of a sample of a file hashed to detect a modification of its content (64 KB)
+        static constexpr size_t Content_Hash_Sample_Size = 1024 * 64;
+
+        /// Number of values the CPU kernels process at once when they are benchmarked (8 MB), see CCPU_Kernels::Benchmark
+        static constexpr size_t Benchmark_Count = 1024 * 1024;
+
+        /// Number of times each CPU kernel is executed when it is benchmarked
+        static constexpr uint32_t Benchmark_Repetitions = 100;
     }
     
     // Precision used when printing out double values. 
@@ -35,13 +79,63 @@ namespace kiv_ppr::config
         uint32_t number_of_threads;                ///< Number of threads used to process the file
         uint32_t number_of_elements_per_file_read; ///< Number of elements read from the file at once
         double watchdog_expiration_sec;            ///< Watchdog period
+        bool single_pass;                          ///< Read the input file only once (see CSingle_Pass)
+    };
+
+    /// Backends used to read the input file.
+    enum class NReader_Type : uint8_t
+    {
+        Stream, ///< std::ifstream (a mutex is held while reading)
+        Mmap,   ///< File mapped into the memory (zero-copy, falls back to Stream if the file cannot be mapped)
+        Async,  ///< Asynchronous reads with many requests in flight (io_uring or a pread thread pool, falls back to Stream)
+        Pread   ///< Positional reads issued by the workers themselves (no lock held, falls back to Stream)
+    };
+
+    /// Instruction sets the CPU kernels are implemented for (see CCPU_Kernels).
+    enum class NInstruction_Set : uint8_t
+    {
+        Auto,   ///< The widest instruction set supported by the CPU
+        Scalar, ///< No SIMD instructions
+        SSE42,  ///< SSE4.2 (two doubles at a time)
+        AVX2,   ///< AVX2 (four doubles at a time)
+        AVX512  ///< AVX-512 (eight doubles at a time)
+    };
+
+    /// Configuration of the file reader.
+    struct TReader_Params
+    {
+        NReader_Type type = NReader_Type::Stream; ///< Backend used to read the input file
+        uint32_t queue_depth = 8;                 ///< Maximum number of reads in flight (Async backend only)
+        uint32_t buffer_count = 0;                ///< Number of read buffers, 0 = queue depth + number of threads (Async backend only)
+        size_t memory_budget = 0;                 ///< Maximum memory held by the read buffers in bytes, 0 = unlimited (Stream and Pread backends)
+        bool huge_pages = false;                  ///< Back the read buffers by huge pages (Stream and Pread backends)
+        uint32_t reader_threads = 0;              ///< Number of dedicated reader threads, 0 = the workers read the file themselves
+        uint32_t pipeline_depth = 16;             ///< Maximum number of blocks read ahead by the dedicated reader threads
+    };
+
+    /// Configuration of the sidecar cache of the statistics calculated from the input file (see CStats_Cache).
+    struct TStats_Cache_Params
+    {
+        bool enabled = false;   ///< Flag indicating whether the cache is used
+        bool recompute = false; ///< Flag indicating whether the statistics are recalculated even if they are cached
+    };
+
+    /// Part of the input file processed in the partial mode (see CFile_Stats::Process_Part).
+    /// The bounds are rounded down to whole doubles, so adjacent parts never share a value.
+    struct TPart_Params
+    {
+        uint32_t shard_index = 0;                                 ///< Index of the shard <0; shard_count)
+        uint32_t shard_count = 1;                                 ///< Number of equally large shards the range is split into
+        uint64_t first_byte = 0;                                  ///< Offset of the first byte of the range
+        uint64_t end_byte = std::numeric_limits<uint64_t>::max(); ///< Offset past the last byte of the range (clamped to the size of the file)
     };
 
     /// Default thread settings.
     static TThread_Params default_thread_params {
         std::thread::hardware_concurrency(), // Number of threads of the CPU
         processing::Block_Size_Per_Read,
-        processing::Watchdog_Sleep_Sec
+        processing::Watchdog_Sleep_Sec,
+        false
     };
 }
 
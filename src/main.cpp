@@ -1,3 +1,6 @@
+#include <memory>
+#include <string>
+#include <vector>
 #include <iostream>
 
 #include "utils/utils.h"
@@ -5,8 +8,12 @@
 #include "utils/resource_manager.h"
 #include "utils/file_reader.h"
 #include "utils/singleton.h"
+#include "utils/thread_pool.h"
 #include "config.h"
 #include "processing/file_stats.h"
+#include "processing/program_cache.h"
+#include "processing/stats_cache.h"
+#include "processing/cpu_kernels.h"
 #include "chi_square/test_runner.h"
 
 /// Runs the program. It processes the input file and based on 
@@ -14,10 +21,17 @@
 /// the Chi-Square goodness of fit test and prints out the results.
 /// \param filename Path to the input file
 /// \param p_critical Critical P-value used in the statistical tests.
-static void Run(const char* filename, double p_critical)
+/// \param reader_params Configuration of the file reader (backend, ...)
+/// \param cache_params Configuration of the sidecar cache of the statistics (see CStats_Cache)
+/// \param append_state Path to the file holding the state of the append mode (empty = the whole file is processed)
+/// \param partial_state Path to the file the partial state of a part of the input file is stored into (empty = the tests are run)
+/// \param part Part of the input file processed in the partial mode
+static void Run(const char* filename, double p_critical, const kiv_ppr::config::TReader_Params& reader_params,
+                const kiv_ppr::config::TStats_Cache_Params& cache_params, const std::string& append_state,
+                const std::string& partial_state, const kiv_ppr::config::TPart_Params& part)
 {
     // Create a file reader.
-    kiv_ppr::CFile_Reader<double> file(filename);
+    kiv_ppr::CFile_Reader<double> file(filename, reader_params);
 
     if (file.Is_Open())
     {
@@ -29,18 +43,73 @@ static void Run(const char* filename, double p_critical)
         }
 
         // Print out information for the user.
-        std::cout << "Processing file " << file.Get_Filename() << " [" << file.Get_File_Size() << " B]" << std::endl;
+        std::cout << "Processing file " << file.Get_Filename() << " [" << file.Get_File_Size() << " B]"
+                  << " using the '" << kiv_ppr::CArg_Parser::Get_Reader_Type_Str(file.Get_Reader_Type()) << "' reader";
+        if (kiv_ppr::config::NReader_Type::Async == file.Get_Reader_Type())
+        {
+            std::cout << " (" << file.Get_Async_Engine_Str() << ", queue depth = " << reader_params.queue_depth << ")";
+        }
+        std::cout << std::endl;
 
-        // Process the input file (calculate min, max, mean, histogram, ...).
-        kiv_ppr::CFile_Stats file_stats(&file);
-        if (0 != file_stats.Process(&kiv_ppr::config::default_thread_params))
+        // The key of the input file is created before the file is processed, so a modification made meanwhile is detected.
+        std::unique_ptr<kiv_ppr::CStats_Cache> stats_cache = nullptr;
+        if (cache_params.enabled)
         {
-            std::cout << "Failed to process the input file (" << file.Get_Filename() << ")" << std::endl;
-            std::exit(1);
+            stats_cache = std::make_unique<kiv_ppr::CStats_Cache>(file.Get_Filename());
+        }
+
+        // In the partial mode, only the partial state of a part of the input file is stored (it is merged with the other parts later on).
+        if (!partial_state.empty())
+        {
+            kiv_ppr::CFile_Stats file_stats(&file);
+            if (0 != file_stats.Process_Part(&kiv_ppr::config::default_thread_params, part, partial_state))
+            {
+                std::cout << "Failed to process the input file (" << file.Get_Filename() << ")" << std::endl;
+                std::exit(1);
+            }
+            return;
+        }
+
+        // Try to reuse the statistics calculated in one of the previous runs.
+        kiv_ppr::CFile_Stats::TValues values{};
+        if (nullptr != stats_cache && !cache_params.recompute && stats_cache->Load(values))
+        {
+            std::cout << "Statistics loaded from the cache (" << stats_cache->Get_Path() << ")" << std::endl;
+        }
+        else
+        {
+            // Process the input file (calculate min, max, mean, histogram, ...), in the append mode only the data appended since the last run.
+            kiv_ppr::CFile_Stats file_stats(&file);
+            const int result = append_state.empty() ? file_stats.Process(&kiv_ppr::config::default_thread_params)
+                                                    : file_stats.Process_Appended(&kiv_ppr::config::default_thread_params, append_state);
+            if (0 != result)
+            {
+                std::cout << "Failed to process the input file (" << file.Get_Filename() << ")" << std::endl;
+                std::exit(1);
+            }
+
+            // Print out how fast the input file was read.
+            if (kiv_ppr::config::NReader_Type::Async == file.Get_Reader_Type())
+            {
+                std::cout << "Read throughput = " << file.Get_Read_Throughput() << " GB/s" << std::endl;
+            }
+            values = file_stats.Get_Values();
+
+            // Store the statistics for the next runs.
+            if (nullptr != stats_cache)
+            {
+                if (stats_cache->Store(values))
+                {
+                    std::cout << "Statistics stored into the cache (" << stats_cache->Get_Path() << ")" << std::endl;
+                }
+                else
+                {
+                    std::cout << "Failed to store the statistics into the cache (" << stats_cache->Get_Path() << ")" << std::endl;
+                }
+            }
         }
 
         // Print out the values calculated from the input file.
-        auto values = file_stats.Get_Values();
         std::cout << "\nCalculated statistics (parameters):" << std::endl;
         std::cout << values << "\n" << std::endl;
 
@@ -55,6 +124,58 @@ static void Run(const char* filename, double p_critical)
     }
 }
 
+/// Runs the program in the merge mode. It merges the partial states of parts of the input
+/// data (calculated in the partial mode, possibly on different nodes) and based on the merged
+/// statistical values, it runs the Chi-Square goodness of fit test and prints out the results.
+/// \param partial_states Paths to the files holding the partial states
+/// \param p_critical Critical P-value used in the statistical tests.
+static void Merge(const std::vector<std::string>& partial_states, double p_critical)
+{
+    // Merge the partial states (the input file is not read).
+    kiv_ppr::CFile_Stats file_stats(nullptr);
+    if (0 != file_stats.Merge_Parts(partial_states))
+    {
+        std::cout << "Failed to merge the partial states" << std::endl;
+        std::exit(1);
+    }
+    const auto values = file_stats.Get_Values();
+
+    // Print out the values calculated from the partial states.
+    std::cout << "\nCalculated statistics (parameters):" << std::endl;
+    std::cout << values << "\n" << std::endl;
+
+    // Run the statistical tests.
+    kiv_ppr::CTest_Runner test_runner(values, p_critical);
+    test_runner.Run();
+}
+
+/// Checks the CPU kernels of all instruction sets supported by the CPU against the scalar ones.
+/// \return 0, if all the kernels match the scalar ones, 1 otherwise.
+static int Test_Kernels()
+{
+    auto cpu_kernels = kiv_ppr::Singleton<kiv_ppr::CCPU_Kernels>::Get_Instance();
+    if (nullptr == cpu_kernels)
+    {
+        std::cout << "Error: CPU kernels are NULL" << std::endl;
+        std::exit(26);
+    }
+    return cpu_kernels->Test() ? 0 : 1;
+}
+
+/// Measures the throughput of the CPU kernels of all instruction sets supported by the CPU.
+/// \return 0 (the throughput is printed out)
+static int Benchmark_Kernels()
+{
+    auto cpu_kernels = kiv_ppr::Singleton<kiv_ppr::CCPU_Kernels>::Get_Instance();
+    if (nullptr == cpu_kernels)
+    {
+        std::cout << "Error: CPU kernels are NULL" << std::endl;
+        std::exit(26);
+    }
+    cpu_kernels->Benchmark(kiv_ppr::config::processing::Benchmark_Count, kiv_ppr::config::processing::Benchmark_Repetitions);
+    return 0;
+}
+
 /// Entry point of the program
 /// \param argc Number of parameters passed in from the command line
 /// \param argv Arguments from the command line
@@ -76,6 +197,16 @@ int main(int argc, char* argv[])
             arg_parser.Print_Help();
             return 0;
         }
+
+        // The CPU kernels are tested and benchmarked without any input file.
+        if (arg_parser.Should_Test_Kernels())
+        {
+            return Test_Kernels();
+        }
+        if (arg_parser.Should_Benchmark_Kernels())
+        {
+            return Benchmark_Kernels();
+        }
         arg_parser.Parse();
     }
     catch (const std::exception& e)
@@ -97,12 +228,104 @@ int main(int argc, char* argv[])
     kiv_ppr::config::default_thread_params.number_of_elements_per_file_read = arg_parser.Get_Block_Size_Per_Read();
     kiv_ppr::config::default_thread_params.watchdog_expiration_sec = arg_parser.Get_Watchdog_Sleep_Sec();
     kiv_ppr::config::default_thread_params.number_of_threads = arg_parser.Get_Number_Of_Threads();
+    kiv_ppr::config::default_thread_params.single_pass = arg_parser.Should_Use_Single_Pass();
+
+    // The single pass is executed only on the CPU.
+    if (kiv_ppr::config::default_thread_params.single_pass && arg_parser.Get_Run_Type() == kiv_ppr::CArg_Parser::NRun_Type::OpenCL_Devs)
+    {
+        std::cout << "The single pass mode is not supported on OpenCL devices - the input file will be read twice" << std::endl;
+        kiv_ppr::config::default_thread_params.single_pass = false;
+    }
+
+    // Set up the file reader.
+    kiv_ppr::config::TReader_Params reader_params;
+    reader_params.type = arg_parser.Get_Reader_Type();
+    reader_params.queue_depth = arg_parser.Get_Queue_Depth();
+    reader_params.buffer_count = arg_parser.Get_Buffer_Count();
+    reader_params.memory_budget = arg_parser.Get_Memory_Budget();
+    reader_params.huge_pages = arg_parser.Should_Use_Huge_Pages();
+    reader_params.reader_threads = arg_parser.Get_Reader_Threads();
+    reader_params.pipeline_depth = arg_parser.Get_Pipeline_Depth();
+
+    // Set up the sidecar cache of the statistics of the input file.
+    kiv_ppr::config::TStats_Cache_Params cache_params;
+    cache_params.enabled = arg_parser.Should_Use_Stats_Cache();
+    cache_params.recompute = arg_parser.Should_Recompute_Stats();
+
+    // The append mode continues the single pass from the saved state (it is executed only on the CPU).
+    const std::string append_state = arg_parser.Get_Append_State_File();
+    if (!append_state.empty())
+    {
+        if (arg_parser.Get_Run_Type() == kiv_ppr::CArg_Parser::NRun_Type::OpenCL_Devs)
+        {
+            std::cout << "The append mode is not supported on OpenCL devices - the input file will be processed on the CPU" << std::endl;
+        }
+        kiv_ppr::config::default_thread_params.single_pass = true;
+
+        // The statistics of the whole file would hide the data appended since the last run from the saved state.
+        if (cache_params.enabled)
+        {
+            std::cout << "The statistics cache is not used in the append mode" << std::endl;
+            cache_params.enabled = false;
+        }
+    }
+
+    // The partial mode stores the state of the single pass (it is executed only on the CPU).
+    const std::string partial_state = arg_parser.Get_Partial_State_File();
+    if (!partial_state.empty())
+    {
+        if (!append_state.empty())
+        {
+            std::cout << "The partial mode cannot be combined with the append mode" << std::endl;
+            return 1;
+        }
+        if (arg_parser.Get_Run_Type() == kiv_ppr::CArg_Parser::NRun_Type::OpenCL_Devs)
+        {
+            std::cout << "The partial mode is not supported on OpenCL devices - the input file will be processed on the CPU" << std::endl;
+        }
+        kiv_ppr::config::default_thread_params.single_pass = true;
+
+        // The statistics of the whole file are of no use to the partial state.
+        if (cache_params.enabled)
+        {
+            std::cout << "The statistics cache is not used in the partial mode" << std::endl;
+            cache_params.enabled = false;
+        }
+    }
+
+    // The merge mode does not read any input file.
+    const auto partial_states = arg_parser.Get_Partial_States_To_Merge();
+    if (!partial_states.empty() && (!partial_state.empty() || !append_state.empty()))
+    {
+        std::cout << "The merge mode cannot be combined with the partial mode or the append mode" << std::endl;
+        return 1;
+    }
+
+    // Select the implementation of the CPU kernels (the best one supported by the CPU unless the user forces one).
+    auto cpu_kernels = kiv_ppr::Singleton<kiv_ppr::CCPU_Kernels>::Get_Instance();
+    if (nullptr == cpu_kernels)
+    {
+        std::cout << "Error: CPU kernels are NULL" << std::endl;
+        std::exit(26);
+    }
+    if (!cpu_kernels->Select(arg_parser.Get_Instruction_Set()))
+    {
+        std::cout << "The CPU does not support the '" << kiv_ppr::CArg_Parser::Get_Instruction_Set_Str(arg_parser.Get_Instruction_Set())
+                  << "' instruction set (the best supported one is '" << kiv_ppr::CArg_Parser::Get_Instruction_Set_Str(kiv_ppr::CCPU_Kernels::Detect_Instruction_Set()) << "')" << std::endl;
+        return 1;
+    }
 
     // Print out info as to how the program is going to be executed.
     std::cout << "The program is running in '" << arg_parser.Get_Run_Type_Str() << "' mode" << std::endl;
     std::cout << "Block size per read = " << kiv_ppr::config::default_thread_params.number_of_elements_per_file_read << " [B]" << std::endl;
     std::cout << "Watchdog checkup period = " << kiv_ppr::config::default_thread_params.watchdog_expiration_sec << "s" << std::endl;
-    std::cout << "Number of threads = " << kiv_ppr::config::default_thread_params.number_of_threads << std::endl << std::endl;
+    std::cout << "Number of threads = " << kiv_ppr::config::default_thread_params.number_of_threads << std::endl;
+    std::cout << "CPU kernels = " << kiv_ppr::CArg_Parser::Get_Instruction_Set_Str(cpu_kernels->Get_Instruction_Set()) << std::endl;
+    if (0 != reader_params.reader_threads)
+    {
+        std::cout << "Dedicated reader threads = " << reader_params.reader_threads << " (pipeline depth = " << reader_params.pipeline_depth << " blocks)" << std::endl;
+    }
+    std::cout << "Passes over the input file = " << (kiv_ppr::config::default_thread_params.single_pass ? 1 : 2) << std::endl << std::endl;
     
     // Get a list of  the OpenCL devices the user wishes to use.
     const auto& listed_devs = arg_parser.Get_OpenCL_Devs();
@@ -117,14 +340,51 @@ int main(int argc, char* argv[])
     // Set the mode of the program (smp, all, ...).
     resource_manager->Set_Run_Type(arg_parser.Get_Run_Type(), arg_parser.Should_Use_GPUs_Only());
 
+    // Set how many workers can feed one OpenCL device and how CPU OpenCL devices are partitioned.
+    resource_manager->Set_Device_Slots(arg_parser.Get_Queues_Per_Device(), arg_parser.Get_CPU_Sub_Devices());
+
     // Check out the availability of the listed OpenCL devices.
     resource_manager->Find_Available_GPUs(listed_devs);
 
+    // Set up the cache of compiled OpenCL programs (it is only used when there is an OpenCL device).
+    auto program_cache = kiv_ppr::Singleton<kiv_ppr::CProgram_Cache>::Get_Instance();
+    if (nullptr == program_cache)
+    {
+        std::cout << "Error: program cache is NULL" << std::endl;
+        std::exit(25);
+    }
+    program_cache->Set_Directory(arg_parser.Get_OpenCL_Cache_Dir());
+
+    // Create the threads shared by both iterations and the statistical tests up front.
+    auto thread_pool = kiv_ppr::Singleton<kiv_ppr::CThread_Pool>::Get_Instance();
+    if (nullptr == thread_pool)
+    {
+        std::cout << "Error: thread pool is NULL" << std::endl;
+        std::exit(24);
+    }
+
+    // The workers feeding OpenCL devices need threads of their own (see CResource_Manager::Get_Number_Of_Workers).
+    thread_pool->Ensure_Threads(resource_manager->Get_Number_Of_Workers(kiv_ppr::config::default_thread_params.number_of_threads));
+
     // Run the program.
     const auto seconds = kiv_ppr::utils::Time_Call([&]() {
-        Run(arg_parser.Get_Filename(), p_critical);
+        if (!partial_states.empty())
+        {
+            Merge(partial_states, p_critical);
+        }
+        else
+        {
+            Run(arg_parser.Get_Filename(), p_critical, reader_params, cache_params, append_state, partial_state, arg_parser.Get_Part());
+        }
     });
 
+    // Print out how many OpenCL programs did not have to be compiled.
+    if (0 != program_cache->Get_Hits() + program_cache->Get_Misses())
+    {
+        std::cout << "\nOpenCL programs loaded from the cache = " << program_cache->Get_Hits()
+                  << ", compiled = " << program_cache->Get_Misses() << std::endl;
+    }
+
     // Print out how much time it took to process the input file a run the statistical tests.
     std::cout << "\nTime of execution: " << seconds << " sec" << std::endl;
 
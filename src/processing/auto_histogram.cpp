@@ -0,0 +1,393 @@
+#include <algorithm>
+
+#include "auto_histogram.h"
+#include "../utils/utils.h"
+
+namespace kiv_ppr
+{
+    /// Shifts a global index to a coarser level (floor(index / 2^shift)).
+    /// Since C++20, >> on a signed integer is an arithmetic shift (rounds towards -inf).
+    /// \param index Global index
+    /// \param shift Number of levels
+    /// \return Global index at the coarser level
+    static int64_t Shift_Down(int64_t index, int shift) noexcept
+    {
+        if (shift >= 63)
+        {
+            return index < 0 ? -1 : 0;
+        }
+        return index >> shift;
+    }
+
+    CAuto_Histogram::CAuto_Histogram(size_t number_of_bins)
+        : m_bins(number_of_bins, 0),
+          m_exponent(0),
+          m_inverse_width(1.0),
+          m_start(0),
+          m_occupied_lo(0),
+          m_occupied_hi(0),
+          m_initialized(false),
+          m_count{},
+          m_max(std::numeric_limits<double>::lowest()),
+          m_max_count{}
+    {
+
+    }
+
+    void CAuto_Histogram::Fit(double min, double max)
+    {
+        if (m_initialized)
+        {
+            // Make the bins wide enough, so the edges stay exact.
+            while (!Is_Representable(min) || !Is_Representable(max))
+            {
+                Level_Up();
+            }
+            Include(Get_Global_Index(min), Get_Global_Index(max));
+            return;
+        }
+
+        const auto number_of_bins = static_cast<int64_t>(m_bins.size());
+
+        // Estimate the bin width from the magnitude of the values and from the span of the
+        // interval (the span is calculated from halves, so it does not overflow).
+        int exponent = Min_Exponent;
+        const double max_abs = std::max(std::fabs(min), std::fabs(max));
+        const double half_span = max / 2 - min / 2;
+        if (max_abs > 0)
+        {
+            exponent = std::max(exponent, std::ilogb(max_abs) - 51);
+        }
+        if (half_span > 0)
+        {
+            exponent = std::max(exponent, std::ilogb(half_span) + 2 - std::ilogb(static_cast<double>(number_of_bins)));
+        }
+        Set_Exponent(exponent);
+
+        // Make sure the estimation holds.
+        while (!Is_Representable(min) || !Is_Representable(max) ||
+               Get_Global_Index(max) - Get_Global_Index(min) >= number_of_bins)
+        {
+            Set_Exponent(m_exponent + 1);
+        }
+
+        // Center the window around the values.
+        m_occupied_lo = Get_Global_Index(min);
+        m_occupied_hi = Get_Global_Index(max);
+        m_start = m_occupied_lo - (number_of_bins - 1 - (m_occupied_hi - m_occupied_lo)) / 2;
+        m_initialized = true;
+    }
+
+    void CAuto_Histogram::Add(double value)
+    {
+        Fit(value, value);
+        Add_Fitted(value);
+    }
+
+    void CAuto_Histogram::operator+=(const CAuto_Histogram& other)
+    {
+        // There is nothing to merge.
+        if (!other.m_initialized)
+        {
+            return;
+        }
+        if (!m_initialized)
+        {
+            *this = other;
+            return;
+        }
+
+        // Both histograms have to have the same bin width (the coarser one).
+        while (m_exponent < other.m_exponent)
+        {
+            Level_Up();
+        }
+
+        // Make sure the window covers all values of the other histogram.
+        Include(Shift_Down(other.m_occupied_lo, m_exponent - other.m_exponent),
+                Shift_Down(other.m_occupied_hi, m_exponent - other.m_exponent));
+
+        // Merge the bins.
+        const int shift = m_exponent - other.m_exponent;
+        const size_t size = other.m_bins.size();
+        for (size_t i = 0; i < size; ++i)
+        {
+            if (0 != other.m_bins[i])
+            {
+                const int64_t global_index = Shift_Down(other.m_start + static_cast<int64_t>(i), shift);
+                m_bins[static_cast<size_t>(global_index - m_start)] += other.m_bins[i];
+            }
+        }
+
+        // Update the number of values stored in the histogram.
+        m_count += other.m_count;
+
+        // Update the maximum and the number of its occurrences.
+        if (other.m_max > m_max)
+        {
+            m_max = other.m_max;
+            m_max_count = other.m_max_count;
+        }
+        else if (other.m_max == m_max)
+        {
+            m_max_count += other.m_max_count;
+        }
+    }
+
+    bool CAuto_Histogram::Rebin(CHistogram& histogram, double divisor, double min, bool all_ints) const
+    {
+        // There is nothing to rebin.
+        if (!m_initialized)
+        {
+            return true;
+        }
+
+        // Place the occurrences of the maximum.
+        if (!histogram.Add(histogram.Get_Slot(m_max / divisor), m_max_count))
+        {
+            return false;
+        }
+
+        const double width = std::ldexp(1.0, m_exponent);
+        const size_t size = m_bins.size();
+        const int64_t max_global_index = Get_Global_Index(m_max);
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            const auto global_index = m_start + static_cast<int64_t>(i);
+
+            // The occurrences of the maximum have already been placed.
+            const size_t count = m_bins[i] - (global_index == max_global_index ? m_max_count : 0);
+            if (0 == count)
+            {
+                continue;
+            }
+
+            // Edges of the fine bin and the range of values it may actually hold (the maximum is excluded).
+            const double lo = std::ldexp(static_cast<double>(global_index), m_exponent);
+            const double hi = std::ldexp(static_cast<double>(global_index + 1), m_exponent);
+            const double first = std::max(lo, min);
+            const double last = std::min(std::nextafter(hi, lo), std::nextafter(m_max, lo));
+
+            size_t slot = histogram.Get_Slot(first / divisor);
+            if (slot != histogram.Get_Slot(last / divisor))
+            {
+                // The fine bin spans two intervals.
+                if (all_ints && m_exponent <= 0 && std::ceil(lo) < hi)
+                {
+                    // The only integer the bin can hold.
+                    slot = histogram.Get_Slot(std::ceil(lo) / divisor);
+                }
+                else
+                {
+                    // Use the center of the bin.
+                    slot = histogram.Get_Slot(std::clamp(lo + width / 2, first, last) / divisor);
+                }
+            }
+
+            if (!histogram.Add(slot, count))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    size_t CAuto_Histogram::Get_Total_Count() const noexcept
+    {
+        return m_count;
+    }
+
+    void CAuto_Histogram::Serialize(std::string& data) const
+    {
+        using utils::serialization::Append;
+
+        Append(data, static_cast<uint64_t>(m_bins.size()));
+        Append(data, static_cast<uint8_t>(m_initialized ? 1 : 0));
+        Append(data, static_cast<int32_t>(m_exponent));
+        Append(data, m_start);
+        Append(data, m_occupied_lo);
+        Append(data, m_occupied_hi);
+        Append(data, static_cast<uint64_t>(m_count));
+        Append(data, m_max);
+        Append(data, static_cast<uint64_t>(m_max_count));
+
+        // The bins outside the occupied range are all empty.
+        if (m_initialized)
+        {
+            for (int64_t index = m_occupied_lo; index <= m_occupied_hi; ++index)
+            {
+                Append(data, static_cast<uint64_t>(m_bins[static_cast<size_t>(index - m_start)]));
+            }
+        }
+    }
+
+    bool CAuto_Histogram::Deserialize(const std::string& data, size_t& offset)
+    {
+        using utils::serialization::Extract;
+
+        uint64_t number_of_bins = 0;
+        uint8_t initialized = 0;
+        int32_t exponent = 0;
+        int64_t start = 0;
+        int64_t occupied_lo = 0;
+        int64_t occupied_hi = 0;
+        uint64_t count = 0;
+        double max = 0;
+        uint64_t max_count = 0;
+
+        size_t position = offset;
+        if (!Extract(data, position, number_of_bins) ||
+            !Extract(data, position, initialized) ||
+            !Extract(data, position, exponent) ||
+            !Extract(data, position, start) ||
+            !Extract(data, position, occupied_lo) ||
+            !Extract(data, position, occupied_hi) ||
+            !Extract(data, position, count) ||
+            !Extract(data, position, max) ||
+            !Extract(data, position, max_count))
+        {
+            return false;
+        }
+
+        // The window has to hold at least two bins (they are merged pairwise) and the bin width has to be valid.
+        if (number_of_bins < 2 || 0 != number_of_bins % 2 || number_of_bins > static_cast<uint64_t>(Max_Global_Index) ||
+            exponent < Min_Exponent || exponent > std::numeric_limits<double>::max_exponent)
+        {
+            return false;
+        }
+
+        std::vector<size_t> bins;
+        if (0 != initialized)
+        {
+            // The occupied range has to lie within the window and all its bins have to be stored.
+            if (occupied_lo > occupied_hi || occupied_lo < start || occupied_hi - start >= static_cast<int64_t>(number_of_bins) ||
+                static_cast<uint64_t>(occupied_hi - occupied_lo + 1) > (data.size() - position) / sizeof(uint64_t))
+            {
+                return false;
+            }
+
+            bins.resize(static_cast<size_t>(number_of_bins), 0);
+            uint64_t total_count = 0;
+            for (int64_t index = occupied_lo; index <= occupied_hi; ++index)
+            {
+                uint64_t value = 0;
+                if (!Extract(data, position, value))
+                {
+                    return false;
+                }
+                bins[static_cast<size_t>(index - start)] = static_cast<size_t>(value);
+                total_count += value;
+            }
+
+            // Each value is counted in exactly one bin.
+            if (total_count != count || max_count > count)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            // An empty histogram does not hold any values.
+            if (0 != count)
+            {
+                return false;
+            }
+            bins.resize(static_cast<size_t>(number_of_bins), 0);
+        }
+
+        m_bins.swap(bins);
+        Set_Exponent(exponent);
+        m_start = start;
+        m_occupied_lo = occupied_lo;
+        m_occupied_hi = occupied_hi;
+        m_initialized = 0 != initialized;
+        m_count = static_cast<size_t>(count);
+        m_max = max;
+        m_max_count = static_cast<size_t>(max_count);
+        offset = position;
+
+        return true;
+    }
+
+    int64_t CAuto_Histogram::Get_Global_Index(double value) const noexcept
+    {
+        return static_cast<int64_t>(std::floor(value * m_inverse_width));
+    }
+
+    bool CAuto_Histogram::Is_Representable(double value) const noexcept
+    {
+        return std::fabs(value * m_inverse_width) < Max_Global_Index;
+    }
+
+    void CAuto_Histogram::Include(int64_t lo, int64_t hi)
+    {
+        const auto number_of_bins = static_cast<int64_t>(m_bins.size());
+
+        while (true)
+        {
+            const int64_t new_lo = std::min(lo, m_occupied_lo);
+            const int64_t new_hi = std::max(hi, m_occupied_hi);
+
+            // The window already covers the indexes.
+            if (new_lo >= m_start && new_hi < m_start + number_of_bins)
+            {
+                m_occupied_lo = new_lo;
+                m_occupied_hi = new_hi;
+                return;
+            }
+
+            // The indexes fit into the window, so we only need to shift it (and center it).
+            if (new_hi - new_lo < number_of_bins)
+            {
+                const int64_t new_start = new_lo - (number_of_bins - 1 - (new_hi - new_lo)) / 2;
+                std::vector<size_t> bins(m_bins.size(), 0);
+                for (int64_t index = m_occupied_lo; index <= m_occupied_hi; ++index)
+                {
+                    bins[static_cast<size_t>(index - new_start)] = m_bins[static_cast<size_t>(index - m_start)];
+                }
+                m_bins.swap(bins);
+                m_start = new_start;
+                m_occupied_lo = new_lo;
+                m_occupied_hi = new_hi;
+                return;
+            }
+
+            // Double the bin width and try again.
+            Level_Up();
+            lo = Shift_Down(lo, 1);
+            hi = Shift_Down(hi, 1);
+        }
+    }
+
+    void CAuto_Histogram::Level_Up()
+    {
+        const int64_t new_start = Shift_Down(m_start, 1);
+        const size_t size = m_bins.size();
+        std::vector<size_t> bins(size, 0);
+
+        // Merge the bins pairwise.
+        for (size_t i = 0; i < size; ++i)
+        {
+            if (0 != m_bins[i])
+            {
+                bins[static_cast<size_t>(Shift_Down(m_start + static_cast<int64_t>(i), 1) - new_start)] += m_bins[i];
+            }
+        }
+
+        m_bins.swap(bins);
+        m_start = new_start;
+        m_occupied_lo = Shift_Down(m_occupied_lo, 1);
+        m_occupied_hi = Shift_Down(m_occupied_hi, 1);
+        Set_Exponent(m_exponent + 1);
+    }
+
+    void CAuto_Histogram::Set_Exponent(int exponent) noexcept
+    {
+        m_exponent = exponent;
+        m_inverse_width = std::ldexp(1.0, -exponent);
+    }
+}
+
+// EOF
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+
+#include "histogram.h"
+
+namespace kiv_ppr
+{
+    /// \author Jakub Silhavy
+    ///
+    /// This class represents a fine-grained histogram that does not need to know
+    /// the minimum and maximum of the input data up front. Bins have a width of 2^e
+    /// and lie on a global grid ([g * 2^e; (g + 1) * 2^e)), of which the histogram holds
+    /// a window of consecutive bins. When a value falls out of the window, the window
+    /// is shifted or the bins are merged pairwise (the width doubles). Because of the global
+    /// grid, two histograms can always be merged without losing any information.
+    /// At the end, the histogram is rebinned into the layout used by the Chi-Square test (CHistogram).
+    class CAuto_Histogram
+    {
+    public:
+        /// Creates an instance of the class.
+        /// \param number_of_bins Number of fine bins the histogram holds (must be an even number).
+        explicit CAuto_Histogram(size_t number_of_bins);
+
+        /// Default destructor.
+        ~CAuto_Histogram() = default;
+
+        /// Makes sure that values from the interval <min; max> can be added into
+        /// the histogram using Add_Fitted. If the histogram is empty, it sets up its initial range.
+        /// \param min Minimum of the values that are going to be added
+        /// \param max Maximum of the values that are going to be added
+        void Fit(double min, double max);
+
+        /// Adds a number into the histogram. The number must fall into the range
+        /// given to the last call of Fit (the range is not checked).
+        /// \param value Value to be added into the histogram
+        inline void Add_Fitted(double value) noexcept
+        {
+            const auto global_index = static_cast<int64_t>(std::floor(value * m_inverse_width));
+            ++m_bins[static_cast<size_t>(global_index - m_start)];
+            ++m_count;
+
+            // The maximum has an interval of its own in CHistogram, so we need to know how many times it occurs.
+            if (value >= m_max)
+            {
+                if (value > m_max)
+                {
+                    m_max = value;
+                    m_max_count = 0;
+                }
+                ++m_max_count;
+            }
+        }
+
+        /// Adds a number into the histogram (the range of the histogram is adjusted if needed).
+        /// \param value Value to be added into the histogram
+        void Add(double value);
+
+        /// Merges another histogram into this one.
+        /// \param other Other histogram to be merged into this one.
+        void operator+=(const CAuto_Histogram& other);
+
+        /// Rebins the histogram into the layout used by the Chi-Square test. A fine bin is
+        /// added into the interval (bin) all of its values fall into. The occurrences of the maximum are placed exactly. If a fine bin spans two intervals,
+        /// the following rules apply: if all values are integers and the fine bin is at most 1 wide, it holds
+        /// only one integer, so the bin is still placed exactly. Otherwise, the bin is placed by its center,
+        /// which is the only source of inaccuracy (at most one fine bin per interval boundary).
+        /// \param histogram Destination histogram (its parameters have to be already set up)
+        /// \param divisor Value each number is divided by before it is placed into the destination histogram
+        /// \param min Minimum of all values in the histogram (before the division)
+        /// \param all_ints Flag indicating whether all values in the histogram are integers
+        /// \return true, if all went well, false otherwise.
+        [[nodiscard]] bool Rebin(CHistogram& histogram, double divisor, double min, bool all_ints) const;
+
+        /// Returns the total number of values inserted into the histogram.
+        /// \return Number of values stored in the histogram
+        [[nodiscard]] size_t Get_Total_Count() const noexcept;
+
+        /// Appends the histogram to a sequence of bytes (e.g. so it can be merged in another run).
+        /// Only the occupied bins of the window are stored.
+        /// \param data Sequence of bytes the histogram is appended to
+        void Serialize(std::string& data) const;
+
+        /// Restores the histogram from a sequence of bytes (see Serialize). The number of bins is taken from the data.
+        /// \param data Sequence of bytes
+        /// \param offset Position of the histogram within the data (it is moved past the histogram)
+        /// \return true, if the histogram has been restored, false, if the data is not valid (the histogram is left untouched).
+        [[nodiscard]] bool Deserialize(const std::string& data, size_t& offset);
+
+    private:
+        /// Returns the index of a value on the global grid (at the current bin width).
+        /// \param value Value
+        /// \return Global index of the bin the value falls into
+        [[nodiscard]] int64_t Get_Global_Index(double value) const noexcept;
+
+        /// Returns whether the global index of a value can be safely represented
+        /// at the current bin width (so the bin edges are exact doubles).
+        /// \param value Value
+        /// \return true, if the value can be placed at the current bin width, false otherwise.
+        [[nodiscard]] bool Is_Representable(double value) const noexcept;
+
+        /// Makes sure the window covers the global indexes <lo; hi> (at the current bin width).
+        /// If it cannot be done by shifting the window, the bin width is doubled.
+        /// \param lo Lowest global index
+        /// \param hi Highest global index
+        void Include(int64_t lo, int64_t hi);
+
+        /// Doubles the bin width (merges the bins pairwise).
+        void Level_Up();
+
+        /// Sets the bin width to 2^exponent.
+        /// \param exponent Exponent of the bin width
+        void Set_Exponent(int exponent) noexcept;
+
+    private:
+        /// Smallest exponent of the bin width (so 2^-e does not overflow).
+        static constexpr int Min_Exponent = -1000;
+
+        /// Biggest magnitude of a global index (so the bin edges are exact doubles).
+        static constexpr double Max_Global_Index = 4503599627370496.0; // 2^52
+
+    private:
+        std::vector<size_t> m_bins; ///< Fine bins (window on the global grid)
+        int m_exponent;             ///< Exponent of the bin width (2^e)
+        double m_inverse_width;     ///< 1 / bin width (2^-e)
+        int64_t m_start;            ///< Global index of the first bin of the window
+        int64_t m_occupied_lo;      ///< Lowest global index that may hold a value
+        int64_t m_occupied_hi;      ///< Highest global index that may hold a value
+        bool m_initialized;         ///< Flag indicating whether the range of the histogram has been set up
+        size_t m_count;             ///< Total number of values inserted into the histogram
+        double m_max;               ///< Maximum of all values inserted into the histogram
+        size_t m_max_count;         ///< Number of occurrences of the maximum
+    };
+}
+
+// EOF
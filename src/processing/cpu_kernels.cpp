@@ -0,0 +1,439 @@
+#include <bit>
+#include <cmath>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <vector>
+#include <utility>
+#include <iostream>
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+    #include <immintrin.h>
+#else
+    #include <cpuid.h>
+#endif
+
+#include "cpu_kernels.h"
+#include "second_iteration.h"
+#include "../utils/arg_parser.h"
+
+namespace kiv_ppr::kernels::cpu
+{
+    void Add_Lanes(TBlock_Sum& block_sum, const double* sums, const double* compensations, const double* counts, size_t lanes) noexcept
+    {
+        for (size_t i = 0; i < lanes; ++i)
+        {
+            Add_Compensated(block_sum.sum, block_sum.compensation, sums[i]);
+            Add_Compensated(block_sum.sum, block_sum.compensation, compensations[i]);
+            block_sum.count += static_cast<size_t>(counts[i]);
+        }
+    }
+
+    double Get_Mean(const TBlock_Sum& block_sum, double multiplier) noexcept
+    {
+        if (0 == block_sum.count)
+        {
+            return 0.0;
+        }
+
+        // Divide the sum first, so undoing the multiplier does not overflow.
+        return (block_sum.sum + block_sum.compensation) / static_cast<double>(block_sum.count) / config::processing::Scale_Factor / multiplier;
+    }
+
+    double Get_Overflow_Multiplier(size_t count) noexcept
+    {
+        return std::ldexp(1.0, -static_cast<int>(std::bit_width(count)));
+    }
+}
+
+namespace kiv_ppr
+{
+    CCPU_Kernels::CCPU_Kernels() noexcept
+        : m_instruction_set(config::NInstruction_Set::Scalar),
+          m_first_iteration(kernels::cpu::scalar::First_Iteration),
+          m_second_iteration(kernels::cpu::scalar::Second_Iteration),
+          m_histogram(kernels::cpu::scalar::Histogram),
+          m_add_counts(kernels::cpu::scalar::Add_Counts)
+    {
+        (void)Select(config::NInstruction_Set::Auto);
+    }
+
+    bool CCPU_Kernels::Select(config::NInstruction_Set instruction_set) noexcept
+    {
+        const auto supported = Detect_Instruction_Set();
+        if (config::NInstruction_Set::Auto == instruction_set)
+        {
+            instruction_set = supported;
+        }
+
+        // The instruction sets are ordered, so each of them includes all the previous ones.
+        if (instruction_set > supported)
+        {
+            return false;
+        }
+
+        switch (instruction_set)
+        {
+            case config::NInstruction_Set::SSE42:
+                m_first_iteration = kernels::cpu::sse42::First_Iteration;
+                m_second_iteration = kernels::cpu::sse42::Second_Iteration;
+                m_histogram = kernels::cpu::sse42::Histogram;
+                m_add_counts = kernels::cpu::sse42::Add_Counts;
+                break;
+
+            case config::NInstruction_Set::AVX2:
+                m_first_iteration = kernels::cpu::avx2::First_Iteration;
+                m_second_iteration = kernels::cpu::avx2::Second_Iteration;
+                m_histogram = kernels::cpu::avx2::Histogram;
+                m_add_counts = kernels::cpu::avx2::Add_Counts;
+                break;
+
+            case config::NInstruction_Set::AVX512:
+                m_first_iteration = kernels::cpu::avx512::First_Iteration;
+                m_second_iteration = kernels::cpu::avx512::Second_Iteration;
+                m_histogram = kernels::cpu::avx512::Histogram;
+                m_add_counts = kernels::cpu::avx512::Add_Counts;
+                break;
+
+            case config::NInstruction_Set::Scalar: [[fallthrough]];
+            default:
+                instruction_set = config::NInstruction_Set::Scalar;
+                m_first_iteration = kernels::cpu::scalar::First_Iteration;
+                m_second_iteration = kernels::cpu::scalar::Second_Iteration;
+                m_histogram = kernels::cpu::scalar::Histogram;
+                m_add_counts = kernels::cpu::scalar::Add_Counts;
+                break;
+        }
+
+        m_instruction_set = instruction_set;
+        return true;
+    }
+
+    config::NInstruction_Set CCPU_Kernels::Get_Instruction_Set() const noexcept
+    {
+        return m_instruction_set;
+    }
+
+    CFirst_Iteration::TValues CCPU_Kernels::First_Iteration(const double* data, size_t count, bool check_all_ints) const noexcept
+    {
+        return m_first_iteration(data, count, check_all_ints);
+    }
+
+    double CCPU_Kernels::Second_Iteration(const double* data, size_t count, const kernels::cpu::TSecond_Iteration_Params& params, CHistogram& histogram) const
+    {
+        return m_second_iteration(data, count, params, histogram);
+    }
+
+    void CCPU_Kernels::Histogram(std::span<const double> values, std::span<const uint8_t> mask, const CHistogram::TBinning& binning, size_t* sub_histograms) const noexcept
+    {
+        m_histogram(values, mask, binning, sub_histograms);
+    }
+
+    size_t CCPU_Kernels::Add_Counts(size_t* dest, const size_t* src, size_t count) const noexcept
+    {
+        return m_add_counts(dest, src, count);
+    }
+
+    void CCPU_Kernels::Benchmark(size_t count, uint32_t repetitions)
+    {
+        // Normally distributed values (they are not integers and some of them are negative, so the values are scaled down).
+        std::vector<double> data(count);
+        std::mt19937_64 generator(count);
+        std::normal_distribution<double> distribution(0.0, 1.0);
+        for (auto& value : data)
+        {
+            value = distribution(generator);
+        }
+
+        const CHistogram::TParams histogram_params{ -10.0, 10.0, CSecond_Iteration::Calculate_Number_Of_Intervals(count) };
+        const double gigabytes = static_cast<double>(count * sizeof(double) * repetitions) / (1024.0 * 1024.0 * 1024.0);
+
+        // Returns the throughput of a kernel in GB/s.
+        const auto Measure = [&](const auto& kernel) {
+            const auto start_time = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < repetitions; ++i)
+            {
+                kernel();
+            }
+            const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start_time;
+            return gigabytes / seconds.count();
+        };
+
+        const auto instruction_set = m_instruction_set;
+        for (const auto benchmarked_set : { config::NInstruction_Set::Scalar, config::NInstruction_Set::SSE42, config::NInstruction_Set::AVX2, config::NInstruction_Set::AVX512 })
+        {
+            if (!Select(benchmarked_set))
+            {
+                continue;
+            }
+
+            const double all_ints = Measure([&]() { (void)First_Iteration(data.data(), count, true); });
+            const double no_ints = Measure([&]() { (void)First_Iteration(data.data(), count, false); });
+            const double scaled = Measure([&]() {
+                CHistogram histogram(histogram_params);
+                (void)Second_Iteration(data.data(), count, { 0.0, true, static_cast<double>(count) - 1 }, histogram);
+            });
+            const double not_scaled = Measure([&]() {
+                CHistogram histogram(histogram_params);
+                (void)Second_Iteration(data.data(), count, { 0.0, false, static_cast<double>(count) - 1 }, histogram);
+            });
+
+            std::cout << CArg_Parser::Get_Instruction_Set_Str(benchmarked_set) << ": "
+                      << "first iteration = " << all_ints << " GB/s (" << no_ints << " GB/s without the integer check), "
+                      << "second iteration = " << scaled << " GB/s (" << not_scaled << " GB/s without scaling)" << std::endl;
+        }
+        (void)Select(instruction_set);
+    }
+
+    bool CCPU_Kernels::Test()
+    {
+        // Relative difference allowed between the sums calculated in a different order (by the SIMD lanes).
+        static constexpr double Tolerance = 1e-9;
+
+        // Number of intervals of the tested histograms (it is not a multiple of any SIMD width).
+        static constexpr size_t Number_Of_Intervals = 37;
+
+        // Lengths of the blocks, each of the bases is followed by all the tails a SIMD loop can leave behind.
+        std::vector<size_t> counts;
+        for (const size_t base : { size_t{ 0 }, size_t{ 64 }, config::processing::Histogram_Chunk_Size })
+        {
+            for (size_t tail = 0; tail < 16; ++tail)
+            {
+                counts.push_back(base + tail);
+            }
+        }
+        const size_t max_count = counts.back();
+
+        std::mt19937_64 generator(max_count);
+        std::uniform_real_distribution<double> real_distribution(-1000.0, 1000.0);
+        std::uniform_int_distribution<int> int_distribution(-1000, 1000);
+
+        // Values that are not valid doubles (see utils::Is_Valid_Double) mixed with the edge cases of the valid ones.
+        static constexpr double Special_Values[] = {
+            std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+            std::numeric_limits<double>::denorm_min(), -1e-310, 0.0, -0.0, std::numeric_limits<double>::min(), -std::numeric_limits<double>::max()
+        };
+
+        // Data the kernels are tested on (the first max_count values are used).
+        std::vector<std::pair<const char*, std::vector<double>>> data_sets;
+        const auto Add_Data_Set = [&](const char* name, const auto& generate_value) {
+            std::vector<double> data(max_count);
+            for (size_t i = 0; i < max_count; ++i)
+            {
+                data[i] = generate_value(i);
+            }
+            data_sets.emplace_back(name, std::move(data));
+        };
+        Add_Data_Set("integers", [&](size_t) { return static_cast<double>(int_distribution(generator)); });
+        Add_Data_Set("non-integers", [&](size_t) { return real_distribution(generator); });
+        Add_Data_Set("integers followed by a non-integer", [&](size_t i) {
+            return static_cast<double>(int_distribution(generator)) + (6 == i % 7 ? 0.5 : 0.0);
+        });
+        Add_Data_Set("special values", [&](size_t i) {
+            return 0 == i % 2 ? Special_Values[(i / 2) % std::size(Special_Values)] : real_distribution(generator);
+        });
+        Add_Data_Set("overflowing sum", [&](size_t i) {
+            return (4 == i % 5 ? -1.0 : 0.5) * std::numeric_limits<double>::max() * (1.0 + std::abs(real_distribution(generator)) / 1000.0) / 2.0;
+        });
+        Add_Data_Set("no valid values", [&](size_t i) { return Special_Values[i % 4]; });
+
+        // Flags of the values counted by the histogram kernel and the counts added up by Add_Counts (they may wrap around).
+        std::vector<uint8_t> mask(max_count);
+        std::vector<size_t> src_counts(max_count);
+        std::vector<size_t> dest_counts(max_count);
+        for (size_t i = 0; i < max_count; ++i)
+        {
+            mask[i] = static_cast<uint8_t>(generator() & 1);
+            src_counts[i] = static_cast<size_t>(0 == i % 3 ? generator() : generator() % 1000);
+            dest_counts[i] = static_cast<size_t>(generator());
+        }
+
+        // Outputs of all the kernels run on a block of data.
+        struct TResults
+        {
+            CFirst_Iteration::TValues first_iteration[2]; // Indexed by check_all_ints
+            double var[2]{};                              // Indexed by scale_down
+            std::vector<size_t> intervals[2];             // Indexed by scale_down
+            std::vector<size_t> sub_histograms;
+            std::vector<size_t> counts;
+            size_t total = 0;
+        };
+
+        // Runs the selected kernels on a block of data.
+        const auto Run_Kernels = [&](const double* data, size_t count) {
+            TResults results;
+            for (const bool check_all_ints : { false, true })
+            {
+                results.first_iteration[check_all_ints] = First_Iteration(data, count, check_all_ints);
+            }
+
+            // The histogram covers most of the values, so they are spread over the intervals (the rest is clamped).
+            const double mean = results.first_iteration[0].mean;
+            for (const bool scale_down : { false, true })
+            {
+                const double scale = scale_down ? config::processing::Scale_Factor : 1.0;
+                CHistogram histogram({ -1000.0 / scale, 1000.0 / scale, Number_Of_Intervals });
+                results.var[scale_down] = Second_Iteration(data, count, { mean * config::processing::Scale_Factor / scale, scale_down, count > 1 ? static_cast<double>(count - 1) : 1.0 }, histogram);
+                for (size_t i = 0; i < histogram.Get_Number_Of_Intervals(); ++i)
+                {
+                    results.intervals[scale_down].push_back(histogram.at(i));
+                }
+            }
+
+            const CHistogram histogram({ -1000.0, 1000.0, Number_Of_Intervals });
+            results.sub_histograms.resize(histogram.Get_Number_Of_Intervals() * config::processing::Sub_Histograms, 0);
+            Histogram({ data, count }, { mask.data(), count }, histogram.Get_Binning(), results.sub_histograms.data());
+
+            results.counts.assign(dest_counts.begin(), dest_counts.begin() + static_cast<std::ptrdiff_t>(count));
+            results.total = Add_Counts(results.counts.data(), src_counts.data(), count);
+
+            return results;
+        };
+
+        const auto Is_Close = [](double a, double b) {
+            return a == b || (std::isnan(a) && std::isnan(b)) || std::fabs(a - b) <= Tolerance * std::max(std::fabs(a), std::fabs(b));
+        };
+
+        const auto Is_Same = [&](const CFirst_Iteration::TValues& a, const CFirst_Iteration::TValues& b) {
+            return a.min == b.min && a.max == b.max && a.count == b.count && a.all_ints == b.all_ints && Is_Close(a.mean, b.mean);
+        };
+
+        std::cout << "Testing the CPU kernels against the scalar ones (" << data_sets.size() << " data sets, " << counts.size() << " block lengths)" << std::endl;
+
+        const auto instruction_set = m_instruction_set;
+        size_t total_mismatches = 0;
+        for (const auto tested_set : { config::NInstruction_Set::SSE42, config::NInstruction_Set::AVX2, config::NInstruction_Set::AVX512 })
+        {
+            if (!Select(tested_set))
+            {
+                std::cout << CArg_Parser::Get_Instruction_Set_Str(tested_set) << ": not supported by the CPU" << std::endl;
+                continue;
+            }
+
+            size_t mismatches = 0;
+            const auto Report = [&](const char* kernel, const char* data_set, size_t count, const char* detail) {
+                std::cout << CArg_Parser::Get_Instruction_Set_Str(tested_set) << ": " << kernel << " differs from the scalar kernel"
+                          << " (data = " << data_set << ", count = " << count << detail << ")" << std::endl;
+                ++mismatches;
+            };
+
+            for (const auto& [name, data] : data_sets)
+            {
+                for (const size_t count : counts)
+                {
+                    // The scalar kernels are selected for the reference, so the second iteration uses the scalar histogram kernel too.
+                    (void)Select(config::NInstruction_Set::Scalar);
+                    const auto expected = Run_Kernels(data.data(), count);
+                    (void)Select(tested_set);
+                    const auto actual = Run_Kernels(data.data(), count);
+
+                    for (const bool check_all_ints : { false, true })
+                    {
+                        if (!Is_Same(expected.first_iteration[check_all_ints], actual.first_iteration[check_all_ints]))
+                        {
+                            Report("First_Iteration", name, count, check_all_ints ? ", check_all_ints" : "");
+                        }
+                    }
+                    for (const bool scale_down : { false, true })
+                    {
+                        if (!Is_Close(expected.var[scale_down], actual.var[scale_down]) || expected.intervals[scale_down] != actual.intervals[scale_down])
+                        {
+                            Report("Second_Iteration", name, count, scale_down ? ", scale_down" : "");
+                        }
+                    }
+                    if (expected.sub_histograms != actual.sub_histograms)
+                    {
+                        Report("Histogram", name, count, "");
+                    }
+                    if (expected.counts != actual.counts || expected.total != actual.total)
+                    {
+                        Report("Add_Counts", name, count, "");
+                    }
+                }
+            }
+
+            std::cout << CArg_Parser::Get_Instruction_Set_Str(tested_set) << ": " << (0 == mismatches ? "OK" : "FAILED") << std::endl;
+            total_mismatches += mismatches;
+        }
+        (void)Select(instruction_set);
+
+        return 0 == total_mismatches;
+    }
+
+    config::NInstruction_Set CCPU_Kernels::Detect_Instruction_Set() noexcept
+    {
+        // Bits of the CPUID registers (see the Intel Software Developer's Manual, CPUID instruction).
+        static constexpr uint32_t SSE42_Bit = 1U << 20;   // Leaf 1, ECX
+        static constexpr uint32_t OSXSAVE_Bit = 1U << 27; // Leaf 1, ECX
+        static constexpr uint32_t AVX_Bit = 1U << 28;     // Leaf 1, ECX
+        static constexpr uint32_t AVX2_Bit = 1U << 5;     // Leaf 7, EBX
+        static constexpr uint32_t AVX512F_Bit = 1U << 16; // Leaf 7, EBX
+
+        // Register states that have to be saved by the operating system (XCR0).
+        static constexpr uint64_t AVX_States = 0x06;    // SSE and AVX registers
+        static constexpr uint64_t AVX512_States = 0xE6; // SSE, AVX, opmask and ZMM registers
+
+        uint32_t registers[4]{};
+        Cpuid(registers, 0, 0);
+        const uint32_t max_leaf = registers[0];
+
+        Cpuid(registers, 1, 0);
+        const uint32_t features = registers[2];
+        if (0 == (features & SSE42_Bit))
+        {
+            return config::NInstruction_Set::Scalar;
+        }
+
+        // The wider registers can only be used if the operating system saves them on context switches.
+        if (0 == (features & OSXSAVE_Bit) || 0 == (features & AVX_Bit) || max_leaf < 7)
+        {
+            return config::NInstruction_Set::SSE42;
+        }
+        const uint64_t states = Get_Enabled_Register_States();
+        if (AVX_States != (states & AVX_States))
+        {
+            return config::NInstruction_Set::SSE42;
+        }
+
+        Cpuid(registers, 7, 0);
+        const uint32_t extended_features = registers[1];
+        if (0 == (extended_features & AVX2_Bit))
+        {
+            return config::NInstruction_Set::SSE42;
+        }
+        if (0 == (extended_features & AVX512F_Bit) || AVX512_States != (states & AVX512_States))
+        {
+            return config::NInstruction_Set::AVX2;
+        }
+        return config::NInstruction_Set::AVX512;
+    }
+
+    void CCPU_Kernels::Cpuid(uint32_t registers[4], uint32_t leaf, uint32_t subleaf) noexcept
+    {
+#ifdef _MSC_VER
+        int values[4]{};
+        __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+        for (size_t i = 0; i < 4; ++i)
+        {
+            registers[i] = static_cast<uint32_t>(values[i]);
+        }
+#else
+        __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+    }
+
+    uint64_t CCPU_Kernels::Get_Enabled_Register_States() noexcept
+    {
+#ifdef _MSC_VER
+        return _xgetbv(0);
+#else
+        uint32_t eax = 0;
+        uint32_t edx = 0;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+    }
+}
+
+// EOF
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <span>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+#include "../config.h"
+#include "first_iteration.h"
+#include "histogram.h"
+
+namespace kiv_ppr::kernels::cpu
+{
+    /// Values calculated in the first iteration passed into the kernel of the second iteration.
+    struct TSecond_Iteration_Params
+    {
+        double mean;          ///< Mean (of the values scaled down, if scale_down is set)
+        bool scale_down;      ///< The values are divided by config::processing::Scale_Factor (see CSecond_Iteration::Scale_Up_Basic_Values)
+        double count_minus_1; ///< Number of valid doubles minus 1
+    };
+
+    /// Compile-time policy of the first iteration kernels. Each combination of the flags
+    /// is compiled into a loop of its own, so the flags are not tested per value.
+    template<bool Check_All_Ints_, bool Multiply_>
+    struct TFirst_Iteration_Policy
+    {
+        static constexpr bool Check_All_Ints = Check_All_Ints_; ///< The values are checked for being integers (all_ints is accumulated)
+        static constexpr bool Multiply = Multiply_;             ///< The values are multiplied by a multiplier before they are added into the sum
+    };
+
+    /// Compile-time policy of the second iteration kernels (see TFirst_Iteration_Policy).
+    template<bool Scale_Down_>
+    struct TSecond_Iteration_Policy
+    {
+        static constexpr bool Scale_Down = Scale_Down_; ///< The values are divided by config::processing::Scale_Factor
+    };
+
+    /// Kernel of the first iteration. It calculates the values (statistics) of a block of data.
+    /// The values are scaled down by config::processing::Scale_Factor, so the mean does not overflow.
+    /// If check_all_ints is false, the values are not checked for being integers (all_ints is set to false).
+    /// The flag selects a specialization of the kernel (see TFirst_Iteration_Policy).
+    using First_Iteration_Kernel_t = CFirst_Iteration::TValues (*)(const double* data, size_t count, bool check_all_ints) noexcept;
+
+    /// Kernel of the second iteration. It adds the valid doubles of a block of data into the histogram.
+    /// The scale_down flag selects a specialization of the kernel (see TSecond_Iteration_Policy).
+    /// \return Part of the variance calculated out of the block
+    using Second_Iteration_Kernel_t = double (*)(const double* data, size_t count, const TSecond_Iteration_Params& params, CHistogram& histogram);
+
+    /// Kernel of the histogram. It counts the values whose flag is set in the interleaved copies of the intervals
+    /// (the k-th value is counted in the copy k % config::processing::Sub_Histograms), see CHistogram::Add_Block.
+    using Histogram_Kernel_t = void (*)(std::span<const double> values, std::span<const uint8_t> mask, const CHistogram::TBinning& binning, size_t* sub_histograms) noexcept;
+
+    /// Kernel adding up two arrays of counts (e.g. the intervals of two histograms), dest[i] += src[i].
+    /// \return Sum of the counts added into the destination array
+    using Add_Counts_Kernel_t = size_t (*)(size_t* dest, const size_t* src, size_t count) noexcept;
+
+    /// Compensated sum of the valid doubles of a block of data.
+    struct TBlock_Sum
+    {
+        double sum = 0.0;          ///< Sum of the values
+        double compensation = 0.0; ///< Lost low-order bits of the sum (Neumaier)
+        size_t count = 0;          ///< Number of valid doubles
+    };
+
+    /// Adds a value into a compensated (Neumaier) sum.
+    /// \param sum Sum of the values
+    /// \param compensation Lost low-order bits of the sum
+    /// \param value Value to be added
+    inline void Add_Compensated(double& sum, double& compensation, double value) noexcept
+    {
+        const double total = sum + value;
+        if (std::fabs(sum) >= std::fabs(value))
+        {
+            compensation += (sum - total) + value;
+        }
+        else
+        {
+            compensation += (value - total) + sum;
+        }
+        sum = total;
+    }
+
+    /// Adds the compensated sums of several SIMD lanes into the sum of a block.
+    /// \param block_sum Sum of the block
+    /// \param sums Sums of the lanes
+    /// \param compensations Compensations of the lanes
+    /// \param counts Number of valid doubles each lane has processed
+    /// \param lanes Number of lanes
+    void Add_Lanes(TBlock_Sum& block_sum, const double* sums, const double* compensations, const double* counts, size_t lanes) noexcept;
+
+    /// Calculates the mean of a block out of its sum. The mean is scaled down by config::processing::Scale_Factor.
+    /// \param block_sum Sum of the block
+    /// \param multiplier Value each number was multiplied by before it was added into the sum
+    /// \return Mean of the block (not a finite number, if the sum has overflowed)
+    [[nodiscard]] double Get_Mean(const TBlock_Sum& block_sum, double multiplier) noexcept;
+
+    /// Returns the value the numbers of a block are multiplied by when their plain sum overflows.
+    /// It is a power of two (so the multiplication is exact) not greater than 1 / count, so the sum cannot overflow.
+    /// \param count Number of values in the block
+    /// \return Multiplier
+    [[nodiscard]] double Get_Overflow_Multiplier(size_t count) noexcept;
+
+    /// Returns the index of the interval (bin) of a histogram a value falls into.
+    /// The index is clamped into the histogram (a NaN falls into the first interval).
+    /// \param value Value
+    /// \param binning Binning of the histogram
+    /// \return Index of the interval
+    inline size_t Get_Slot(double value, const CHistogram::TBinning& binning) noexcept
+    {
+        const double slot = (value - binning.min) * binning.reciprocal;
+        return slot >= 0.0 ? static_cast<size_t>(std::min(slot, binning.last_slot)) : 0;
+    }
+
+    /// Stores a mask of SIMD lanes as flags (one byte per lane) passed into CHistogram::Add_Block.
+    /// \param mask Flags of the lanes (1 = the bit of the lane is set, 0 otherwise)
+    /// \param bits Mask of the lanes (one bit per lane)
+    /// \param lanes Number of lanes
+    inline void Store_Mask(uint8_t* mask, unsigned bits, size_t lanes) noexcept
+    {
+        for (size_t i = 0; i < lanes; ++i)
+        {
+            mask[i] = static_cast<uint8_t>((bits >> i) & 1U);
+        }
+    }
+
+    /// Kernels without any SIMD instructions (they run on any CPU).
+    namespace scalar
+    {
+        [[nodiscard]] CFirst_Iteration::TValues First_Iteration(const double* data, size_t count, bool check_all_ints) noexcept;
+        [[nodiscard]] double Second_Iteration(const double* data, size_t count, const TSecond_Iteration_Params& params, CHistogram& histogram);
+        void Histogram(std::span<const double> values, std::span<const uint8_t> mask, const CHistogram::TBinning& binning, size_t* sub_histograms) noexcept;
+        [[nodiscard]] size_t Add_Counts(size_t* dest, const size_t* src, size_t count) noexcept;
+    }
+
+    /// Kernels using SSE4.2 instructions (two doubles at a time).
+    namespace sse42
+    {
+        [[nodiscard]] CFirst_Iteration::TValues First_Iteration(const double* data, size_t count, bool check_all_ints) noexcept;
+        [[nodiscard]] double Second_Iteration(const double* data, size_t count, const TSecond_Iteration_Params& params, CHistogram& histogram);
+        void Histogram(std::span<const double> values, std::span<const uint8_t> mask, const CHistogram::TBinning& binning, size_t* sub_histograms) noexcept;
+        [[nodiscard]] size_t Add_Counts(size_t* dest, const size_t* src, size_t count) noexcept;
+    }
+
+    /// Kernels using AVX2 instructions (four doubles at a time).
+    namespace avx2
+    {
+        [[nodiscard]] CFirst_Iteration::TValues First_Iteration(const double* data, size_t count, bool check_all_ints) noexcept;
+        [[nodiscard]] double Second_Iteration(const double* data, size_t count, const TSecond_Iteration_Params& params, CHistogram& histogram);
+        void Histogram(std::span<const double> values, std::span<const uint8_t> mask, const CHistogram::TBinning& binning, size_t* sub_histograms) noexcept;
+        [[nodiscard]] size_t Add_Counts(size_t* dest, const size_t* src, size_t count) noexcept;
+    }
+
+    /// Kernels using AVX-512 instructions (eight doubles at a time).
+    namespace avx512
+    {
+        [[nodiscard]] CFirst_Iteration::TValues First_Iteration(const double* data, size_t count, bool check_all_ints) noexcept;
+        [[nodiscard]] double Second_Iteration(const double* data, size_t count, const TSecond_Iteration_Params& params, CHistogram& histogram);
+        void Histogram(std::span<const double> values, std::span<const uint8_t> mask, const CHistogram::TBinning& binning, size_t* sub_histograms) noexcept;
+        [[nodiscard]] size_t Add_Counts(size_t* dest, const size_t* src, size_t count) noexcept;
+    }
+}
+
+namespace kiv_ppr
+{
+    /// \author Jakub Silhavy
+    ///
+    /// This class picks the implementation of the CPU kernels (scalar, SSE4.2, AVX2, AVX-512) once at startup.
+    /// By default, it uses the widest instruction set supported by both the CPU and the operating system
+    /// (detected using CPUID and XGETBV). A specific instruction set can be forced (e.g. for benchmarking).
+    /// Each implementation lives in a file of its own compiled with the instruction set enabled, so the rest
+    /// of the program runs on any x64 CPU. This class is used as a singleton (see singleton.h).
+    class CCPU_Kernels
+    {
+    public:
+        /// Creates an instance of the class (the best supported kernels are selected).
+        CCPU_Kernels() noexcept;
+
+        /// Default destructor.
+        ~CCPU_Kernels() = default;
+
+        /// Selects the kernels.
+        /// \param instruction_set Instruction set the kernels use (Auto = the best one supported by the CPU)
+        /// \return true, if the instruction set is supported by the CPU, false otherwise (the selection is left unchanged).
+        [[nodiscard]] bool Select(config::NInstruction_Set instruction_set) noexcept;
+
+        /// Returns the instruction set used by the selected kernels.
+        /// \return Instruction set
+        [[nodiscard]] config::NInstruction_Set Get_Instruction_Set() const noexcept;
+
+        /// Processes a block of data in the first iteration (see First_Iteration_Kernel_t).
+        /// \param data Block of data
+        /// \param count Number of values in the block
+        /// \param check_all_ints Flag indicating whether the values should be checked for being integers
+        /// \return Calculated values (statistics)
+        [[nodiscard]] CFirst_Iteration::TValues First_Iteration(const double* data, size_t count, bool check_all_ints) const noexcept;
+
+        /// Processes a block of data in the second iteration (see Second_Iteration_Kernel_t).
+        /// \param data Block of data
+        /// \param count Number of values in the block
+        /// \param params Values calculated in the first iteration
+        /// \param histogram Histogram the valid doubles are added into
+        /// \return Part of the variance calculated out of the block
+        [[nodiscard]] double Second_Iteration(const double* data, size_t count, const kernels::cpu::TSecond_Iteration_Params& params, CHistogram& histogram) const;
+
+        /// Counts values in the interleaved copies of the intervals of a histogram (see Histogram_Kernel_t).
+        /// \param values Values to be counted
+        /// \param mask Flags of the values (1 = the value is counted, 0 = the value is skipped)
+        /// \param binning Binning of the histogram
+        /// \param sub_histograms Interleaved copies of the intervals
+        void Histogram(std::span<const double> values, std::span<const uint8_t> mask, const CHistogram::TBinning& binning, size_t* sub_histograms) const noexcept;
+
+        /// Adds up two arrays of counts (see Add_Counts_Kernel_t).
+        /// \param dest Destination array (dest[i] += src[i])
+        /// \param src Counts added into the destination array
+        /// \param count Number of counts
+        /// \return Sum of the counts added into the destination array
+        [[nodiscard]] size_t Add_Counts(size_t* dest, const size_t* src, size_t count) const noexcept;
+
+        /// Measures the throughput of each specialization of the kernels (see TFirst_Iteration_Policy and TSecond_Iteration_Policy)
+        /// for all instruction sets supported by the CPU and prints it out. The selected kernels are left unchanged.
+        /// \param count Number of (normally distributed) values the kernels process at once
+        /// \param repetitions Number of times each kernel is executed
+        void Benchmark(size_t count, uint32_t repetitions);
+
+        /// Checks the kernels of all instruction sets supported by the CPU against the scalar ones and prints out
+        /// the blocks they differ on. The blocks are 0-15 values long (plus 64 and config::processing::Histogram_Chunk_Size),
+        /// so all the tails of the SIMD loops are covered. They hold integers, non-integers, NaNs, infinities, subnormals,
+        /// signed zeros and values whose sum overflows. The selected kernels are left unchanged.
+        /// \return true, if all the kernels match the scalar ones, false otherwise.
+        [[nodiscard]] bool Test();
+
+        /// Returns the widest instruction set supported by both the CPU and the operating system.
+        /// \return Instruction set
+        [[nodiscard]] static config::NInstruction_Set Detect_Instruction_Set() noexcept;
+
+    private:
+        /// Executes the CPUID instruction.
+        /// \param registers Values of the EAX, EBX, ECX and EDX registers
+        /// \param leaf Leaf (EAX)
+        /// \param subleaf Subleaf (ECX)
+        static void Cpuid(uint32_t registers[4], uint32_t leaf, uint32_t subleaf) noexcept;
+
+        /// Returns which register states the operating system saves on context switches (XCR0).
+        /// \return Value of the XCR0 register
+        [[nodiscard]] static uint64_t Get_Enabled_Register_States() noexcept;
+
+    private:
+        config::NInstruction_Set m_instruction_set;                 ///< Instruction set used by the selected kernels
+        kernels::cpu::First_Iteration_Kernel_t m_first_iteration;   ///< Kernel of the first iteration
+        kernels::cpu::Second_Iteration_Kernel_t m_second_iteration; ///< Kernel of the second iteration
+        kernels::cpu::Histogram_Kernel_t m_histogram;               ///< Kernel of the histogram
+        kernels::cpu::Add_Counts_Kernel_t m_add_counts;             ///< Kernel adding up two arrays of counts
+    };
+}
+
+// EOF
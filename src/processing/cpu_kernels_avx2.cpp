@@ -0,0 +1,339 @@
+#include <cmath>
+#include <limits>
+#include <iterator>
+#include <algorithm>
+#include <immintrin.h>
+
+#include "../utils/utils.h"
+#include "cpu_kernels.h"
+
+namespace kiv_ppr::kernels::cpu::avx2
+{
+    /// Values calculated by one SIMD accumulator (each of the four lanes has its own compensated sum).
+    struct TLanes
+    {
+        __m256d min;          ///< Minimums
+        __m256d max;          ///< Maximums
+        __m256d sum;          ///< Sums of the values (multiplied by the multiplier)
+        __m256d compensation; ///< Lost low-order bits of the sums (Neumaier)
+        __m256d count;        ///< Number of valid doubles
+        __m256d non_ints;     ///< Valid values that are not integers
+    };
+
+    /// Adds four values into a SIMD accumulator.
+    /// \tparam Policy Which statistics are accumulated and whether the values are multiplied (see TFirst_Iteration_Policy)
+    /// \param lanes SIMD accumulator
+    /// \param vals Four values read from the input file
+    /// \param valid Mask of the values to be added (the other lanes are left untouched)
+    /// \param multiplier Value each number is multiplied by before it is added into the sum
+    template<typename Policy>
+    static inline void Update_Lanes(TLanes& lanes, __m256d vals, __m256d valid, __m256d multiplier) noexcept
+    {
+        // Update the minimum and maximum (invalid lanes are replaced by the current minimum/maximum).
+        lanes.min = _mm256_min_pd(lanes.min, _mm256_blendv_pd(lanes.min, vals, valid));
+        lanes.max = _mm256_max_pd(lanes.max, _mm256_blendv_pd(lanes.max, vals, valid));
+
+        // Update the sums (invalid lanes are masked out to zeros, so they leave the sums as they are).
+        const __m256d _vals = _mm256_and_pd(valid, Policy::Multiply ? _mm256_mul_pd(vals, multiplier) : vals);
+        const __m256d _total = _mm256_add_pd(lanes.sum, _vals);
+
+        // Neumaier: the low-order bits of the smaller (in magnitude) of the two operands are lost.
+        const __m256d _abs_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(static_cast<int64_t>(utils::Double_Abs_Mask)));
+        const __m256d _sum_is_bigger = _mm256_cmp_pd(_mm256_and_pd(lanes.sum, _abs_mask), _mm256_and_pd(_vals, _abs_mask), _CMP_GE_OQ);
+        const __m256d _bigger = _mm256_blendv_pd(_vals, lanes.sum, _sum_is_bigger);
+        const __m256d _smaller = _mm256_blendv_pd(lanes.sum, _vals, _sum_is_bigger);
+        lanes.compensation = _mm256_add_pd(lanes.compensation, _mm256_add_pd(_mm256_sub_pd(_bigger, _total), _smaller));
+        lanes.sum = _total;
+
+        lanes.count = _mm256_add_pd(lanes.count, _mm256_and_pd(valid, _mm256_set1_pd(1.0)));
+
+        // Mark the valid values that are not integers (they differ from themselves rounded towards zero).
+        if constexpr (Policy::Check_All_Ints)
+        {
+            const __m256d _not_int = _mm256_cmp_pd(vals, _mm256_round_pd(vals, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC), _CMP_NEQ_OQ);
+            lanes.non_ints = _mm256_or_pd(lanes.non_ints, _mm256_and_pd(valid, _not_int));
+        }
+    }
+
+    /// Updates the variance with four values and stores them for the histogram.
+    /// \tparam Policy Whether the values are scaled down (see TSecond_Iteration_Policy)
+    /// \param vals Four values read from the input file
+    /// \param valid Mask of the values to be added (invalid lanes are replaced by the mean, so they do not change the variance)
+    /// \param var Variance (one of the SIMD accumulators)
+    /// \param params Values calculated in the first iteration
+    /// \param values Values scaled down if necessary (passed into the histogram)
+    /// \param mask Flags of the values (passed into the histogram)
+    template<typename Policy>
+    static inline void Update_Variance(__m256d vals, __m256d valid, __m256d& var, const TSecond_Iteration_Params& params, double* values, uint8_t* mask) noexcept
+    {
+        const __m256d _mean = _mm256_set1_pd(params.mean);
+
+        // Scale_Factor is a power of two, so multiplying by its reciprocal is the same as dividing by it.
+        if constexpr (Policy::Scale_Down)
+        {
+            vals = _mm256_mul_pd(vals, _mm256_set1_pd(1.0 / config::processing::Scale_Factor));
+        }
+
+        __m256d _delta = _mm256_sub_pd(_mm256_blendv_pd(_mean, vals, valid), _mean);
+        const __m256d _tmp_value = _delta;
+        _delta = _mm256_div_pd(_delta, _mm256_set1_pd(params.count_minus_1));
+        _delta = _mm256_mul_pd(_delta, _tmp_value);
+        var = _mm256_add_pd(var, _delta);
+
+        // Store the values for the histogram.
+        _mm256_store_pd(values, vals);
+        Store_Mask(mask, static_cast<unsigned>(_mm256_movemask_pd(valid)), 4);
+    }
+
+    /// Calculates the values (statistics) of a block of data.
+    /// \tparam Policy Which statistics are accumulated and whether the values are multiplied (see TFirst_Iteration_Policy)
+    /// \param data Block of data
+    /// \param count Number of values in the block
+    /// \param multiplier Value each number is multiplied by before it is added into the sum (used if Policy::Multiply is set)
+    /// \return Calculated values (statistics)
+    template<typename Policy>
+    static CFirst_Iteration::TValues Accumulate(const double* data, size_t count, double multiplier) noexcept
+    {
+        CFirst_Iteration::TValues values{};
+        const __m256d _multiplier = _mm256_set1_pd(multiplier);
+
+        // Each accumulator starts with the same initial values as TValues.
+        TLanes lanes[config::processing::SIMD_Accumulators];
+        for (auto& lane : lanes)
+        {
+            lane.min = _mm256_set1_pd(std::numeric_limits<double>::max());
+            lane.max = _mm256_set1_pd(std::numeric_limits<double>::lowest());
+            lane.sum = _mm256_setzero_pd();
+            lane.compensation = _mm256_setzero_pd();
+            lane.count = _mm256_setzero_pd();
+            lane.non_ints = _mm256_setzero_pd();
+        }
+
+        size_t i = 0;
+
+        // Process the block by all accumulators at once (they do not depend on each other).
+        for (; i + 4 * std::size(lanes) <= count; i += 4 * std::size(lanes))
+        {
+            for (size_t j = 0; j < std::size(lanes); ++j)
+            {
+                const __m256d _vals = _mm256_loadu_pd(data + i + 4 * j);
+                Update_Lanes<Policy>(lanes[j], _vals, utils::vectorization::Get_Valid_Mask(_vals), _multiplier);
+            }
+        }
+
+        // Process the rest of the block four values at a time.
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m256d _vals = _mm256_loadu_pd(data + i);
+            Update_Lanes<Policy>(lanes[0], _vals, utils::vectorization::Get_Valid_Mask(_vals), _multiplier);
+        }
+
+        // Process the last (at most three) values. The unused lanes are loaded as zeros and masked out.
+        if (i < count)
+        {
+            const __m256i _lanes = utils::vectorization::Get_Lane_Mask(count - i);
+            const __m256d _vals = _mm256_maskload_pd(data + i, _lanes);
+            Update_Lanes<Policy>(lanes[0], _vals, _mm256_and_pd(utils::vectorization::Get_Valid_Mask(_vals), _mm256_castsi256_pd(_lanes)), _multiplier);
+        }
+
+        // Merge the accumulators.
+        __m256d _min = lanes[0].min;
+        __m256d _max = lanes[0].max;
+        __m256d _non_ints = lanes[0].non_ints;
+        for (size_t j = 1; j < std::size(lanes); ++j)
+        {
+            _min = _mm256_min_pd(_min, lanes[j].min);
+            _max = _mm256_max_pd(_max, lanes[j].max);
+            _non_ints = _mm256_or_pd(_non_ints, lanes[j].non_ints);
+        }
+
+        TBlock_Sum block_sum{};
+        for (const auto& lane : lanes)
+        {
+            alignas(32) double sums[4];
+            alignas(32) double compensations[4];
+            alignas(32) double counts[4];
+            _mm256_store_pd(sums, lane.sum);
+            _mm256_store_pd(compensations, lane.compensation);
+            _mm256_store_pd(counts, lane.count);
+            Add_Lanes(block_sum, sums, compensations, counts, 4);
+        }
+
+        // Scale the values down, so we are able to calculate -DOUBLE_MAX - DOUBLE_MAX.
+        if (0 != block_sum.count)
+        {
+            values.min = utils::vectorization::Aggregate(_min, std::numeric_limits<double>::max(), [](double x, double y) { return std::min(x, y); }) / config::processing::Scale_Factor;
+            values.max = utils::vectorization::Aggregate(_max, std::numeric_limits<double>::lowest(), [](double x, double y) { return std::max(x, y); }) / config::processing::Scale_Factor;
+        }
+        values.mean = Get_Mean(block_sum, Policy::Multiply ? multiplier : 1.0);
+        values.count = block_sum.count;
+        values.all_ints = Policy::Check_All_Ints && 0 == _mm256_movemask_pd(_non_ints);
+
+        return values;
+    }
+
+    /// Calculates the values (statistics) of a block of data (see First_Iteration_Kernel_t).
+    /// \tparam Check_All_Ints Flag indicating whether the values should be checked for being integers
+    /// \param data Block of data
+    /// \param count Number of values in the block
+    /// \return Calculated values (statistics)
+    template<bool Check_All_Ints>
+    static CFirst_Iteration::TValues First_Iteration(const double* data, size_t count) noexcept
+    {
+        auto values = Accumulate<TFirst_Iteration_Policy<Check_All_Ints, false>>(data, count, 1.0);
+
+        // The sum has overflowed, so add up the values multiplied by a power of two small enough.
+        if (!std::isfinite(values.mean))
+        {
+            values = Accumulate<TFirst_Iteration_Policy<Check_All_Ints, true>>(data, count, Get_Overflow_Multiplier(count));
+        }
+
+        return values;
+    }
+
+    /// Calculates the part of the variance of a block of data and adds its values into the histogram (see Second_Iteration_Kernel_t).
+    /// \tparam Policy Whether the values are scaled down (see TSecond_Iteration_Policy)
+    /// \param data Block of data
+    /// \param count Number of values in the block
+    /// \param params Values calculated in the first iteration
+    /// \param histogram Histogram the valid values are added into
+    /// \return Part of the variance calculated out of the block
+    template<typename Policy>
+    static double Second_Iteration(const double* data, size_t count, const TSecond_Iteration_Params& params, CHistogram& histogram)
+    {
+        // Independent accumulators of the variance.
+        __m256d _vars[config::processing::SIMD_Accumulators];
+        for (auto& _var : _vars)
+        {
+            _var = _mm256_setzero_pd();
+        }
+
+        // Values (scaled down if necessary) passed into the histogram and their flags (1 = valid double).
+        // The chunk size is a multiple of the number of values processed by all accumulators at once.
+        alignas(32) double values[config::processing::Histogram_Chunk_Size];
+        uint8_t mask[config::processing::Histogram_Chunk_Size];
+
+        for (size_t chunk = 0; chunk < count; chunk += std::size(values))
+        {
+            const double* chunk_data = data + chunk;
+            const size_t chunk_count = std::min(std::size(values), count - chunk);
+            size_t i = 0;
+
+            // Process the chunk by all accumulators at once (they do not depend on each other).
+            for (; i + 4 * std::size(_vars) <= chunk_count; i += 4 * std::size(_vars))
+            {
+                for (size_t j = 0; j < std::size(_vars); ++j)
+                {
+                    const __m256d _vals = _mm256_loadu_pd(chunk_data + i + 4 * j);
+                    Update_Variance<Policy>(_vals, utils::vectorization::Get_Valid_Mask(_vals), _vars[j], params, values + i + 4 * j, mask + i + 4 * j);
+                }
+            }
+
+            // Process the rest of the chunk four values at a time.
+            for (; i + 4 <= chunk_count; i += 4)
+            {
+                const __m256d _vals = _mm256_loadu_pd(chunk_data + i);
+                Update_Variance<Policy>(_vals, utils::vectorization::Get_Valid_Mask(_vals), _vars[0], params, values + i, mask + i);
+            }
+
+            // Process the last (at most three) values. The unused lanes are loaded as zeros and masked out
+            // (the chunk is not full, so there is enough space for all four lanes in the buffers).
+            if (i < chunk_count)
+            {
+                const __m256i _lanes = utils::vectorization::Get_Lane_Mask(chunk_count - i);
+                const __m256d _vals = _mm256_maskload_pd(chunk_data + i, _lanes);
+                Update_Variance<Policy>(_vals, _mm256_and_pd(utils::vectorization::Get_Valid_Mask(_vals), _mm256_castsi256_pd(_lanes)), _vars[0], params, values + i, mask + i);
+            }
+
+            histogram.Add_Block({ values, chunk_count }, { mask, chunk_count });
+        }
+
+        // Add the copies of the intervals into the histogram at the end of the block.
+        histogram.Merge_Sub_Histograms();
+
+        // Aggeregate (sum up) all the values.
+        __m256d _var = _vars[0];
+        for (size_t j = 1; j < std::size(_vars); ++j)
+        {
+            _var = _mm256_add_pd(_var, _vars[j]);
+        }
+        return utils::vectorization::Aggregate(_var, 0.0, [](double x, double y) { return x + y; });
+    }
+
+    CFirst_Iteration::TValues First_Iteration(const double* data, size_t count, bool check_all_ints) noexcept
+    {
+        return check_all_ints ? First_Iteration<true>(data, count) : First_Iteration<false>(data, count);
+    }
+
+    double Second_Iteration(const double* data, size_t count, const TSecond_Iteration_Params& params, CHistogram& histogram)
+    {
+        return params.scale_down ? Second_Iteration<TSecond_Iteration_Policy<true>>(data, count, params, histogram)
+                                 : Second_Iteration<TSecond_Iteration_Policy<false>>(data, count, params, histogram);
+    }
+
+    void Histogram(std::span<const double> values, std::span<const uint8_t> mask, const CHistogram::TBinning& binning, size_t* sub_histograms) noexcept
+    {
+        const __m256d _min = _mm256_set1_pd(binning.min);
+        const __m256d _reciprocal = _mm256_set1_pd(binning.reciprocal);
+        const __m256d _last_slot = _mm256_set1_pd(binning.last_slot);
+        const __m128i _sub_histograms = _mm_set1_epi32(static_cast<int>(config::processing::Sub_Histograms));
+
+        size_t i = 0;
+
+        // Calculate the indexes of four values at a time. Flags are added instead of ones, so there is no branch per value.
+        for (; i + 4 <= values.size(); i += 4)
+        {
+            __m256d _slots = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(values.data() + i), _min), _reciprocal);
+
+            // Clamp the indexes into the histogram (the maximum of a NaN and zero is zero).
+            _slots = _mm256_min_pd(_mm256_max_pd(_slots, _mm256_setzero_pd()), _last_slot);
+
+            // Each value is counted in its own copy of the interval.
+            const __m128i _copies = _mm_setr_epi32(0, 1, 2, 3);
+            const __m128i _first_copy = _mm_set1_epi32(static_cast<int>(i % config::processing::Sub_Histograms));
+            const __m128i _indexes = _mm_add_epi32(_mm_mullo_epi32(_mm256_cvttpd_epi32(_slots), _sub_histograms), _mm_add_epi32(_copies, _first_copy));
+
+            alignas(16) int32_t indexes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(indexes), _indexes);
+            for (size_t j = 0; j < 4; ++j)
+            {
+                sub_histograms[indexes[j]] += mask[i + j];
+            }
+        }
+
+        // Process the last (at most three) values.
+        for (; i < values.size(); ++i)
+        {
+            sub_histograms[Get_Slot(values[i], binning) * config::processing::Sub_Histograms + i % config::processing::Sub_Histograms] += mask[i];
+        }
+    }
+
+    size_t Add_Counts(size_t* dest, const size_t* src, size_t count) noexcept
+    {
+        __m256i _total = _mm256_setzero_si256();
+        size_t i = 0;
+
+        // Add up four counts at a time.
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m256i _src = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+            const __m256i _dest = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), _mm256_add_epi64(_dest, _src));
+            _total = _mm256_add_epi64(_total, _src);
+        }
+
+        alignas(32) uint64_t totals[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(totals), _total);
+        size_t total = static_cast<size_t>(totals[0] + totals[1] + totals[2] + totals[3]);
+
+        // Add up the last (at most three) counts.
+        for (; i < count; ++i)
+        {
+            dest[i] += src[i];
+            total += src[i];
+        }
+        return total;
+    }
+}
+
+// EOF
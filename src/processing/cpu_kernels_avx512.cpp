@@ -0,0 +1,351 @@
+#include <cmath>
+#include <limits>
+#include <iterator>
+#include <algorithm>
+#include <immintrin.h>
+
+#include "../utils/utils.h"
+#include "cpu_kernels.h"
+
+namespace kiv_ppr::kernels::cpu::avx512
+{
+    /// Values calculated by one SIMD accumulator (each of the eight lanes has its own compensated sum).
+    struct TLanes
+    {
+        __m512d min;          ///< Minimums
+        __m512d max;          ///< Maximums
+        __m512d sum;          ///< Sums of the values (multiplied by the multiplier)
+        __m512d compensation; ///< Lost low-order bits of the sums (Neumaier)
+        __m512d count;        ///< Number of valid doubles
+        __mmask8 non_ints;    ///< Valid values that are not integers
+    };
+
+    /// Returns a mask of the valid doubles (see utils::Is_Valid_Double) held by an __m512d.
+    /// \param vals Eight doubles to be tested
+    /// \return Mask (a bit is set if the value is valid)
+    static inline __mmask8 Get_Valid_Mask(__m512d vals) noexcept
+    {
+        const __m512i bits = _mm512_castpd_si512(vals);
+        const __m512i zero = _mm512_setzero_si512();
+        const __m512i exponent_mask = _mm512_set1_epi64(static_cast<int64_t>(utils::Double_Exponent_Mask));
+        const __m512i exponent = _mm512_and_si512(bits, exponent_mask);
+
+        // Infinities and NaNs (all exponent bits set) and subnormal numbers (no exponent bits set, but not a zero).
+        const __mmask8 inf_or_nan = _mm512_cmpeq_epi64_mask(exponent, exponent_mask);
+        const __mmask8 no_exponent = _mm512_cmpeq_epi64_mask(exponent, zero);
+        const __mmask8 is_zero = _mm512_cmpeq_epi64_mask(_mm512_and_si512(bits, _mm512_set1_epi64(static_cast<int64_t>(utils::Double_Abs_Mask))), zero);
+
+        return static_cast<__mmask8>(~(inf_or_nan | (no_exponent & ~is_zero)));
+    }
+
+    /// Adds eight values into a SIMD accumulator.
+    /// \tparam Policy Which statistics are accumulated and whether the values are multiplied (see TFirst_Iteration_Policy)
+    /// \param lanes SIMD accumulator
+    /// \param vals Eight values read from the input file
+    /// \param valid Mask of the values to be added (the other lanes are left untouched)
+    /// \param multiplier Value each number is multiplied by before it is added into the sum
+    template<typename Policy>
+    static inline void Update_Lanes(TLanes& lanes, __m512d vals, __mmask8 valid, __m512d multiplier) noexcept
+    {
+        // Update the minimum and maximum (only the valid lanes are updated).
+        lanes.min = _mm512_mask_min_pd(lanes.min, valid, lanes.min, vals);
+        lanes.max = _mm512_mask_max_pd(lanes.max, valid, lanes.max, vals);
+
+        // Update the sums (invalid lanes are zeros, so they leave the sums as they are).
+        const __m512d _vals = Policy::Multiply ? _mm512_maskz_mul_pd(valid, vals, multiplier) : _mm512_maskz_mov_pd(valid, vals);
+        const __m512d _total = _mm512_add_pd(lanes.sum, _vals);
+
+        // Neumaier: the low-order bits of the smaller (in magnitude) of the two operands are lost.
+        const __mmask8 sum_is_bigger = _mm512_cmp_pd_mask(_mm512_abs_pd(lanes.sum), _mm512_abs_pd(_vals), _CMP_GE_OQ);
+        const __m512d _bigger = _mm512_mask_blend_pd(sum_is_bigger, _vals, lanes.sum);
+        const __m512d _smaller = _mm512_mask_blend_pd(sum_is_bigger, lanes.sum, _vals);
+        lanes.compensation = _mm512_add_pd(lanes.compensation, _mm512_add_pd(_mm512_sub_pd(_bigger, _total), _smaller));
+        lanes.sum = _total;
+
+        lanes.count = _mm512_mask_add_pd(lanes.count, valid, lanes.count, _mm512_set1_pd(1.0));
+
+        // Mark the valid values that are not integers (they differ from themselves rounded towards zero).
+        if constexpr (Policy::Check_All_Ints)
+        {
+            const __m512d _truncated = _mm512_roundscale_pd(vals, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+            lanes.non_ints = static_cast<__mmask8>(lanes.non_ints | _mm512_mask_cmp_pd_mask(valid, vals, _truncated, _CMP_NEQ_OQ));
+        }
+    }
+
+    /// Updates the variance with eight values and stores them for the histogram.
+    /// \tparam Policy Whether the values are scaled down (see TSecond_Iteration_Policy)
+    /// \param vals Eight values read from the input file
+    /// \param valid Mask of the values to be added (the deltas of invalid lanes are zeros)
+    /// \param var Variance (one of the SIMD accumulators)
+    /// \param params Values calculated in the first iteration
+    /// \param values Values scaled down if necessary (passed into the histogram)
+    /// \param mask Flags of the values (passed into the histogram)
+    template<typename Policy>
+    static inline void Update_Variance(__m512d vals, __mmask8 valid, __m512d& var, const TSecond_Iteration_Params& params, double* values, uint8_t* mask) noexcept
+    {
+        // Scale_Factor is a power of two, so multiplying by its reciprocal is the same as dividing by it.
+        if constexpr (Policy::Scale_Down)
+        {
+            vals = _mm512_mul_pd(vals, _mm512_set1_pd(1.0 / config::processing::Scale_Factor));
+        }
+
+        __m512d _delta = _mm512_maskz_sub_pd(valid, vals, _mm512_set1_pd(params.mean));
+        const __m512d _tmp_value = _delta;
+        _delta = _mm512_div_pd(_delta, _mm512_set1_pd(params.count_minus_1));
+        _delta = _mm512_mul_pd(_delta, _tmp_value);
+        var = _mm512_add_pd(var, _delta);
+
+        // Store the values for the histogram.
+        _mm512_store_pd(values, vals);
+        Store_Mask(mask, valid, 8);
+    }
+
+    /// Calculates the values (statistics) of a block of data.
+    /// \tparam Policy Which statistics are accumulated and whether the values are multiplied (see TFirst_Iteration_Policy)
+    /// \param data Block of data
+    /// \param count Number of values in the block
+    /// \param multiplier Value each number is multiplied by before it is added into the sum (used if Policy::Multiply is set)
+    /// \return Calculated values (statistics)
+    template<typename Policy>
+    static CFirst_Iteration::TValues Accumulate(const double* data, size_t count, double multiplier) noexcept
+    {
+        CFirst_Iteration::TValues values{};
+        const __m512d _multiplier = _mm512_set1_pd(multiplier);
+
+        // Each accumulator starts with the same initial values as TValues.
+        TLanes lanes[config::processing::SIMD_Accumulators];
+        for (auto& lane : lanes)
+        {
+            lane.min = _mm512_set1_pd(std::numeric_limits<double>::max());
+            lane.max = _mm512_set1_pd(std::numeric_limits<double>::lowest());
+            lane.sum = _mm512_setzero_pd();
+            lane.compensation = _mm512_setzero_pd();
+            lane.count = _mm512_setzero_pd();
+            lane.non_ints = 0;
+        }
+
+        size_t i = 0;
+
+        // Process the block by all accumulators at once (they do not depend on each other).
+        for (; i + 8 * std::size(lanes) <= count; i += 8 * std::size(lanes))
+        {
+            for (size_t j = 0; j < std::size(lanes); ++j)
+            {
+                const __m512d _vals = _mm512_loadu_pd(data + i + 8 * j);
+                Update_Lanes<Policy>(lanes[j], _vals, Get_Valid_Mask(_vals), _multiplier);
+            }
+        }
+
+        // Process the rest of the block eight values at a time.
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m512d _vals = _mm512_loadu_pd(data + i);
+            Update_Lanes<Policy>(lanes[0], _vals, Get_Valid_Mask(_vals), _multiplier);
+        }
+
+        // Process the last (at most seven) values. The unused lanes are loaded as zeros and masked out.
+        if (i < count)
+        {
+            const auto lanes_mask = static_cast<__mmask8>((1U << (count - i)) - 1);
+            const __m512d _vals = _mm512_maskz_loadu_pd(lanes_mask, data + i);
+            Update_Lanes<Policy>(lanes[0], _vals, static_cast<__mmask8>(Get_Valid_Mask(_vals) & lanes_mask), _multiplier);
+        }
+
+        // Merge the accumulators.
+        __m512d _min = lanes[0].min;
+        __m512d _max = lanes[0].max;
+        __mmask8 non_ints = lanes[0].non_ints;
+        for (size_t j = 1; j < std::size(lanes); ++j)
+        {
+            _min = _mm512_min_pd(_min, lanes[j].min);
+            _max = _mm512_max_pd(_max, lanes[j].max);
+            non_ints = static_cast<__mmask8>(non_ints | lanes[j].non_ints);
+        }
+
+        TBlock_Sum block_sum{};
+        for (const auto& lane : lanes)
+        {
+            alignas(64) double sums[8];
+            alignas(64) double compensations[8];
+            alignas(64) double counts[8];
+            _mm512_store_pd(sums, lane.sum);
+            _mm512_store_pd(compensations, lane.compensation);
+            _mm512_store_pd(counts, lane.count);
+            Add_Lanes(block_sum, sums, compensations, counts, 8);
+        }
+
+        // Scale the values down, so we are able to calculate -DOUBLE_MAX - DOUBLE_MAX.
+        if (0 != block_sum.count)
+        {
+            values.min = _mm512_reduce_min_pd(_min) / config::processing::Scale_Factor;
+            values.max = _mm512_reduce_max_pd(_max) / config::processing::Scale_Factor;
+        }
+        values.mean = Get_Mean(block_sum, Policy::Multiply ? multiplier : 1.0);
+        values.count = block_sum.count;
+        values.all_ints = Policy::Check_All_Ints && 0 == non_ints;
+
+        return values;
+    }
+
+    /// Calculates the values (statistics) of a block of data (see First_Iteration_Kernel_t).
+    /// \tparam Check_All_Ints Flag indicating whether the values should be checked for being integers
+    /// \param data Block of data
+    /// \param count Number of values in the block
+    /// \return Calculated values (statistics)
+    template<bool Check_All_Ints>
+    static CFirst_Iteration::TValues First_Iteration(const double* data, size_t count) noexcept
+    {
+        auto values = Accumulate<TFirst_Iteration_Policy<Check_All_Ints, false>>(data, count, 1.0);
+
+        // The sum has overflowed, so add up the values multiplied by a power of two small enough.
+        if (!std::isfinite(values.mean))
+        {
+            values = Accumulate<TFirst_Iteration_Policy<Check_All_Ints, true>>(data, count, Get_Overflow_Multiplier(count));
+        }
+
+        return values;
+    }
+
+    /// Calculates the part of the variance of a block of data and adds its values into the histogram (see Second_Iteration_Kernel_t).
+    /// \tparam Policy Whether the values are scaled down (see TSecond_Iteration_Policy)
+    /// \param data Block of data
+    /// \param count Number of values in the block
+    /// \param params Values calculated in the first iteration
+    /// \param histogram Histogram the valid values are added into
+    /// \return Part of the variance calculated out of the block
+    template<typename Policy>
+    static double Second_Iteration(const double* data, size_t count, const TSecond_Iteration_Params& params, CHistogram& histogram)
+    {
+        // Independent accumulators of the variance.
+        __m512d _vars[config::processing::SIMD_Accumulators];
+        for (auto& _var : _vars)
+        {
+            _var = _mm512_setzero_pd();
+        }
+
+        // Values (scaled down if necessary) passed into the histogram and their flags (1 = valid double).
+        // The chunk size is a multiple of the number of values processed by all accumulators at once.
+        alignas(64) double values[config::processing::Histogram_Chunk_Size];
+        uint8_t mask[config::processing::Histogram_Chunk_Size];
+
+        for (size_t chunk = 0; chunk < count; chunk += std::size(values))
+        {
+            const double* chunk_data = data + chunk;
+            const size_t chunk_count = std::min(std::size(values), count - chunk);
+            size_t i = 0;
+
+            // Process the chunk by all accumulators at once (they do not depend on each other).
+            for (; i + 8 * std::size(_vars) <= chunk_count; i += 8 * std::size(_vars))
+            {
+                for (size_t j = 0; j < std::size(_vars); ++j)
+                {
+                    const __m512d _vals = _mm512_loadu_pd(chunk_data + i + 8 * j);
+                    Update_Variance<Policy>(_vals, Get_Valid_Mask(_vals), _vars[j], params, values + i + 8 * j, mask + i + 8 * j);
+                }
+            }
+
+            // Process the rest of the chunk eight values at a time.
+            for (; i + 8 <= chunk_count; i += 8)
+            {
+                const __m512d _vals = _mm512_loadu_pd(chunk_data + i);
+                Update_Variance<Policy>(_vals, Get_Valid_Mask(_vals), _vars[0], params, values + i, mask + i);
+            }
+
+            // Process the last (at most seven) values. The unused lanes are loaded as zeros and masked out
+            // (the chunk is not full, so there is enough space for all eight lanes in the buffers).
+            if (i < chunk_count)
+            {
+                const auto lanes_mask = static_cast<__mmask8>((1U << (chunk_count - i)) - 1);
+                const __m512d _vals = _mm512_maskz_loadu_pd(lanes_mask, chunk_data + i);
+                Update_Variance<Policy>(_vals, static_cast<__mmask8>(Get_Valid_Mask(_vals) & lanes_mask), _vars[0], params, values + i, mask + i);
+            }
+
+            histogram.Add_Block({ values, chunk_count }, { mask, chunk_count });
+        }
+
+        // Add the copies of the intervals into the histogram at the end of the block.
+        histogram.Merge_Sub_Histograms();
+
+        // Aggeregate (sum up) all the values.
+        __m512d _var = _vars[0];
+        for (size_t j = 1; j < std::size(_vars); ++j)
+        {
+            _var = _mm512_add_pd(_var, _vars[j]);
+        }
+        return _mm512_reduce_add_pd(_var);
+    }
+
+    CFirst_Iteration::TValues First_Iteration(const double* data, size_t count, bool check_all_ints) noexcept
+    {
+        return check_all_ints ? First_Iteration<true>(data, count) : First_Iteration<false>(data, count);
+    }
+
+    double Second_Iteration(const double* data, size_t count, const TSecond_Iteration_Params& params, CHistogram& histogram)
+    {
+        return params.scale_down ? Second_Iteration<TSecond_Iteration_Policy<true>>(data, count, params, histogram)
+                                 : Second_Iteration<TSecond_Iteration_Policy<false>>(data, count, params, histogram);
+    }
+
+    void Histogram(std::span<const double> values, std::span<const uint8_t> mask, const CHistogram::TBinning& binning, size_t* sub_histograms) noexcept
+    {
+        static_assert(8 == config::processing::Sub_Histograms, "Each lane has to have its own copy of the intervals");
+
+        const __m512d _min = _mm512_set1_pd(binning.min);
+        const __m512d _reciprocal = _mm512_set1_pd(binning.reciprocal);
+        const __m512d _last_slot = _mm512_set1_pd(binning.last_slot);
+        const __m256i _copies = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+        size_t i = 0;
+
+        // Calculate the indexes of eight values at a time.
+        for (; i + 8 <= values.size(); i += 8)
+        {
+            __m512d _slots = _mm512_mul_pd(_mm512_sub_pd(_mm512_loadu_pd(values.data() + i), _min), _reciprocal);
+
+            // Clamp the indexes into the histogram (the maximum of a NaN and zero is zero).
+            _slots = _mm512_min_pd(_mm512_max_pd(_slots, _mm512_setzero_pd()), _last_slot);
+
+            // Each lane has its own copy of the intervals, so the lanes never increment the same counter
+            // and the counters can be gathered, incremented and scattered back at once.
+            const __m256i _indexes = _mm256_add_epi32(_mm256_slli_epi32(_mm512_cvttpd_epi32(_slots), 3), _copies);
+            const __m512i _flags = _mm512_cvtepu8_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(mask.data() + i)));
+            const __mmask8 valid = _mm512_test_epi64_mask(_flags, _flags);
+
+            __m512i _counts = _mm512_mask_i32gather_epi64(_mm512_setzero_si512(), valid, _indexes, sub_histograms, 8);
+            _counts = _mm512_add_epi64(_counts, _mm512_set1_epi64(1));
+            _mm512_mask_i32scatter_epi64(sub_histograms, valid, _indexes, _counts, 8);
+        }
+
+        // Process the last (at most seven) values.
+        for (; i < values.size(); ++i)
+        {
+            sub_histograms[Get_Slot(values[i], binning) * config::processing::Sub_Histograms + i % config::processing::Sub_Histograms] += mask[i];
+        }
+    }
+
+    size_t Add_Counts(size_t* dest, const size_t* src, size_t count) noexcept
+    {
+        __m512i _total = _mm512_setzero_si512();
+        size_t i = 0;
+
+        // Add up eight counts at a time.
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m512i _src = _mm512_loadu_si512(src + i);
+            _mm512_storeu_si512(dest + i, _mm512_add_epi64(_mm512_loadu_si512(dest + i), _src));
+            _total = _mm512_add_epi64(_total, _src);
+        }
+
+        // Add up the last (at most seven) counts. The unused lanes are loaded as zeros and not stored.
+        if (i < count)
+        {
+            const auto lanes_mask = static_cast<__mmask8>((1U << (count - i)) - 1);
+            const __m512i _src = _mm512_maskz_loadu_epi64(lanes_mask, src + i);
+            _mm512_mask_storeu_epi64(dest + i, lanes_mask, _mm512_add_epi64(_mm512_maskz_loadu_epi64(lanes_mask, dest + i), _src));
+            _total = _mm512_add_epi64(_total, _src);
+        }
+        return static_cast<size_t>(_mm512_reduce_add_epi64(_total));
+    }
+}
+
+// EOF
@@ -0,0 +1,156 @@
+#include <cmath>
+#include <iterator>
+#include <algorithm>
+
+#include "../utils/utils.h"
+#include "cpu_kernels.h"
+
+namespace kiv_ppr::kernels::cpu::scalar
+{
+    /// Calculates the values (statistics) of a block of data.
+    /// \tparam Policy Which statistics are accumulated and whether the values are multiplied (see TFirst_Iteration_Policy)
+    /// \param data Block of data
+    /// \param count Number of values in the block
+    /// \param multiplier Value each number is multiplied by before it is added into the sum (used if Policy::Multiply is set)
+    /// \return Calculated values (statistics)
+    template<typename Policy>
+    static CFirst_Iteration::TValues Accumulate(const double* data, size_t count, double multiplier) noexcept
+    {
+        CFirst_Iteration::TValues values{};
+        TBlock_Sum block_sum{};
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            // The value has to to be a valid double.
+            if (utils::Is_Valid_Double(data[i]))
+            {
+                values.min = std::min(values.min, data[i]);
+                values.max = std::max(values.max, data[i]);
+
+                if constexpr (Policy::Multiply)
+                {
+                    Add_Compensated(block_sum.sum, block_sum.compensation, data[i] * multiplier);
+                }
+                else
+                {
+                    Add_Compensated(block_sum.sum, block_sum.compensation, data[i]);
+                }
+                ++block_sum.count;
+
+                // Check if the value is an integer or not (until the first one that is not).
+                if constexpr (Policy::Check_All_Ints)
+                {
+                    if (values.all_ints && (std::floor(data[i]) != std::ceil(data[i])))
+                    {
+                        values.all_ints = false;
+                    }
+                }
+            }
+        }
+
+        // Scale the values down, so we are able to calculate -DOUBLE_MAX - DOUBLE_MAX.
+        if (0 != block_sum.count)
+        {
+            values.min /= config::processing::Scale_Factor;
+            values.max /= config::processing::Scale_Factor;
+        }
+        values.mean = Get_Mean(block_sum, Policy::Multiply ? multiplier : 1.0);
+        values.count = block_sum.count;
+        values.all_ints = Policy::Check_All_Ints && values.all_ints;
+
+        return values;
+    }
+
+    /// Calculates the values (statistics) of a block of data (see First_Iteration_Kernel_t).
+    /// \tparam Check_All_Ints Flag indicating whether the values should be checked for being integers
+    /// \param data Block of data
+    /// \param count Number of values in the block
+    /// \return Calculated values (statistics)
+    template<bool Check_All_Ints>
+    static CFirst_Iteration::TValues First_Iteration(const double* data, size_t count) noexcept
+    {
+        auto values = Accumulate<TFirst_Iteration_Policy<Check_All_Ints, false>>(data, count, 1.0);
+
+        // The sum has overflowed, so add up the values multiplied by a power of two small enough.
+        if (!std::isfinite(values.mean))
+        {
+            values = Accumulate<TFirst_Iteration_Policy<Check_All_Ints, true>>(data, count, Get_Overflow_Multiplier(count));
+        }
+
+        return values;
+    }
+
+    /// Calculates the part of the variance of a block of data and adds its values into the histogram (see Second_Iteration_Kernel_t).
+    /// \tparam Policy Whether the values are scaled down (see TSecond_Iteration_Policy)
+    /// \param data Block of data
+    /// \param count Number of values in the block
+    /// \param params Values calculated in the first iteration
+    /// \param histogram Histogram the valid values are added into
+    /// \return Part of the variance calculated out of the block
+    template<typename Policy>
+    static double Second_Iteration(const double* data, size_t count, const TSecond_Iteration_Params& params, CHistogram& histogram)
+    {
+        double var = 0.0;
+
+        // Values (scaled down if necessary) passed into the histogram and their flags (1 = valid double).
+        double values[config::processing::Histogram_Chunk_Size];
+        uint8_t mask[config::processing::Histogram_Chunk_Size];
+
+        for (size_t chunk = 0; chunk < count; chunk += std::size(values))
+        {
+            const size_t chunk_count = std::min(std::size(values), count - chunk);
+            for (size_t i = 0; i < chunk_count; ++i)
+            {
+                // Scale_Factor is a power of two, so multiplying by its reciprocal is the same as dividing by it.
+                values[i] = Policy::Scale_Down ? data[chunk + i] * (1.0 / config::processing::Scale_Factor) : data[chunk + i];
+
+                // The value has to to be a valid double.
+                mask[i] = utils::Is_Valid_Double(data[chunk + i]) ? 1 : 0;
+                if (0 != mask[i])
+                {
+                    const double delta = values[i] - params.mean;
+                    var += delta / params.count_minus_1 * delta;
+                }
+            }
+            histogram.Add_Block({ values, chunk_count }, { mask, chunk_count });
+        }
+
+        // Add the copies of the intervals into the histogram at the end of the block.
+        histogram.Merge_Sub_Histograms();
+
+        return var;
+    }
+
+    CFirst_Iteration::TValues First_Iteration(const double* data, size_t count, bool check_all_ints) noexcept
+    {
+        return check_all_ints ? First_Iteration<true>(data, count) : First_Iteration<false>(data, count);
+    }
+
+    double Second_Iteration(const double* data, size_t count, const TSecond_Iteration_Params& params, CHistogram& histogram)
+    {
+        return params.scale_down ? Second_Iteration<TSecond_Iteration_Policy<true>>(data, count, params, histogram)
+                                 : Second_Iteration<TSecond_Iteration_Policy<false>>(data, count, params, histogram);
+    }
+
+    void Histogram(std::span<const double> values, std::span<const uint8_t> mask, const CHistogram::TBinning& binning, size_t* sub_histograms) noexcept
+    {
+        // Flags are added instead of ones, so there is no branch per value.
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            sub_histograms[Get_Slot(values[i], binning) * config::processing::Sub_Histograms + i % config::processing::Sub_Histograms] += mask[i];
+        }
+    }
+
+    size_t Add_Counts(size_t* dest, const size_t* src, size_t count) noexcept
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            dest[i] += src[i];
+            total += src[i];
+        }
+        return total;
+    }
+}
+
+// EOF
@@ -1,4 +1,7 @@
 #include <iomanip>
+#include <tuple>
+#include <algorithm>
+#include <filesystem>
 
 #include "file_stats.h"
 
@@ -13,6 +16,23 @@ namespace kiv_ppr
 
     int CFile_Stats::Process(config::TThread_Params* thread_config)
     {
+        // Read the input file only once.
+        if (thread_config->single_pass)
+        {
+            CSingle_Pass single_pass(m_file);
+            if (0 != single_pass.Run(thread_config))
+            {
+                return 1;
+            }
+
+            // Store the values calculated in the single pass.
+            const auto values = single_pass.Get_Values();
+            m_values.first_iteration = values.first_iteration;
+            m_values.second_iteration = values.second_iteration;
+
+            return 0;
+        }
+
         // Create an instance of the first filer iteration.
         CFirst_Iteration first_iteration(m_file);
 
@@ -40,6 +60,199 @@ namespace kiv_ppr
         return 0;
     }
 
+    int CFile_Stats::Process_Appended(config::TThread_Params* thread_config, const std::string& state_path)
+    {
+        const CState_File state_file(state_path);
+        CState_File::TRange saved_range{};
+        CSingle_Pass::TState state;
+
+        // Only whole elements are read (a producer may be just writing the last one).
+        const uint64_t end_byte = m_file->Get_File_Size() / sizeof(double) * sizeof(double);
+
+        // The range of the whole file (after this run) is created before the file is read.
+        CState_File::TRange range{};
+        if (!CState_File::Create_Range(m_file->Get_Filename(), 0, end_byte, range))
+        {
+            return 1;
+        }
+
+        // The saved state can only be continued from if the data it has been calculated from has not changed
+        // (the file has not been truncated or rewritten).
+        CState_File::TRange saved_data_range{};
+        if (state_file.Load(saved_range, state) &&
+            0 == saved_range.first_byte && saved_range.end_byte <= end_byte && 0 == saved_range.end_byte % sizeof(double) &&
+            CState_File::Create_Range(m_file->Get_Filename(), 0, saved_range.end_byte, saved_data_range) &&
+            saved_data_range.content_hash == saved_range.content_hash)
+        {
+            std::cout << "Continuing from the saved state (" << state_path << "): " << saved_range.end_byte << " B already processed, "
+                      << (end_byte - saved_range.end_byte) << " B appended" << std::endl;
+        }
+        else
+        {
+            if (std::filesystem::exists(state_path))
+            {
+                std::cout << "The saved state (" << state_path << ") does not match the input file - the whole file will be read" << std::endl;
+            }
+            else
+            {
+                std::cout << "There is no saved state (" << state_path << ") - the whole file will be read" << std::endl;
+            }
+            saved_range = {};
+            state = CSingle_Pass::TState{};
+        }
+
+        // Read only the data appended since the state was saved and merge it into the state.
+        m_file->Set_Range(saved_range.end_byte / sizeof(double), (end_byte - saved_range.end_byte) / sizeof(double));
+        CSingle_Pass single_pass(m_file, std::move(state));
+        if (0 != single_pass.Run(thread_config))
+        {
+            return 1;
+        }
+
+        // Store the values calculated from the whole file.
+        const auto values = single_pass.Get_Values();
+        m_values.first_iteration = values.first_iteration;
+        m_values.second_iteration = values.second_iteration;
+
+        // Save the state for the next run (the statistics are valid even if it fails).
+        if (!state_file.Store(range, single_pass.Get_State()))
+        {
+            std::cout << "Failed to save the state (" << state_path << ")" << std::endl;
+        }
+
+        return 0;
+    }
+
+    int CFile_Stats::Process_Part(config::TThread_Params* thread_config, const config::TPart_Params& part, const std::string& partial_path)
+    {
+        // The range is clamped to the input file and rounded down to whole elements (a value belongs to the part it starts in).
+        const uint64_t number_of_elements = m_file->Get_File_Size() / sizeof(double);
+        const uint64_t range_first = std::min<uint64_t>(part.first_byte / sizeof(double), number_of_elements);
+        const uint64_t range_end = std::max(range_first, std::min<uint64_t>(part.end_byte / sizeof(double), number_of_elements));
+
+        // Split the range into equally large shards (split up, so the multiplication does not overflow).
+        const uint64_t range_size = range_end - range_first;
+        const auto Get_Shard_Offset = [&](uint64_t shard_index) noexcept {
+            return range_size / part.shard_count * shard_index + range_size % part.shard_count * shard_index / part.shard_count;
+        };
+        const uint64_t first_element = range_first + Get_Shard_Offset(part.shard_index);
+        const uint64_t end_element = range_first + Get_Shard_Offset(part.shard_index + 1);
+
+        // The range of the part is created before the part is read.
+        CState_File::TRange range{};
+        if (!CState_File::Create_Range(m_file->Get_Filename(), first_element * sizeof(double), end_element * sizeof(double), range))
+        {
+            return 1;
+        }
+        std::cout << "Processing part <" << range.first_byte << "; " << range.end_byte << ") B of the input file"
+                  << " (shard " << part.shard_index << "/" << part.shard_count << ")" << std::endl;
+
+        // Read only the part of the input file.
+        m_file->Set_Range(static_cast<size_t>(first_element), static_cast<size_t>(end_element - first_element));
+        CSingle_Pass single_pass(m_file);
+        if (0 != single_pass.Read(thread_config))
+        {
+            return 1;
+        }
+
+        // Store the partial state, so it can be merged with the other parts.
+        if (!CState_File(partial_path).Store(range, single_pass.Get_State()))
+        {
+            std::cout << "Failed to store the partial state (" << partial_path << ")" << std::endl;
+            return 1;
+        }
+        std::cout << "Partial state of " << single_pass.Get_State().basic.count << " valid doubles stored into " << partial_path << std::endl;
+
+        return 0;
+    }
+
+    int CFile_Stats::Merge_Parts(const std::vector<std::string>& partial_paths)
+    {
+        std::vector<CState_File::TRange> ranges;
+        CSingle_Pass single_pass(nullptr);
+
+        // Load all the partial states and merge them together (the order does not matter).
+        for (const auto& partial_path : partial_paths)
+        {
+            CState_File::TRange range{};
+            CSingle_Pass::TState state;
+            if (!CState_File(partial_path).Load(range, state))
+            {
+                std::cout << "Failed to load the partial state (" << partial_path << ")" << std::endl;
+                return 1;
+            }
+            std::cout << "Partial state " << partial_path << ": <" << range.first_byte << "; " << range.end_byte << ") B of an input file ["
+                      << range.file_size << " B], " << state.basic.count << " valid doubles" << std::endl;
+
+            single_pass.Merge_State(state);
+            ranges.push_back(range);
+        }
+
+        // The values of overlapping parts would be counted twice.
+        if (!Check_Parts(std::move(ranges)))
+        {
+            return 1;
+        }
+
+        // Calculate the final values from the merged state.
+        if (0 != single_pass.Run_Merged())
+        {
+            std::cout << "The partial states do not contain any valid doubles" << std::endl;
+            return 1;
+        }
+        const auto values = single_pass.Get_Values();
+        m_values.first_iteration = values.first_iteration;
+        m_values.second_iteration = values.second_iteration;
+
+        return 0;
+    }
+
+    bool CFile_Stats::Check_Parts(std::vector<CState_File::TRange> ranges)
+    {
+        // Sort the parts by the input file they belong to and by their offset.
+        std::sort(ranges.begin(), ranges.end(), [](const CState_File::TRange& lhs, const CState_File::TRange& rhs) noexcept {
+            return std::tie(lhs.file_size, lhs.file_hash, lhs.first_byte, lhs.end_byte) < std::tie(rhs.file_size, rhs.file_hash, rhs.first_byte, rhs.end_byte);
+        });
+
+        bool valid = true;
+        uint64_t covered_end = 0; // Offset past the bytes of the current input file covered by the parts checked so far
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            const auto& range = ranges[i];
+            const bool first_part = 0 == i || ranges[i - 1].file_size != range.file_size || ranges[i - 1].file_hash != range.file_hash;
+            const bool last_part = ranges.size() - 1 == i || ranges[i + 1].file_size != range.file_size || ranges[i + 1].file_hash != range.file_hash;
+            if (first_part)
+            {
+                covered_end = 0;
+            }
+
+            // The part overlaps with a previous part of the same input file (empty parts do not hold any values).
+            if (range.first_byte < covered_end && range.first_byte < range.end_byte)
+            {
+                std::cout << "Part <" << range.first_byte << "; " << range.end_byte << ") B of an input file [" << range.file_size
+                          << " B] overlaps with another part of the file" << std::endl;
+                valid = false;
+            }
+
+            // Report the data of the input file that is not covered by any part (only whole doubles are processed).
+            if (range.first_byte > covered_end)
+            {
+                std::cout << "Bytes <" << covered_end << "; " << range.first_byte << ") of an input file [" << range.file_size
+                          << " B] are not covered by any partial state" << std::endl;
+            }
+            covered_end = std::max(covered_end, range.end_byte);
+
+            const uint64_t file_end = range.file_size / sizeof(double) * sizeof(double);
+            if (last_part && covered_end < file_end)
+            {
+                std::cout << "Bytes <" << covered_end << "; " << file_end << ") of an input file [" << range.file_size
+                          << " B] are not covered by any partial state" << std::endl;
+            }
+        }
+
+        return valid;
+    }
+
     typename CFile_Stats::TValues CFile_Stats::Get_Values() const noexcept
     {
         return m_values;
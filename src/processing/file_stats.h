@@ -1,10 +1,14 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <vector>
 #include <iostream>
 
 #include "first_iteration.h"
 #include "second_iteration.h"
+#include "single_pass.h"
+#include "state_file.h"
 #include "../utils/file_reader.h"
 #include "histogram.h"
 #include "../config.h"
@@ -47,11 +51,42 @@ namespace kiv_ppr
         [[nodiscard]] TValues Get_Values() const noexcept;
 
         /// Calculates statistical values from the input file. It is carried out
-        /// in two iterations (the file is read up twice).
+        /// in two iterations (the file is read up twice) or in a single pass (see CSingle_Pass).
         /// \param thread_config Configuration containing how many threads should be used to process the input file.
         /// \return 0, if all goes well. 1, if it failed to process the input file.
         [[nodiscard]] int Process(config::TThread_Params* thread_config);
 
+        /// Calculates statistical values incrementally (append mode). The mergeable state saved in the previous run
+        /// is loaded (see CState_File) and only the data appended to the input file since then is read (single pass).
+        /// The state of the whole file is then saved for the next run. If there is no saved state or the data
+        /// it has been calculated from has changed, the whole input file is read.
+        /// \param thread_config Configuration containing how many threads should be used to process the input file.
+        /// \param state_path Path to the file holding the state saved in the previous run
+        /// \return 0, if all goes well. 1, if it failed to process the input file.
+        [[nodiscard]] int Process_Appended(config::TThread_Params* thread_config, const std::string& state_path);
+
+        /// Calculates the partial state of a part of the input file (partial mode). The part is read in a single pass
+        /// and its mergeable state is stored (see CState_File), so it can be merged with the partial states
+        /// of the other parts (which may be processed on other nodes) by Merge_Parts. No final values are calculated.
+        /// \param thread_config Configuration containing how many threads should be used to process the input file.
+        /// \param part Part of the input file to be processed (byte range, shard)
+        /// \param partial_path Path to the file the partial state is stored into
+        /// \return 0, if all goes well. 1, if it failed to process the part or to store the partial state.
+        [[nodiscard]] int Process_Part(config::TThread_Params* thread_config, const config::TPart_Params& part, const std::string& partial_path);
+
+        /// Calculates statistical values by merging partial states (merge mode, see Process_Part). The input file is not read,
+        /// so the file reader may be NULL. Parts of the same input file must not overlap. If they do not cover the whole file,
+        /// the missing bytes are reported, but the values are still calculated.
+        /// \param partial_paths Paths to the files holding the partial states
+        /// \return 0, if all goes well. 1, if a partial state could not be loaded, the parts overlap, or there are no valid doubles.
+        [[nodiscard]] int Merge_Parts(const std::vector<std::string>& partial_paths);
+
+    private:
+        /// Checks out the parts of the input files partial states have been calculated from.
+        /// \param ranges Ranges of the parts (the parts of the same input file share its size and hash)
+        /// \return true, if no two parts of the same input file overlap, false otherwise.
+        [[nodiscard]] static bool Check_Parts(std::vector<CState_File::TRange> ranges);
+
     private:
         CFile_Reader<double>* m_file; ///< Pointer to an input file reader.
         TValues m_values;             ///< Statistical values calculated from the input file.
@@ -7,15 +7,15 @@
 #include "../utils/utils.h"
 #include "../utils/singleton.h"
 #include "../utils/resource_manager.h"
-#include "../utils/resource_guard.h"
+#include "../utils/thread_pool.h"
 #include "first_iteration.h"
+#include "cpu_kernels.h"
 
 namespace kiv_ppr
 {
     CFirst_Iteration::CFirst_Iteration(CFile_Reader<double>* file) noexcept
         : m_file(file),
-          m_values{},
-          m_worker_means{}
+          m_values{}
     {
 
     }
@@ -33,11 +33,31 @@ namespace kiv_ppr
         // Create a new watchdog instance.
         CWatchdog watchdog(thread_config->watchdog_expiration_sec);
 
-        // Create a container for all the workers.
-        std::vector<std::future<int>> workers(thread_config->number_of_threads);
-        for (auto& worker : workers)
+        // Make sure that the thread pool is not NULL.
+        auto thread_pool = Singleton<CThread_Pool>::Get_Instance();
+        if (nullptr == thread_pool)
+        {
+            std::cout << "Error: thread pool is NULL" << std::endl;
+            std::exit(24);
+        }
+
+        // Make sure that the resource manager is not NULL.
+        auto resource_manager = Singleton<CResource_Manager>::Get_Instance();
+        if (nullptr == resource_manager)
+        {
+            std::cout << "Error: resource manager is NULL" << std::endl;
+            std::exit(20);
+        }
+
+        // Create a scheduler that sizes the blocks claimed by the workers based on their throughput.
+        CWork_Scheduler scheduler(thread_config->number_of_elements_per_file_read, config::processing::Min_Block_Size_Per_Read / sizeof(double));
+
+        // Create a container for all the workers (they are executed by the thread pool) along with their result slots.
+        std::vector<std::future<int>> workers(resource_manager->Get_Number_Of_Workers(thread_config->number_of_threads));
+        CResult_Slots<TValues> results(workers.size());
+        for (size_t i = 0; i < workers.size(); ++i)
         {
-            worker = std::async(std::launch::async, &CFirst_Iteration::Worker, this, thread_config, &watchdog);
+            workers[i] = thread_pool->Submit(&CFirst_Iteration::Worker, this, thread_config, &watchdog, &scheduler, &results, i);
         }
 
         // Execute the workers and add up their return values.
@@ -51,12 +71,32 @@ namespace kiv_ppr
         // Stop the watchdog.
         watchdog.Stop();
 
-        // Aggregate the final mean from all the local means.
-        for (const auto& [mean, count] : m_worker_means)
+        // Print out how much of the work each OpenCL device (and the CPU) has done.
+        if (scheduler.Has_Devices())
         {
-            m_values.mean += mean * (static_cast<double>(count) / static_cast<double>(m_values.count));
+            std::cout << "Share of the work (first iteration):\n" << scheduler;
         }
 
+        // Merge the results of the workers (including the final mean).
+        const double merge_time = utils::Time_Call_Ms([&]() {
+            const auto merged_values = results.Reduce([](TValues& dest, const TValues& src) {
+                // A worker may have not found any valid doubles (it has no mean).
+                if (0 != src.count)
+                {
+                    Merge_Values(dest, src);
+                }
+                else
+                {
+                    dest.all_ints = dest.all_ints && src.all_ints;
+                }
+            });
+            if (nullptr != merged_values)
+            {
+                m_values = *merged_values;
+            }
+        });
+        std::cout << "Time of merging the results of the workers (first iteration) = " << merge_time << " ms" << std::endl;
+
         // Check if the entire file has been read and none of the workers returned 1 (error).
         if (return_values != 0 || watchdog.Get_Counter_Value() != m_file->Get_Number_Of_Elements())
         {
@@ -66,195 +106,192 @@ namespace kiv_ppr
         return 0;
     }
 
-    void CFirst_Iteration::Report_Worker_Results(TValues values)
+    CFirst_Iteration::TValues CFirst_Iteration::Process_Data_Block_On_CPU(const CFile_Reader<double>::TData_Block& data_block, size_t offset, bool check_all_ints) noexcept
     {
-        const std::lock_guard<std::mutex> lock(m_mtx);
-
-        m_values.min = std::min(m_values.min, values.min);
-        m_values.max = std::max(m_values.max, values.max);
-        m_values.count += values.count;
-        m_values.all_ints = m_values.all_ints && values.all_ints;
+        // Make sure that the CPU kernels are not NULL.
+        const auto cpu_kernels = Singleton<CCPU_Kernels>::Get_Instance();
+        if (nullptr == cpu_kernels)
+        {
+            std::cout << "Error: CPU kernels are NULL" << std::endl;
+            std::exit(26);
+        }
 
-        // Store the local mean from the worker along with how many 
-        // values the worker has processed (need for the final mean aggregation).
-        m_worker_means.emplace_back(values.mean, values.count);
+        return cpu_kernels->First_Iteration(data_block.data.get() + offset, data_block.count - offset, check_all_ints);
     }
 
-    inline CFirst_Iteration::TValues CFirst_Iteration::Aggregate_Results_From_GPU(
-                const std::vector<double>& out_min,
-                const std::vector<double>& out_max,
-                const std::vector<double>& out_mean,
-                const std::vector<cl_ulong>& out_count,
-                size_t total_count) noexcept
+    CFirst_Iteration::TOpenCL_Stream CFirst_Iteration::Create_OpenCL_Stream(kernels::TOpenCL_Settings& opencl, size_t capacity)
     {
-        TValues values{};
-        const size_t size = out_min.size(); // All the sizes are the same (work group count).
+        TOpenCL_Stream stream{};
 
-        for (size_t i = 0; i < size; ++i)
-        {
-            // Update the minimum.
-            if (utils::Is_Valid_Double(out_min.at(i)))
-            {
-                values.min = std::min(values.min, out_min.at(i));
-            }
+        // Initial values of the accumulator (the same as the initial values of TValues).
+        const kernels::TFirst_Iteration_Accumulator accumulator{
+            std::numeric_limits<double>::max(),
+            std::numeric_limits<double>::lowest(),
+            0.0,
+            0,
+            1
+        };
 
-            // Update the maximum.
-            if (utils::Is_Valid_Double(out_max.at(i)))
+        try
+        {
+            // Create the accumulator and copy the initial values into it.
+            stream.accumulator = cl::Buffer(opencl.context, CL_MEM_READ_WRITE, sizeof(accumulator));
+            opencl.cmd_queue.enqueueWriteBuffer(stream.accumulator, CL_TRUE, 0, sizeof(accumulator), &accumulator);
+
+            // The reduction is executed by a single work group. Its size has to be a power of two
+            // (see Adjust_Work_Group_Size), so keep dividing it by 2 until the kernel can execute it.
+            const cl::Kernel reduce_kernel(opencl.program, kernels::First_Iteration_Reduce_Kernel_Name);
+            const size_t max_work_group_size = reduce_kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(*opencl.device);
+            stream.reduce_work_group_size = opencl.work_group_size;
+            while (stream.reduce_work_group_size > 1 && stream.reduce_work_group_size > max_work_group_size)
             {
-                values.max = std::max(values.max, out_max.at(i));
+                stream.reduce_work_group_size /= 2;
             }
+        }
+        catch (const cl::Error& e)
+        {
+            kernels::Print_OpenCL_Error(e, *opencl.device);
+            std::exit(7);
+        }
 
-            // Update the mean (with regards to how many values each work group has processed).
-            if (utils::Is_Valid_Double(out_mean.at(i)))
-            {
-                values.mean += out_mean.at(i) * (out_count.at(i) / static_cast<double>(total_count));
-            }
+        for (uint32_t i = 0; i < config::processing::OpenCL_Blocks_In_Flight; ++i)
+        {
+            stream.slots.push_back(Create_OpenCL_Slot(opencl, stream, capacity));
         }
 
-        return values;
+        return stream;
     }
 
-    CFirst_Iteration::TValues CFirst_Iteration::Process_Data_Block_On_CPU(const CFile_Reader<double>::TData_Block& data_block, size_t offset) noexcept
+    CFirst_Iteration::TOpenCL_Slot CFirst_Iteration::Create_OpenCL_Slot(kernels::TOpenCL_Settings& opencl, const TOpenCL_Stream& stream, size_t capacity)
     {
-        TValues values{};
-        double delta{};
-
-        __m256d _min = _mm256_set_pd(
-            std::numeric_limits<double>::max(),
-            std::numeric_limits<double>::max(),
-            std::numeric_limits<double>::max(),
-            std::numeric_limits<double>::max()
-        );
+        TOpenCL_Slot slot{};
+        slot.capacity = capacity;
 
-        __m256d _max = _mm256_set_pd(
-            std::numeric_limits<double>::lowest(),
-            std::numeric_limits<double>::lowest(),
-            std::numeric_limits<double>::lowest(),
-            std::numeric_limits<double>::lowest()
-        );
+        // Maximum number of work groups (the last one may be only partially filled, at least one, so no buffer is empty).
+        const size_t max_work_groups_count = std::max<size_t>((capacity + opencl.work_group_size - 1) / opencl.work_group_size, 1);
 
-        std::array<double, 4> valid_doubles{};
-        std::size_t index{0};
-
-        for (size_t i = offset; i < data_block.count; ++i)
+        try
         {
-            // The value has to to be a valid double.
-            if (utils::Is_Valid_Double(data_block.data[i]))
-            {
-                // Scale it down, so we are able to calculate -DOUBLE_MAX - DOUBLE_MAX.
-                const double value = data_block.data[i] / config::processing::Scale_Factor;
-
-                // Update the minimum and maximum using SIMD instructions.
-                valid_doubles.at(index) = value;
-                if (index == 3)
-                {
-                    const auto _vals = utils::vectorization::Create_4Doubles(valid_doubles, 4, 0);
-                    _min = _mm256_min_pd(_min, _vals);
-                    _max = _mm256_max_pd(_max, _vals);
-
-                    index = 0;
-                }
-                else
-                {
-                    ++index;
-                }
-
-                // Update the mean.
-                ++values.count;
-                delta = value - values.mean;
-                values.mean += delta / values.count;
-
-                // Check if the value is an integer or not.
-                if (values.all_ints && (std::floor(data_block.data[i]) != std::ceil(data_block.data[i])))
-                {
-                    values.all_ints = false;
-                }
-            }
+            // Each slot has kernels of its own, so the arguments of the kernels do not need to be set for every block.
+            slot.kernel = cl::Kernel(opencl.program, kernels::First_Iteration_Kernel_Name);
+            slot.reduce_kernel = cl::Kernel(opencl.program, kernels::First_Iteration_Reduce_Kernel_Name);
+
+            // Create a buffer for the input values (the values are copied into it for every block).
+            slot.data = cl::Buffer(opencl.context, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, std::max<size_t>(capacity, 1) * sizeof(double));
+
+            // Create output buffers (results calculated by each work group). They never leave the device.
+            slot.out_mean = cl::Buffer(opencl.context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, max_work_groups_count * sizeof(double));
+            slot.out_min = cl::Buffer(opencl.context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, max_work_groups_count * sizeof(double));
+            slot.out_max = cl::Buffer(opencl.context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, max_work_groups_count * sizeof(double));
+            slot.out_count = cl::Buffer(opencl.context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, max_work_groups_count * sizeof(cl_ulong));
+            slot.out_all_ints = cl::Buffer(opencl.context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, max_work_groups_count * sizeof(int));
+
+            // Pass the arguments into the kernel. They stay the same for all blocks of data.
+            slot.kernel.setArg(0 , slot.data);
+
+            slot.kernel.setArg(1 , opencl.work_group_size * sizeof(double), nullptr);
+            slot.kernel.setArg(2 , opencl.work_group_size * sizeof(double), nullptr);
+            slot.kernel.setArg(3 , opencl.work_group_size * sizeof(double), nullptr);
+            slot.kernel.setArg(4 , opencl.work_group_size * sizeof(int), nullptr);
+            slot.kernel.setArg(5 , opencl.work_group_size * sizeof(cl_ulong), nullptr);
+
+            slot.kernel.setArg(6 , slot.out_min);
+            slot.kernel.setArg(7 , slot.out_max);
+            slot.kernel.setArg(8 , slot.out_mean);
+            slot.kernel.setArg(9 , slot.out_all_ints);
+            slot.kernel.setArg(10, slot.out_count);
+            slot.kernel.setArg(11, cl_ulong{0});
+
+            // Pass the arguments into the reduction (the number of work groups is set for every block).
+            slot.reduce_kernel.setArg(0 , slot.out_min);
+            slot.reduce_kernel.setArg(1 , slot.out_max);
+            slot.reduce_kernel.setArg(2 , slot.out_mean);
+            slot.reduce_kernel.setArg(3 , slot.out_all_ints);
+            slot.reduce_kernel.setArg(4 , slot.out_count);
+            slot.reduce_kernel.setArg(5 , cl_uint{0});
+
+            slot.reduce_kernel.setArg(6 , stream.reduce_work_group_size * sizeof(double), nullptr);
+            slot.reduce_kernel.setArg(7 , stream.reduce_work_group_size * sizeof(double), nullptr);
+            slot.reduce_kernel.setArg(8 , stream.reduce_work_group_size * sizeof(double), nullptr);
+            slot.reduce_kernel.setArg(9 , stream.reduce_work_group_size * sizeof(int), nullptr);
+            slot.reduce_kernel.setArg(10, stream.reduce_work_group_size * sizeof(cl_ulong), nullptr);
+
+            slot.reduce_kernel.setArg(11, stream.accumulator);
         }
-        if (index != 0)
+        catch (const cl::Error& e)
         {
-            auto _vals = utils::vectorization::Create_4Doubles(valid_doubles, index, std::numeric_limits<double>::max());
-            _min = _mm256_min_pd(_min, _vals);
-
-            _vals = utils::vectorization::Create_4Doubles(valid_doubles, index, std::numeric_limits<double>::lowest());
-            _max = _mm256_max_pd(_max, _vals);
+            kernels::Print_OpenCL_Error(e, *opencl.device);
+            std::exit(7);
         }
 
-        values.min = utils::vectorization::Aggregate(_min, std::numeric_limits<double>::max(), [](double x, double y) { return std::min(x, y); });
-        values.max = utils::vectorization::Aggregate(_max, std::numeric_limits<double>::lowest(), [](double x, double y) { return std::max(x, y); });
-
-        return values;
+        return slot;
     }
 
-    CFirst_Iteration::TOpenCL_Report CFirst_Iteration::Execute_OpenCL(kernels::TOpenCL_Settings& opencl, const CFile_Reader<double>::TData_Block& data_block)
+    size_t CFirst_Iteration::Enqueue_OpenCL(kernels::TOpenCL_Settings& opencl, TOpenCL_Stream& stream, TOpenCL_Slot& slot, const CFile_Reader<double>::TData_Block& data_block)
     {
-        // Calculate how many work groups will be needed.
-        const auto work_groups_count = data_block.count / opencl.work_group_size;
+        // Calculate how many work groups will be needed (the last one may be only partially filled).
+        const auto work_groups_count = (data_block.count + opencl.work_group_size - 1) / opencl.work_group_size;
 
-        // Calculate how many values we will be able calculate (must be a multiple of the size of one work group).
-        const size_t count = data_block.count - (data_block.count % opencl.work_group_size);
+        // The global size must be a multiple of the size of one work group. The work items
+        // past the end of the block are masked out by the kernel, so the whole block is processed on the device.
+        const size_t padded_count = work_groups_count * opencl.work_group_size;
 
-        // The number of input values is less than the size of one work group.
-        // All work will be done by the CPU.
-        if (0 == work_groups_count)
+        // The block is empty or it does not fit into the buffers. All work will be done by the CPU.
+        if (0 == work_groups_count || data_block.count > slot.capacity)
         {
-            return { false, false, {} };
+            return 0;
         }
 
-        // Create a buffer for the input values. 
-        cl::Buffer data_buff(opencl.context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_USE_HOST_PTR, count * sizeof(double), data_block.data.get());
-
-        // Create output buffers (results calculated by each work group).
-        cl::Buffer out_mean_buff(opencl.context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, work_groups_count * sizeof(double));
-        cl::Buffer out_min_buff(opencl.context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, work_groups_count * sizeof(double));
-        cl::Buffer out_max_buff(opencl.context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, work_groups_count * sizeof(double));
-        cl::Buffer out_count_buff(opencl.context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, work_groups_count * sizeof(cl_ulong));
-        cl::Buffer out_all_ints_buff(opencl.context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, work_groups_count * sizeof(int));
-
-        // Pass the arguments into the kernel. 
         try
         {
-            opencl.kernel.setArg(0 , data_buff);
+            // Copy the input values into the device.
+            cl::Event write_event;
+            opencl.cmd_queue.enqueueWriteBuffer(slot.data, CL_FALSE, 0, data_block.count * sizeof(double), data_block.data.get(), nullptr, &write_event);
+
+            // The block is released as soon as it has been copied into the device (the slot does not hold it).
+            kernels::Release_After_Write(write_event, data_block.data);
 
-            opencl.kernel.setArg(1 , opencl.work_group_size * sizeof(double), nullptr);
-            opencl.kernel.setArg(2 , opencl.work_group_size * sizeof(double), nullptr);
-            opencl.kernel.setArg(3 , opencl.work_group_size * sizeof(double), nullptr);
-            opencl.kernel.setArg(4 , opencl.work_group_size * sizeof(int), nullptr);
-            opencl.kernel.setArg(5 , opencl.work_group_size * sizeof(cl_ulong), nullptr);
+            // Pass the number of values in the block into the kernel (the rest of the work items is masked out).
+            slot.kernel.setArg(11, static_cast<cl_ulong>(data_block.count));
 
-            opencl.kernel.setArg(6 , out_min_buff);
-            opencl.kernel.setArg(7 , out_max_buff);
-            opencl.kernel.setArg(8 , out_mean_buff);
-            opencl.kernel.setArg(9 , out_all_ints_buff);
-            opencl.kernel.setArg(10, out_count_buff);
+            // Pass the kernel into the OpenCL device ("start the program") once the values have been copied.
+            const std::vector<cl::Event> kernel_dependencies{ write_event };
+            cl::Event kernel_event;
+            opencl.cmd_queue.enqueueNDRangeKernel(slot.kernel, cl::NullRange, cl::NDRange(padded_count), cl::NDRange(opencl.work_group_size), &kernel_dependencies, &kernel_event);
+
+            // Merge the results of the work groups into the accumulator once the kernel has finished
+            // and the previous block has been merged (the blocks are merged one at a time).
+            std::vector<cl::Event> reduce_dependencies{ kernel_event };
+            if (stream.has_reduce_event)
+            {
+                reduce_dependencies.push_back(stream.last_reduce_event);
+            }
+            slot.reduce_kernel.setArg(5, static_cast<cl_uint>(work_groups_count));
+            opencl.cmd_queue.enqueueNDRangeKernel(slot.reduce_kernel, cl::NullRange, cl::NDRange(stream.reduce_work_group_size), cl::NDRange(stream.reduce_work_group_size), &reduce_dependencies, &slot.done_event);
+
+            // Make sure the device starts working while we are reading the next block.
+            opencl.cmd_queue.flush();
         }
         catch (const cl::Error& e)
         {
             kernels::Print_OpenCL_Error(e, *opencl.device);
-            std::exit(7);
+            std::exit(9);
         }
 
-        // Create output CPU buffers to store the results from the OpenCL device to.
-        std::vector<double> out_min(work_groups_count);
-        std::vector<double> out_max(work_groups_count);
-        std::vector<double> out_mean(work_groups_count);
-        std::vector<cl_ulong> out_count(work_groups_count);
-        std::vector<int> out_all_ints(work_groups_count);
-        
-        try
-        {
-            // Create a command queue to communicate with the OpenCL device.
-            cl::CommandQueue cmd_queue(opencl.context, *opencl.device);
+        stream.last_reduce_event = slot.done_event;
+        stream.has_reduce_event = true;
 
-            // Pass the kernel into the OpenCL device ("start the program").
-            cmd_queue.enqueueNDRangeKernel(opencl.kernel, cl::NullRange, cl::NDRange(count), cl::NDRange(opencl.work_group_size));
+        slot.busy = true;
 
-            // Read the results from the OpenCL device.
-            cmd_queue.enqueueReadBuffer(out_mean_buff, CL_TRUE, 0, out_mean.size() * sizeof(double), out_mean.data());
-            cmd_queue.enqueueReadBuffer(out_min_buff, CL_TRUE, 0, out_min.size() * sizeof(double), out_min.data());
-            cmd_queue.enqueueReadBuffer(out_max_buff, CL_TRUE, 0, out_max.size() * sizeof(double), out_max.data());
-            cmd_queue.enqueueReadBuffer(out_count_buff, CL_TRUE, 0, out_count.size() * sizeof(cl_ulong), out_count.data());
-            cmd_queue.enqueueReadBuffer(out_all_ints_buff, CL_TRUE, 0, out_all_ints.size() * sizeof(int), out_all_ints.data());
+        return data_block.count;
+    }
+
+    void CFirst_Iteration::Finish_OpenCL(kernels::TOpenCL_Settings& opencl, TOpenCL_Slot& slot)
+    {
+        try
+        {
+            // Wait for the block to be merged into the accumulator.
+            slot.done_event.wait();
         }
         catch (const cl::Error& e)
         {
@@ -262,30 +299,52 @@ namespace kiv_ppr
             std::exit(9);
         }
 
-        size_t number_of_valid_doubles = 0;
-        bool all_ints = true;
+        // Release the slot.
+        slot.busy = false;
+    }
 
-        // Calculate the total sum of valid doubles as well as if all values are integers.
-        for (size_t i = 0; i < work_groups_count; ++i)
+    void CFirst_Iteration::Flush_OpenCL(TValues& local_values, kernels::TOpenCL_Settings& opencl, TOpenCL_Stream& stream)
+    {
+        // Nothing has been processed on the device.
+        if (!stream.has_reduce_event)
         {
-            number_of_valid_doubles += out_count.at(i);
-            all_ints = all_ints && out_all_ints.at(i);
+            return;
         }
 
-        // Aggregate the values calculated by individual worker groups.
-        const auto aggregated_vals = Aggregate_Results_From_GPU(out_min, out_max, out_mean, out_count, number_of_valid_doubles);
+        // Read the accumulator once all blocks have been merged into it (the merges are chained, so it is enough to wait for the last one).
+        kernels::TFirst_Iteration_Accumulator accumulator{};
+        try
+        {
+            const std::vector<cl::Event> read_dependencies{ stream.last_reduce_event };
+            opencl.cmd_queue.enqueueReadBuffer(stream.accumulator, CL_TRUE, 0, sizeof(accumulator), &accumulator, &read_dependencies);
+        }
+        catch (const cl::Error& e)
+        {
+            kernels::Print_OpenCL_Error(e, *opencl.device);
+            std::exit(9);
+        }
 
-        // Return an OpenCL report (how many numbers were processed, calculated values, etc.)
-        return { true, count == data_block.count, {
-            aggregated_vals.min,
-            aggregated_vals.max,
-            aggregated_vals.mean,
-            number_of_valid_doubles,
-            all_ints
-        } };
+        // All blocks are done, so the slots can be released.
+        for (auto& slot : stream.slots)
+        {
+            if (slot.busy)
+            {
+                Finish_OpenCL(opencl, slot);
+            }
+        }
+
+        // Merge the values calculated on the OpenCL device into the local values.
+        if (0 != accumulator.count)
+        {
+            Merge_Values(local_values, { accumulator.min, accumulator.max, accumulator.mean, accumulator.count, 0 != accumulator.all_ints });
+        }
+        else
+        {
+            local_values.all_ints = local_values.all_ints && (0 != accumulator.all_ints);
+        }
     }
 
-    int CFirst_Iteration::Worker(const config::TThread_Params* thread_config, CWatchdog* watchdog)
+    int CFirst_Iteration::Worker(const config::TThread_Params* thread_config, CWatchdog* watchdog, CWork_Scheduler* scheduler, CResult_Slots<TValues>* results, size_t slot)
     {
         TValues local_values{}; // Local values (each worker has its own).
 
@@ -305,8 +364,8 @@ namespace kiv_ppr
         }
 
         const cl::Device* device = nullptr;
-        kernels::TOpenCL_Settings opencl;
-        CResource_Guard opencl_device_guard;
+        kernels::TOpenCL_Settings* opencl = nullptr;
+        TOpenCL_Stream opencl_stream{};
         bool use_cpu = false;
 
         // Get the mode in which the program was started (SMP, ALL, ...).
@@ -319,8 +378,8 @@ namespace kiv_ppr
         }
         if (run_type == CArg_Parser::NRun_Type::All || run_type == CArg_Parser::NRun_Type::OpenCL_Devs)
         {
-            // Find any OpenCL device available.
-            device = resource_manager->Get_Available_Device();
+            // Get the OpenCL device of this thread (the thread holds it across both iterations).
+            device = kernels::Get_Worker_Device();
 
             // If there is no device available and the user ran the program in the 'ALL' mode, use the CPU.
             // Otherwise, return (the user only wants to use OpenCL device).
@@ -334,21 +393,23 @@ namespace kiv_ppr
             }
         }
         
-        // If the worker obtained an OpenCL device.
+        // If the worker obtained an OpenCL device, get the kernel (it is compiled only once per thread).
         if (nullptr != device)
         {
-            opencl = kernels::Init_OpenCL(device, kernels::First_Iteration_Kernel, kernels::First_Iteration_Kernel_Name);
-            kernels::Adjust_Work_Group_Size(opencl, kernels::First_Iteration_Get_Size_Of_Local_Params);
-            opencl_device_guard.Set_Device(device);
+            opencl = &kernels::Get_Worker_OpenCL(device, kernels::First_Iteration_Kernel, kernels::First_Iteration_Kernel_Name, kernels::First_Iteration_Get_Size_Of_Local_Params);
+            opencl_stream = Create_OpenCL_Stream(*opencl, thread_config->number_of_elements_per_file_read);
         }
 
+        // Register the worker in the scheduler (the workers feeding an OpenCL device are reported under its name).
+        const size_t worker_id = scheduler->Register_Worker(nullptr == device ? CWork_Scheduler::CPU_Name : device->getInfo<CL_DEVICE_NAME>().c_str());
+
         // Start the watchdog
         watchdog->Start();
 
         while (true)
         {
-            // Read a block of data.
-            auto data_block = m_file->Read_Data(thread_config->number_of_elements_per_file_read);
+            // Read a block of data (its size is given by the throughput of the worker and the remaining work).
+            auto data_block = m_file->Read_Data(scheduler->Get_Block_Size(worker_id, m_file->Get_Number_Of_Remaining_Elements()));
 
             switch (data_block.status)
             {
@@ -360,17 +421,23 @@ namespace kiv_ppr
                     }
                     else
                     {
-                        Execute_On_GPU(local_values, data_block, opencl);
+                        Execute_On_GPU(local_values, data_block, *opencl, opencl_stream);
                     }
 
-                    // Kick the watchdog.
+                    // Kick the watchdog and let the scheduler know how much work has been done.
                     watchdog->Kick(data_block.count);
+                    scheduler->Report(worker_id, data_block.count);
                     break;
 
-                // The end of the file has been reached, so report
-                // the results (local values to the farmer).
+                // The end of the file has been reached, so publish
+                // the results (local values) into the slot of the worker.
                 case CFile_Reader<double>::NRead_Status::EOF_:
-                    Report_Worker_Results(local_values);
+                    if (!use_cpu)
+                    {
+                        // Wait for the blocks still being processed on the OpenCL device.
+                        Flush_OpenCL(local_values, *opencl, opencl_stream);
+                    }
+                    results->Publish(slot, local_values);
                     return 0;
 
                 // An error has ocurred. Inform the farmer that we failed to read the file.
@@ -383,101 +450,36 @@ namespace kiv_ppr
 
     void CFirst_Iteration::Execute_On_CPU(TValues& local_values, const CFile_Reader<double>::TData_Block& data_block)
     {
-        __m256d _min = _mm256_set_pd(
-            std::numeric_limits<double>::max(),
-            std::numeric_limits<double>::max(),
-            std::numeric_limits<double>::max(),
-            std::numeric_limits<double>::max()
-        );
-
-        __m256d _max = _mm256_set_pd(
-            std::numeric_limits<double>::lowest(),
-            std::numeric_limits<double>::lowest(),
-            std::numeric_limits<double>::lowest(),
-            std::numeric_limits<double>::lowest()
-        );
-
-        std::array<double, 4> valid_doubles{};
-        std::size_t index{0};
-
-        for (auto i = 0; i < data_block.count; ++i)
+        // Once a value that is not an integer has been found, the rest of the values do not have to be checked.
+        const auto block_values = Process_Data_Block_On_CPU(data_block, 0, local_values.all_ints);
+        if (0 != block_values.count)
         {
-            double value = data_block.data[i];
-
-            // Filter out valid doubles.
-            if (utils::Is_Valid_Double(value))
-            {
-                // Update all_ints.
-                if (local_values.all_ints && (std::floor(value) != std::ceil(value)))
-                {
-                    local_values.all_ints = false;
-                }
-
-                // Scale the value down, so the mean does not overflow.
-                value /= config::processing::Scale_Factor;
-
-                // Update the minimum and maximum using SIMD instructions.
-                valid_doubles.at(index) = value;
-                if (index == 3)
-                {
-                    const auto _vals = utils::vectorization::Create_4Doubles(valid_doubles, 4, 0);
-                    _min = _mm256_min_pd(_min, _vals);
-                    _max = _mm256_max_pd(_max, _vals);
-
-                    index = 0;
-                }
-                else
-                {
-                    ++index;
-                }
-
-                // Update the mean.
-                ++local_values.count;
-                const double delta = value - local_values.mean;
-                local_values.mean += delta / static_cast<double>(local_values.count);
-            }
+            Merge_Values(local_values, block_values);
         }
-        if (index != 0)
+        else
         {
-            auto _vals = utils::vectorization::Create_4Doubles(valid_doubles, index, std::numeric_limits<double>::max());
-            _min = _mm256_min_pd(_min, _vals);
-
-            _vals = utils::vectorization::Create_4Doubles(valid_doubles, index, std::numeric_limits<double>::lowest());
-            _max = _mm256_max_pd(_max, _vals);
+            local_values.all_ints = local_values.all_ints && block_values.all_ints;
         }
-
-        const double min = utils::vectorization::Aggregate(_min, std::numeric_limits<double>::max(), [](double x, double y) { return std::min(x, y); });
-        const double max = utils::vectorization::Aggregate(_max, std::numeric_limits<double>::lowest(), [](double x, double y) { return std::max(x, y); });
-
-        local_values.min = std::min(local_values.min, min);
-        local_values.max = std::max(local_values.max, max);
     }
 
-    void CFirst_Iteration::Execute_On_GPU(TValues& local_values, const CFile_Reader<double>::TData_Block& data_block, kernels::TOpenCL_Settings& opencl)
+    void CFirst_Iteration::Execute_On_GPU(TValues& local_values, const CFile_Reader<double>::TData_Block& data_block, kernels::TOpenCL_Settings& opencl, TOpenCL_Stream& stream)
     {
-        // Process as much data of the block of data on the OpenCL device as you can.
-        const auto opencl_report = Execute_OpenCL(opencl, data_block);
-
-        // Store the calculated statistical values.
-        TValues gpu_values = opencl_report.values;
-
-        // If the number of values < work_group_size, we have to process it all on the CPU.
-        if (!opencl_report.success)
+        // Take the next slot. If it is still busy, wait for its block (the oldest one in flight) first.
+        auto& slot = stream.slots.at(stream.next);
+        stream.next = (stream.next + 1) % stream.slots.size();
+        if (slot.busy)
         {
-            gpu_values = Process_Data_Block_On_CPU(data_block, 0);
+            Finish_OpenCL(opencl, slot);
         }
-        else if (!opencl_report.all_processed)
-        {
-            // Process the remaining part on the CPU.
-            const size_t offset = data_block.count - (data_block.count % opencl.work_group_size);
-            const auto cpu_values = Process_Data_Block_On_CPU(data_block, offset);
 
-            // Merge the values calculated on the CPU into the values calculated on the OpenCL device.
-            Merge_Values(gpu_values, cpu_values);
-        }
+        // Process as much data of the block of data on the OpenCL device as you can.
+        const size_t count = Enqueue_OpenCL(opencl, stream, slot, data_block);
 
-        // Merge the values into local values.
-        Merge_Values(local_values, gpu_values);
+        // The block does not fit into the buffers of the device, so we have to process it all on the CPU.
+        if (0 == count)
+        {
+            Execute_On_CPU(local_values, data_block);
+        }
     }
 
     void CFirst_Iteration::Merge_Values(TValues& dest, const TValues& src) noexcept
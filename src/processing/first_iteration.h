@@ -1,13 +1,14 @@
 #pragma once
 
-#include <mutex>
 #include <utility>
 #include <functional>
 
 #include "../config.h"
 #include "../utils/file_reader.h"
 #include "../utils/watchdog.h"
+#include "../utils/result_slots.h"
 #include "gpu_kernels.h"
+#include "work_scheduler.h"
 
 namespace kiv_ppr
 {
@@ -20,10 +21,6 @@ namespace kiv_ppr
     class CFirst_Iteration
     {
     public:
-        /// Used when aggregating means calculated by different worker
-        /// threads (we need to know how many values make up the mean).
-        using Worker_Mean_t = std::pair<double, size_t>;
-
         /// Statistical values calculated in the first iteration.
         struct TValues
         {
@@ -52,44 +49,79 @@ namespace kiv_ppr
         [[nodiscard]] int Run(config::TThread_Params* thread_config);
 
     private:
-        /// Report from an OpenCL device after it finishes given work.
-        struct TOpenCL_Report
+        /// Block of data being processed on an OpenCL device. Each slot has its own kernels and buffers
+        /// (allocated once, sized for the block size), so several blocks can be in flight at the same time.
+        struct TOpenCL_Slot
         {
-            bool success;       ///< Flag indicating if the device successfully finished given work
-            bool all_processed; ///< Flag indicating whether all values have been processed or not
-            TValues values;     ///< Calculated values using OpenCL
+            size_t capacity = 0;                        ///< Maximum number of values in a block of data
+            cl::Kernel kernel{};                        ///< Kernel (its arguments are set only once)
+            cl::Kernel reduce_kernel{};                 ///< Kernel merging the results of the work groups into the accumulator
+            cl::Buffer data{};                          ///< Input values
+            cl::Buffer out_min{};                       ///< Minimums calculated by individual work groups
+            cl::Buffer out_max{};                       ///< Maximums calculated by individual work groups
+            cl::Buffer out_mean{};                      ///< Means calculated by individual work groups
+            cl::Buffer out_count{};                     ///< Number of valid doubles counted by individual work groups
+            cl::Buffer out_all_ints{};                  ///< Flags indicating whether all values of a work group are integers
+            bool busy = false;                          ///< Flag indicating whether a block is being processed
+            cl::Event done_event{};                     ///< Event of merging the results of the block into the accumulator
         };
 
-    private:
-        /// Reports local values (from a thread) to the farmer. 
-        /// \param values Values calculated by a worker thread.
-        void Report_Worker_Results(TValues values);
+        /// Blocks of data in flight on an OpenCL device (used in a round robin fashion). The results of all blocks
+        /// are merged into an accumulator that stays on the device, so it is read only once, at the end.
+        struct TOpenCL_Stream
+        {
+            std::vector<TOpenCL_Slot> slots{}; ///< Slots
+            size_t next = 0;                   ///< Index of the slot the next block goes to
+            cl::Buffer accumulator{};          ///< Values accumulated across all blocks (kernels::TFirst_Iteration_Accumulator)
+            cl::Event last_reduce_event{};     ///< Event of the last merge into the accumulator (the merges must not overlap)
+            bool has_reduce_event = false;     ///< Flag indicating whether any block has been merged into the accumulator yet
+            size_t reduce_work_group_size = 0; ///< Size of the work group reducing the results of one block
+        };
 
+    private:
         /// Worker thread that processes one junk of data from the input file.
-        /// After the piece of data is processed, it reports the statistics to the farmer.
+        /// After the piece of data is processed, it publishes the statistics into its slot (the farmer merges the slots).
         /// \param thread_config Configuration containing the size of a data block processed by each thread
         /// \param watchdog Watchdog the thread periodically reports to (health check)
+        /// \param scheduler Scheduler deciding how many values the thread claims at a time
+        /// \param results Slots the workers publish their results into
+        /// \param slot Index of the slot of the worker
         /// \return 0, if all went well, 1 otherwise (e.g. failed to read the input file).
-        [[nodiscard]] int Worker(const config::TThread_Params* thread_config, CWatchdog* watchdog);
+        [[nodiscard]] int Worker(const config::TThread_Params* thread_config, CWatchdog* watchdog, CWork_Scheduler* scheduler, CResult_Slots<TValues>* results, size_t slot);
+
+        /// Creates the slots of an OpenCL device along with the accumulator the results of all blocks are merged into.
+        /// \param opencl OpenCL configuration (device, context, work group size, ...)
+        /// \param capacity Maximum number of values in a block of data
+        /// \return Blocks in flight on the device (all slots are free)
+        [[nodiscard]] static TOpenCL_Stream Create_OpenCL_Stream(kernels::TOpenCL_Settings& opencl, size_t capacity);
 
-        /// Processes a block of data read from the input file on an OpenCL device.
+        /// Creates a slot of an OpenCL device: allocates the buffers and passes them into the kernels (the arguments never change,
+        /// except for the number of work groups passed into the reduction).
         /// \param opencl OpenCL configuration (device, context, work group size, ...)
+        /// \param stream Stream the slot belongs to (holds the accumulator)
+        /// \param capacity Maximum number of values in a block of data
+        /// \return Slot of the OpenCL device
+        [[nodiscard]] static TOpenCL_Slot Create_OpenCL_Slot(kernels::TOpenCL_Settings& opencl, const TOpenCL_Stream& stream, size_t capacity);
+
+        /// Enqueues a block of data into an OpenCL device without waiting for the results.
+        /// The copy into the device, the kernel and the reduction into the accumulator are chained using events.
+        /// \param opencl OpenCL configuration (device, context, work group size, ...)
+        /// \param stream Stream the slot belongs to (holds the accumulator)
+        /// \param slot Free slot of the device
         /// \param data_block Block of data to be processed
-        /// \return OpenCL report (whether the data was processed successfully or not and how many values were not processed due to the work group size).
-        [[nodiscard]] TOpenCL_Report Execute_OpenCL(kernels::TOpenCL_Settings& opencl, const CFile_Reader<double>::TData_Block& data_block);
-
-        /// Aggregates values calculated on an OpenCL device.
-        /// \param out_min Minimums calculated by individual work groups
-        /// \param out_max Maximums calculated by individual work groups
-        /// \param out_mean Means calculated by individual work groups
-        /// \param out_count Number of valid doubles counted by individual work groups
-        /// \param total_count Total number of valid number counted across all work groups
-        /// \return Aggregated values calculated on an OpenCL device.
-        [[nodiscard]] static TValues Aggregate_Results_From_GPU(const std::vector<double>& out_min,
-                                                                const std::vector<double>& out_max, 
-                                                                const std::vector<double>& out_mean,
-                                                                const std::vector<cl_ulong>& out_count,
-                                                                size_t total_count) noexcept;
+        /// \return Number of values enqueued (the whole block, 0 if the block does not fit into the buffers of the slot).
+        [[nodiscard]] static size_t Enqueue_OpenCL(kernels::TOpenCL_Settings& opencl, TOpenCL_Stream& stream, TOpenCL_Slot& slot, const CFile_Reader<double>::TData_Block& data_block);
+
+        /// Waits until the block of a slot is merged into the accumulator. The slot becomes free.
+        /// \param opencl OpenCL configuration (device, context, work group size, ...)
+        /// \param slot Busy slot of the device
+        static void Finish_OpenCL(kernels::TOpenCL_Settings& opencl, TOpenCL_Slot& slot);
+
+        /// Waits for all blocks in flight, reads the accumulator back from the device and merges it into the local values.
+        /// \param local_values Local values being calculated within a single worker thread.
+        /// \param opencl OpenCL configuration (device, context, work group size, ...)
+        /// \param stream Blocks in flight on the device
+        void Flush_OpenCL(TValues& local_values, kernels::TOpenCL_Settings& opencl, TOpenCL_Stream& stream);
 
         /// Processes a block of data read from the input file on the CPU.
         /// This method directly modifies the local_values structure passed in as a parameter.
@@ -97,29 +129,32 @@ namespace kiv_ppr
         /// \param data_block Block of data to be processed.
         void Execute_On_CPU(TValues& local_values, const CFile_Reader<double>::TData_Block& data_block);
 
-        /// Processes a block of data read from the input file on an OpenCL device.
+        /// Processes a block of data read from the input file on an OpenCL device. The block is enqueued into the next slot
+        /// of the device (waiting for the block previously held by the slot to be merged into the accumulator), so the device works on it
+        /// while the worker reads the next block. The whole block is processed on the device (the launch is padded up to a multiple
+        /// of the work group size and the kernel masks out the extra work items).
         /// This method directly modifies the local_values structure passed in as a parameter.
         /// \param local_values Local values being calculated within a single worker thread.
         /// \param data_block Block of data to be processed.
         /// \param opencl OpenCL configuration (device, context, work group size, ...)
-        void Execute_On_GPU(TValues& local_values, const CFile_Reader<double>::TData_Block& data_block, kernels::TOpenCL_Settings& opencl);
+        /// \param stream Blocks in flight on the device
+        void Execute_On_GPU(TValues& local_values, const CFile_Reader<double>::TData_Block& data_block, kernels::TOpenCL_Settings& opencl, TOpenCL_Stream& stream);
 
-        /// Processes the reaming values that the OpenCL device did not calculate (due to its work group size).
+        /// Processes a block of data (starting at the given offset) on the CPU using the kernel selected at startup (see CCPU_Kernels).
         /// \param data_block Block of data to be processed.
-        /// \param offset Number of values the OpenCL device did process (where it should start from).
+        /// \param offset Index of the first value to be processed.
+        /// \param check_all_ints Flag indicating whether the values should be checked for being integers (false = all_ints is false).
         /// \return Calculated values (statistics)
-        [[nodiscard]] TValues Process_Data_Block_On_CPU(const CFile_Reader<double>::TData_Block& data_block, size_t offset) noexcept;
+        [[nodiscard]] TValues Process_Data_Block_On_CPU(const CFile_Reader<double>::TData_Block& data_block, size_t offset, bool check_all_ints) noexcept;
 
-        /// Merges values calculated on an OpenCL device and on the CPU.
+        /// Merges values calculated on an OpenCL device and on the CPU (or by two workers).
         /// \param dest Destination values that will be modified (result).
         /// \param src The other set of data to be merged into the first set of data.
-        void Merge_Values(TValues& dest, const TValues& src) noexcept;
+        static void Merge_Values(TValues& dest, const TValues& src) noexcept;
 
     private:
-        CFile_Reader<double>* m_file;              ///< Pointer to the input file reader
-        TValues m_values;                          ///< Statistical values calculated in the first iteration
-        std::mutex m_mtx;                          ///< Mutex used in the Farmer-Worker scheme
-        std::vector<Worker_Mean_t> m_worker_means; ///< Means calculated by individual workers
+        CFile_Reader<double>* m_file; ///< Pointer to the input file reader
+        TValues m_values;             ///< Statistical values calculated in the first iteration
     };
 }
 
@@ -2,31 +2,116 @@
 #include <string.h>
 
 #include "gpu_kernels.h"
+#include "../utils/singleton.h"
+#include "../utils/resource_manager.h"
+#include "program_cache.h"
 
 namespace kiv_ppr::kernels
 {
-    TOpenCL_Settings Init_OpenCL(const cl::Device* device, const char* src, const char* kernel_name)
+    /// OpenCL state of a worker thread. It lives as long as the thread does.
+    struct TWorker_OpenCL
+    {
+        bool device_requested = false;                   ///< Flag indicating whether the thread has already asked for a device
+        const cl::Device* device = nullptr;              ///< OpenCL device held by the thread
+        const cl::Device* context_device = nullptr;      ///< OpenCL device the context and the command queue have been created for
+        cl::Context context{};                           ///< Context shared by all kernels of the thread
+        cl::CommandQueue cmd_queue{};                    ///< Command queue shared by all kernels of the thread
+        std::map<std::string, TOpenCL_Settings> kernels; ///< Compiled kernels (kernel name -> settings)
+    };
+
+    /// OpenCL state of the current worker thread.
+    static thread_local TWorker_OpenCL t_worker_opencl;
+
+    const cl::Device* Get_Worker_Device()
+    {
+        if (!t_worker_opencl.device_requested)
+        {
+            auto resource_manager = Singleton<CResource_Manager>::Get_Instance();
+            if (nullptr == resource_manager)
+            {
+                std::cout << "Error: resource manager is NULL" << std::endl;
+                std::exit(20);
+            }
+
+            // The device is never released - the thread keeps it for the whole run.
+            t_worker_opencl.device = resource_manager->Get_Available_Device();
+            t_worker_opencl.device_requested = true;
+        }
+        return t_worker_opencl.device;
+    }
+
+    TOpenCL_Settings& Get_Worker_OpenCL(const cl::Device* device, const char* src, const char* kernel_name, size_t size_of_local_params, size_t size_of_shared_local_params)
+    {
+        // Create the context and the command queue only once, so all kernels of the thread (both iterations) share them.
+        if (t_worker_opencl.context_device != device)
+        {
+            Init_OpenCL_Context(device, t_worker_opencl.context, t_worker_opencl.cmd_queue);
+            t_worker_opencl.context_device = device;
+        }
+
+        auto it = t_worker_opencl.kernels.find(kernel_name);
+        if (it == t_worker_opencl.kernels.end() || it->second.device != device)
+        {
+            auto opencl = Init_OpenCL(device, t_worker_opencl.context, t_worker_opencl.cmd_queue, src, kernel_name);
+            Adjust_Work_Group_Size(opencl, size_of_local_params, size_of_shared_local_params);
+            it = t_worker_opencl.kernels.insert_or_assign(kernel_name, std::move(opencl)).first;
+        }
+        return it->second;
+    }
+
+    void Init_OpenCL_Context(const cl::Device* device, cl::Context& context, cl::CommandQueue& cmd_queue)
     {
         // Make sure that the device is not null.
         if (nullptr == device)
         {
-            std::cout << "OpenCL Error (Init_OpenCL): device is NULL" << std::endl;
+            std::cout << "OpenCL Error (Init_OpenCL_Context): device is NULL" << std::endl;
             std::exit(18);
         }
 
-        // Create a source with the kernel code.
-        cl::Program::Sources sources(1, { src, strlen(src) + 1 });
+        try
+        {
+            // Create a context with the OpenCL device.
+            context = cl::Context(*device);
+
+            // Create a command queue to communicate with the OpenCL device. The commands are chained using events,
+            // so an out-of-order queue lets the device overlap copying one block with processing another.
+            // Not every device supports it, in which case an in-order queue is used.
+            try
+            {
+                cmd_queue = cl::CommandQueue(context, *device, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE);
+            }
+            catch (const cl::Error&)
+            {
+                cmd_queue = cl::CommandQueue(context, *device);
+            }
+        }
+        catch (const cl::Error& e)
+        {
+            Print_OpenCL_Error(e, *device);
+            std::exit(6);
+        }
+    }
 
-        // Create a context with the OpenCL device.
-        cl::Context context(*device);
+    TOpenCL_Settings Init_OpenCL(const cl::Device* device, const cl::Context& context, const cl::CommandQueue& cmd_queue, const char* src, const char* kernel_name)
+    {
+        // Make sure that the device is not null.
+        if (nullptr == device)
+        {
+            std::cout << "OpenCL Error (Init_OpenCL): device is NULL" << std::endl;
+            std::exit(18);
+        }
 
-        // Create a program (context + sources).
-        cl::Program program(context, sources);
+        auto program_cache = Singleton<CProgram_Cache>::Get_Instance();
+        if (nullptr == program_cache)
+        {
+            std::cout << "Error: program cache is NULL" << std::endl;
+            std::exit(25);
+        }
 
         try
         {
-            // Compile the source code (kernel).
-            program.build("-cl-std=CL2.0");
+            // Get the compiled program (kernel) - it is loaded from the cache if it has been compiled before.
+            cl::Program program = program_cache->Build(context, *device, src, Build_Options);
 
             // Create a kernel object (it needs to know the program and the name of the entry point).
             cl::Kernel kernel(program, kernel_name);
@@ -35,7 +120,7 @@ namespace kiv_ppr::kernels
             const size_t work_group_size = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(*device);
             const size_t local_mem_size = device->getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
 
-            return { program, context, device, kernel, work_group_size, local_mem_size };
+            return { program, context, device, kernel, cmd_queue, work_group_size, local_mem_size };
         }
         catch (const cl::Error& e)
         {
@@ -44,7 +129,24 @@ namespace kiv_ppr::kernels
         }
     }
 
-    inline void Print_OpenCL_Error(const cl::Error& e, const cl::Device& device)
+    /// Releases the host memory of a block once it has been copied into an OpenCL device (see Release_After_Write).
+    /// It is called by the OpenCL runtime when the copy completes (or fails).
+    /// \param user_data Host memory of the block (std::shared_ptr<double[]> allocated by Release_After_Write)
+    static void CL_CALLBACK Release_Block(cl_event, cl_int, void* user_data)
+    {
+        delete static_cast<std::shared_ptr<double[]>*>(user_data);
+    }
+
+    void Release_After_Write(cl::Event& write_event, std::shared_ptr<double[]> data)
+    {
+        auto holder = std::make_unique<std::shared_ptr<double[]>>(std::move(data));
+        write_event.setCallback(CL_COMPLETE, &Release_Block, holder.get());
+
+        // The callback owns the block from now on.
+        holder.release();
+    }
+
+    void Print_OpenCL_Error(const cl::Error& e, const cl::Device& device)
     {
         // Retrieve the name of the device and pop out the last character ('\0').
         const std::string device_name = device.getInfo<CL_DEVICE_NAME>();
@@ -56,10 +158,10 @@ namespace kiv_ppr::kernels
         std::cout << "OpenCL Error [" << device_name << "] (" << error_desc << "): " << e.what() << std::endl;
     }
 
-    void Adjust_Work_Group_Size(kernels::TOpenCL_Settings& opencl, size_t size_of_local_params)
+    void Adjust_Work_Group_Size(kernels::TOpenCL_Settings& opencl, size_t size_of_local_params, size_t size_of_shared_local_params)
     {
         // Keep dividing the work group size by 2 until the maximum local memory size is not exceeded.
-        while (opencl.work_group_size * size_of_local_params > opencl.local_mem_size)
+        while (opencl.work_group_size > 0 && opencl.work_group_size * size_of_local_params + size_of_shared_local_params > opencl.local_mem_size)
         {
             opencl.work_group_size /= 2;
         }
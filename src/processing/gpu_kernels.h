@@ -1,9 +1,16 @@
 #pragma once
 
+#include <map>
+#include <memory>
+#include <string>
+
 #include "../opencl.h"
 
 namespace kiv_ppr::kernels
 {
+    /// Options used when building the kernels (they are part of the key of the program cache).
+    static constexpr const char* Build_Options = "-cl-std=CL2.0";
+
     /// Name of the entry point ("main function") of the kernel performing the first iteration.
     static constexpr const char* First_Iteration_Kernel_Name = "First_File_Iteration";
 
@@ -12,7 +19,9 @@ namespace kiv_ppr::kernels
     /// if the maximum local memory size is exceeded or not.
     static constexpr size_t First_Iteration_Get_Size_Of_Local_Params = 3 * sizeof(double) + sizeof(int) + sizeof(cl_ulong);
 
-    /// Kernel for the first iteration.
+    /// Kernel for the first iteration. Each work group reduces its values into one min, max, mean, count and all_ints
+    /// and First_Iteration_Reduce then merges the results of all work groups into the accumulator of the worker.
+    /// The global size is padded up to a multiple of the work group size, the work items past data_count are masked out.
     static constexpr const char* First_Iteration_Kernel = R"CLC(
         #pragma OPENCL EXTENSION cl_khr_fp64 : enable
 
@@ -40,6 +49,16 @@ namespace kiv_ppr::kernels
             return 1;
         }
 
+        void Merge_Mean(double* mean, ulong* count, double other_mean, ulong other_count)
+        {
+            ulong total_count = *count + other_count;
+            if (0 != total_count)
+            {
+                *mean = (*mean * ((double)*count / (double)total_count)) + (other_mean * ((double)other_count / (double)total_count));
+            }
+            *count = total_count;
+        }
+
         __kernel void First_File_Iteration(__global double* data,
 
                                            __local double* local_min,
@@ -52,47 +71,58 @@ namespace kiv_ppr::kernels
                                            __global double* out_max,
                                            __global double* out_mean,
                                            __global int* out_all_ints,
-                                           __global ulong* out_count)
+                                           __global ulong* out_count,
+
+                                           ulong data_count)
         {
             size_t global_id = get_global_id(0);
             size_t local_id = get_local_id(0);
             size_t local_size = get_local_size(0);
             size_t group_id = get_group_id(0);
 
-            local_mean[local_id] = data[global_id] / 2.0;
+            if (global_id < data_count)
+            {
+                local_mean[local_id] = data[global_id] / 2.0;
+                local_count[local_id] = Is_Valid_Double(data[global_id]);
+                local_all_ints[local_id] = !local_count[local_id] || ceil(data[global_id]) == floor(data[global_id]);
+            }
+            else
+            {
+                local_mean[local_id] = NAN;
+                local_count[local_id] = 0;
+                local_all_ints[local_id] = 1;
+            }
             local_min[local_id] = local_mean[local_id];
             local_max[local_id] = local_mean[local_id];
-            local_count[local_id] = Is_Valid_Double(data[global_id]);
-            local_all_ints[local_id] = !local_count[local_id] || ceil(data[global_id]) == floor(data[global_id]);
 
             barrier(CLK_LOCAL_MEM_FENCE);
 
-            int valid_1;
-            int valid_2;
-
+            // The means are merged by the number of valid values behind them (the masked out work items and
+            // the invalid doubles have count 0 and an invalid mean, min and max, so they are skipped).
             for (size_t i = local_size / 2; i > 0; i /= 2)
             {
                 if (local_id < i)
                 {
-                    valid_1 = Is_Valid_Double(local_mean[local_id]);
-                    valid_2 = Is_Valid_Double(local_mean[local_id + i]);
+                    ulong count = local_count[local_id];
+                    ulong other_count = local_count[local_id + i];
 
-                    local_count[local_id] += local_count[local_id + i];
                     local_all_ints[local_id] = local_all_ints[local_id] && local_all_ints[local_id + i];
 
-                    if (!valid_1 && valid_2)
+                    if (0 == count)
                     {
                         local_mean[local_id] = local_mean[local_id + i];
                         local_min[local_id] = local_min[local_id + i];
                         local_max[local_id] = local_max[local_id + i];
-                        valid_1 = 1;
                     }
-                    if (valid_1 && valid_2)
+                    else if (0 != other_count)
                     {
-                        local_mean[local_id] = (local_mean[local_id] / 2.0) + (local_mean[local_id + i] / 2.0);
+                        double mean = local_mean[local_id];
+                        Merge_Mean(&mean, &count, local_mean[local_id + i], other_count);
+                        local_mean[local_id] = mean;
                         local_min[local_id] = min(local_min[local_id], local_min[local_id + i]);
                         local_max[local_id] = max(local_max[local_id], local_max[local_id + i]);
                     }
+                    local_count[local_id] += other_count;
                 }
 
                 barrier(CLK_LOCAL_MEM_FENCE);
@@ -107,8 +137,110 @@ namespace kiv_ppr::kernels
                 out_all_ints[group_id] = local_all_ints[0];
             }
         }
+
+        typedef struct
+        {
+            double min;
+            double max;
+            double mean;
+            ulong count;
+            int all_ints;
+        } TAccumulator;
+
+        __kernel void First_Iteration_Reduce(__global double* in_min,
+                                             __global double* in_max,
+                                             __global double* in_mean,
+                                             __global int* in_all_ints,
+                                             __global ulong* in_count,
+                                             uint work_groups_count,
+
+                                             __local double* local_min,
+                                             __local double* local_max,
+                                             __local double* local_mean,
+                                             __local int* local_all_ints,
+                                             __local ulong* local_count,
+
+                                             __global TAccumulator* accumulator)
+        {
+            size_t local_id = get_local_id(0);
+            size_t local_size = get_local_size(0);
+
+            double min_value = DBL_MAX;
+            double max_value = -DBL_MAX;
+            double mean = 0;
+            ulong count = 0;
+            int all_ints = 1;
+
+            for (uint i = local_id; i < work_groups_count; i += local_size)
+            {
+                if (Is_Valid_Double(in_min[i]))
+                {
+                    min_value = min(min_value, in_min[i]);
+                }
+                if (Is_Valid_Double(in_max[i]))
+                {
+                    max_value = max(max_value, in_max[i]);
+                }
+                Merge_Mean(&mean, &count, Is_Valid_Double(in_mean[i]) ? in_mean[i] : 0.0, in_count[i]);
+                all_ints = all_ints && in_all_ints[i];
+            }
+
+            local_min[local_id] = min_value;
+            local_max[local_id] = max_value;
+            local_mean[local_id] = mean;
+            local_count[local_id] = count;
+            local_all_ints[local_id] = all_ints;
+
+            barrier(CLK_LOCAL_MEM_FENCE);
+
+            for (size_t i = local_size / 2; i > 0; i /= 2)
+            {
+                if (local_id < i)
+                {
+                    local_min[local_id] = min(local_min[local_id], local_min[local_id + i]);
+                    local_max[local_id] = max(local_max[local_id], local_max[local_id + i]);
+                    local_all_ints[local_id] = local_all_ints[local_id] && local_all_ints[local_id + i];
+
+                    mean = local_mean[local_id];
+                    count = local_count[local_id];
+                    Merge_Mean(&mean, &count, local_mean[local_id + i], local_count[local_id + i]);
+                    local_mean[local_id] = mean;
+                    local_count[local_id] = count;
+                }
+
+                barrier(CLK_LOCAL_MEM_FENCE);
+            }
+
+            if (0 == local_id)
+            {
+                accumulator->min = min(accumulator->min, local_min[0]);
+                accumulator->max = max(accumulator->max, local_max[0]);
+                accumulator->all_ints = accumulator->all_ints && local_all_ints[0];
+
+                mean = accumulator->mean;
+                count = accumulator->count;
+                Merge_Mean(&mean, &count, local_mean[0], local_count[0]);
+                accumulator->mean = mean;
+                accumulator->count = count;
+            }
+        }
     )CLC";
 
+    /// Name of the entry point of the kernel that reduces the results of the work groups of the first iteration
+    /// (one block of data) and merges them into an accumulator kept on the device across all blocks.
+    /// The kernel is part of the same program as the first iteration and it uses the same local parameters.
+    static constexpr const char* First_Iteration_Reduce_Kernel_Name = "First_Iteration_Reduce";
+
+    /// Values of the first iteration accumulated on an OpenCL device (the layout matches TAccumulator in the kernel).
+    struct TFirst_Iteration_Accumulator
+    {
+        cl_double min;      ///< Minimum of all valid doubles
+        cl_double max;      ///< Maximum of all valid doubles
+        cl_double mean;     ///< Mean of all valid doubles
+        cl_ulong count;     ///< Number of valid doubles
+        cl_int all_ints;    ///< Flag indicating whether all values are integers
+    };
+
     /// Name of the entry point ("main function") of the kernel performing the second iteration.
     static constexpr const char* Second_Iteration_Kernel_Name = "Second_File_Iteration";
 
@@ -117,7 +249,15 @@ namespace kiv_ppr::kernels
     /// if the maximum local memory size is exceeded or not.
     static constexpr size_t Second_Iteration_Get_Size_Of_Local_Params = 1 * sizeof(double);
 
-    /// Kernel for the second iteration.
+    /// Smallest number of bins of the histogram each work group keeps in its local memory.
+    static constexpr size_t Second_Iteration_Min_Local_Histogram_Bins = 256;
+
+    /// Kernel for the second iteration. Each work group counts its values in a histogram
+    /// of its own (local memory) and adds it into the global histogram at the end, so there is only one global atomic
+    /// operation per bin and work group instead of two per value. If the histogram does not fit into the local memory,
+    /// the kernel is executed several times, each time covering a different tile of bins (<tile_start; tile_start + tile_size)).
+    /// The variance is calculated only by the first tile. The global size is padded up to a multiple of the work group size,
+    /// the work items past data_count are masked out.
     static constexpr const char* Second_Iteration_Kernel = R"CLC(
         #pragma OPENCL EXTENSION cl_khr_fp64 : enable
 
@@ -151,15 +291,31 @@ namespace kiv_ppr::kernels
                                             double mean,
                                             ulong count,
                                             double min,
-                                            double interval_size)
+                                            double interval_size,
+                                            __local uint* local_histogram,
+                                            uint tile_start,
+                                            uint tile_size,
+                                            ulong data_count)
         {
             size_t global_id = get_global_id(0);
             size_t local_id = get_local_id(0);
             size_t local_size = get_local_size(0);
             size_t group_id = get_group_id(0);
 
-            double value = data[global_id];
-            int is_valid = Is_Valid_Double(value);
+            for (uint i = local_id; i < tile_size; i += local_size)
+            {
+                local_histogram[i] = 0;
+            }
+
+            barrier(CLK_LOCAL_MEM_FENCE);
+
+            double value = 0;
+            int is_valid = 0;
+            if (global_id < data_count)
+            {
+                value = data[global_id];
+                is_valid = Is_Valid_Double(value);
+            }
 
             local_var[local_id] = value;
             if (!is_valid)
@@ -176,9 +332,10 @@ namespace kiv_ppr::kernels
 
                 size_t slot_id = (size_t)((value - min) / interval_size);
 
-                uint old_value = atomic_inc(&histogram[2 * slot_id]);
-                uint carry = old_value == 0xFFFFFFFF;
-                atomic_add(&histogram[2 * slot_id + 1], carry);
+                if (slot_id >= tile_start && slot_id - tile_start < tile_size)
+                {
+                    atomic_inc(&local_histogram[slot_id - tile_start]);
+                }
 
                 double delta = value - mean;
                 double tmp_val = delta;
@@ -190,6 +347,25 @@ namespace kiv_ppr::kernels
 
             barrier(CLK_LOCAL_MEM_FENCE);
 
+            for (uint i = local_id; i < tile_size; i += local_size)
+            {
+                uint value_to_add = local_histogram[i];
+                if (value_to_add != 0)
+                {
+                    uint old_value = atomic_add(&histogram[2 * (tile_start + i)], value_to_add);
+                    uint carry = old_value > 0xFFFFFFFF - value_to_add;
+                    if (carry)
+                    {
+                        atomic_inc(&histogram[2 * (tile_start + i) + 1]);
+                    }
+                }
+            }
+
+            if (0 != tile_start)
+            {
+                return;
+            }
+
             for (size_t i = local_size / 2; i > 0; i /= 2)
             {
                 if (local_id < i)
@@ -214,17 +390,50 @@ namespace kiv_ppr::kernels
         cl::Context context{};              ///< Context within which the code will execute
         const cl::Device* device = nullptr; ///< OpenCL device itself
         cl::Kernel kernel{};                ///< Kernel ("source code")
+        cl::CommandQueue cmd_queue{};       ///< Command queue (created once, reused for every block of data)
         size_t work_group_size = 0;         ///< Maximum work group size of the device
         size_t local_mem_size = 0;          ///< Maximum local memory size of the device
     };
 
-    /// Initializes an OpenCL device and creates a kernel.
+    /// Creates a context and a command queue of an OpenCL device.
     /// This method is called from a worker thread after it gets hold of an available OpenCL device.
     /// \param device OpenCL device
+    /// \param context Created context
+    /// \param cmd_queue Created command queue (out-of-order if the device supports it)
+    void Init_OpenCL_Context(const cl::Device* device, cl::Context& context, cl::CommandQueue& cmd_queue);
+
+    /// Builds a kernel within an existing context of an OpenCL device (see Init_OpenCL_Context).
+    /// \param device OpenCL device
+    /// \param context Context of the device
+    /// \param cmd_queue Command queue of the device
     /// \param src Kernel source code
     /// \param kernel_name Name of the kernel's entry point
     /// \return Data associated with the OpenCL device and the kernel.
-    [[nodiscard]] TOpenCL_Settings Init_OpenCL(const cl::Device* device, const char* src, const char* kernel_name);
+    [[nodiscard]] TOpenCL_Settings Init_OpenCL(const cl::Device* device, const cl::Context& context, const cl::CommandQueue& cmd_queue, const char* src, const char* kernel_name);
+
+    /// Returns the OpenCL device of the current worker thread (see CThread_Pool). The device is requested
+    /// from the resource manager the first time the thread asks for it and the thread holds it for the whole run,
+    /// so the same device is used by the same thread in both iterations.
+    /// \return OpenCL device of the thread, nullptr if there was no device available.
+    [[nodiscard]] const cl::Device* Get_Worker_Device();
+
+    /// Returns the OpenCL settings (context, compiled kernel, ...) of the current worker thread.
+    /// The context and the command queue are created once per thread and device and all kernels are built in them.
+    /// The kernel is compiled only the first time the thread asks for it, after that, the cached one is returned.
+    /// \param device OpenCL device (see Get_Worker_Device)
+    /// \param src Kernel source code
+    /// \param kernel_name Name of the kernel's entry point
+    /// \param size_of_local_params Size of the local values the kernel takes as parameters (see Adjust_Work_Group_Size).
+    /// \param size_of_shared_local_params Size of the local values shared by the whole work group (see Adjust_Work_Group_Size).
+    /// \return Data associated with the OpenCL device and the kernel.
+    [[nodiscard]] TOpenCL_Settings& Get_Worker_OpenCL(const cl::Device* device, const char* src, const char* kernel_name, size_t size_of_local_params, size_t size_of_shared_local_params = 0);
+
+    /// Keeps the host memory of a block alive until it has been copied into an OpenCL device and releases it then
+    /// (e.g. it returns into the block pool). The worker does not hold the blocks in flight itself, so it never waits
+    /// for a buffer of the pool that only the worker could release (see CBlock_Pool::Acquire).
+    /// \param write_event Event of copying the block into the device
+    /// \param data Host memory of the block
+    void Release_After_Write(cl::Event& write_event, std::shared_ptr<double[]> data);
 
     /// Helper function that returns a text description based on an OpenCL error code.
     /// \param error OpenCL error code
@@ -243,7 +452,8 @@ namespace kiv_ppr::kernels
     /// so the numerical reduce algorithm works properly.
     /// \param opencl OpenCL device 
     /// \param size_of_local_params Size of the local values the device takes as parameters.
-    void Adjust_Work_Group_Size(kernels::TOpenCL_Settings& opencl, size_t size_of_local_params);
+    /// \param size_of_shared_local_params Size of the local values whose size does not depend on the work group size (e.g. a local histogram).
+    void Adjust_Work_Group_Size(kernels::TOpenCL_Settings& opencl, size_t size_of_local_params, size_t size_of_shared_local_params = 0);
 }
 
 // EOF
\ No newline at end of file
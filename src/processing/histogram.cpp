@@ -1,12 +1,21 @@
+#include <numeric>
+#include <algorithm>
+#include <iostream>
+
 #include "histogram.h"
+#include "cpu_kernels.h"
+#include "../utils/singleton.h"
 
 namespace kiv_ppr
 {
     CHistogram::CHistogram(TParams params)
         : m_intervals(params.number_of_intervals + 1, 0),
+          m_sub_histograms{},
           m_interval_size((params.max - params.min) / static_cast<double>(params.number_of_intervals)),
+          m_reciprocal(1.0 / m_interval_size),
           m_params(params),
-          m_count{}
+          m_count{},
+          m_sub_histograms_used{false}
     {
 
     }
@@ -14,13 +23,74 @@ namespace kiv_ppr
     void CHistogram::Add(double value) noexcept
     {
         // Add the value into its corresponding bin (interval).
-        const auto slot_id = static_cast<size_t>((value - m_params.min) / m_interval_size);
-        ++m_intervals.at(slot_id);
+        ++m_intervals[Get_Slot(value)];
 
         // Increment the number of values inserted into the histogram.
         ++m_count;
     }
 
+    void CHistogram::Add_Block(std::span<const double> values, std::span<const uint8_t> mask)
+    {
+        // Make sure that the CPU kernels are not NULL.
+        const auto cpu_kernels = Singleton<CCPU_Kernels>::Get_Instance();
+        if (nullptr == cpu_kernels)
+        {
+            std::cout << "Error: CPU kernels are NULL" << std::endl;
+            std::exit(26);
+        }
+
+        // The copies of the intervals are created when they are needed for the first time.
+        if (m_sub_histograms.empty())
+        {
+            m_sub_histograms.resize(m_intervals.size() * config::processing::Sub_Histograms, 0);
+        }
+
+        cpu_kernels->Histogram(values.first(std::min(values.size(), mask.size())), mask, Get_Binning(), m_sub_histograms.data());
+        m_sub_histograms_used = true;
+    }
+
+    void CHistogram::Merge_Sub_Histograms() noexcept
+    {
+        if (!m_sub_histograms_used)
+        {
+            return;
+        }
+
+        for (size_t i = 0; i < m_intervals.size(); ++i)
+        {
+            // The copies of an interval are stored next to each other.
+            const auto copies = m_sub_histograms.begin() + static_cast<std::ptrdiff_t>(i * config::processing::Sub_Histograms);
+            const size_t value = std::accumulate(copies, copies + config::processing::Sub_Histograms, size_t{0});
+            std::fill(copies, copies + config::processing::Sub_Histograms, size_t{0});
+
+            m_intervals[i] += value;
+            m_count += value;
+        }
+        m_sub_histograms_used = false;
+    }
+
+    size_t CHistogram::Get_Slot(double value) const noexcept
+    {
+        const double slot = (value - m_params.min) * m_reciprocal;
+
+        // Clamp the index into the histogram (a NaN falls into the first interval).
+        if (!(slot >= 0.0))
+        {
+            return 0;
+        }
+        return static_cast<size_t>(std::min(slot, Get_Binning().last_slot));
+    }
+
+    CHistogram::TBinning CHistogram::Get_Binning() const noexcept
+    {
+        return { m_params.min, m_reciprocal, static_cast<double>(m_intervals.size() - 1) };
+    }
+
+    CHistogram::TParams CHistogram::Get_Params() const noexcept
+    {
+        return m_params;
+    }
+
     size_t CHistogram::Get_Number_Of_Intervals() const noexcept
     {
         return m_intervals.size();
@@ -69,18 +139,24 @@ namespace kiv_ppr
 
     void CHistogram::operator+=(CHistogram& other) noexcept
     {
+        // Make sure all values added by Add_Block are in the intervals.
+        Merge_Sub_Histograms();
+        other.Merge_Sub_Histograms();
+
         // Make sure we do not overflow (take the minimum of the two histograms).
         const size_t size = std::min(Get_Number_Of_Intervals(), other.Get_Number_Of_Intervals());
 
-        // Merge the histograms.
-        for (size_t i = 0; i < size; ++i)
+        // Make sure that the CPU kernels are not NULL.
+        const auto cpu_kernels = Singleton<CCPU_Kernels>::Get_Instance();
+        if (nullptr == cpu_kernels)
         {
-            // Merge the current interval (bin).
-            m_intervals.at(i) += other.at(i);
-
-            // Update the number of values stored in the histogram.
-            m_count += other.at(i);
+            std::cout << "Error: CPU kernels are NULL" << std::endl;
+            std::exit(26);
         }
+
+        // Merge the histograms (the intervals are added up using SIMD instructions) and update
+        // the number of values stored in the histogram.
+        m_count += cpu_kernels->Add_Counts(m_intervals.data(), other.m_intervals.data(), size);
     }
 
     std::ostream& operator<<(std::ostream& out, CHistogram& histogram)
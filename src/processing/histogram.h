@@ -1,5 +1,6 @@
 #pragma once
 
+#include <span>
 #include <vector>
 #include <cstdint>
 #include <cstddef>
@@ -24,6 +25,14 @@ namespace kiv_ppr
             size_t number_of_intervals; ///< Number of intervals (bins)
         };
 
+        /// Values needed to calculate the index of the interval (bin) a value falls into.
+        struct TBinning
+        {
+            double min;        ///< Minimum number (left boundary)
+            double reciprocal; ///< 1 / interval size (so there is no division per value)
+            double last_slot;  ///< Index of the last interval (greater indexes are clamped to it)
+        };
+
     public:
         /// Creates an instance of the class. 
         /// \param params Histogram parameters
@@ -36,6 +45,17 @@ namespace kiv_ppr
         /// \param value Value to be added into the histogram.
         void Add(double value) noexcept;
 
+        /// Adds a block of numbers into the histogram. The indexes of the intervals are calculated by the selected
+        /// CPU kernels (see CCPU_Kernels). The k-th value is counted in the copy (k % config::processing::Sub_Histograms)
+        /// of its interval, so a run of values falling into the same interval does not wait for the previous increments
+        /// to be stored. The copies are added into the intervals by Merge_Sub_Histograms.
+        /// \param values Values to be added into the histogram
+        /// \param mask Flags of the values (1 = the value is added, 0 = the value is skipped)
+        void Add_Block(std::span<const double> values, std::span<const uint8_t> mask);
+
+        /// Adds the copies of the intervals filled by Add_Block into the intervals themselves.
+        void Merge_Sub_Histograms() noexcept;
+
         /// Increments the value at a particular index by the values passed 
         /// as a parameter (histogram[index] += value).
         /// \param index Index (position in the histogram)
@@ -43,6 +63,19 @@ namespace kiv_ppr
         /// \return true, if all went well, false otherwise.
         [[nodiscard]] bool Add(size_t index, size_t value) noexcept;
 
+        /// Returns the index of the interval (bin) a value falls into.
+        /// \param value Value
+        /// \return Index of the interval the value falls into
+        [[nodiscard]] size_t Get_Slot(double value) const noexcept;
+
+        /// Returns the values needed to calculate the index of the interval a value falls into.
+        /// \return Binning of the histogram
+        [[nodiscard]] TBinning Get_Binning() const noexcept;
+
+        /// Returns the parameters the histogram has been created with.
+        /// \return Parameters of the histogram (min, max, number of intervals)
+        [[nodiscard]] TParams Get_Params() const noexcept;
+
         /// Returns the number of intervals that make up the histogram.
         /// \return Number of intervals of the histogram.
         [[nodiscard]] size_t Get_Number_Of_Intervals() const noexcept;
@@ -81,10 +114,13 @@ namespace kiv_ppr
         friend std::ostream& operator<<(std::ostream& out, CHistogram& histogram);
 
     private:
-        std::vector<size_t> m_intervals; ///< Intervals (bins) that make up the histogram
-        double m_interval_size;          ///< Width of a bin (interval size)
-        TParams m_params;                ///< Parameters of the histogram (min, max, number of intervals)
-        size_t m_count;                  ///< Total number of values inserted into the histogram
+        std::vector<size_t> m_intervals;      ///< Intervals (bins) that make up the histogram
+        std::vector<size_t> m_sub_histograms; ///< Interleaved copies of the intervals filled by Add_Block
+        double m_interval_size;               ///< Width of a bin (interval size)
+        double m_reciprocal;                  ///< 1 / width of a bin
+        TParams m_params;                     ///< Parameters of the histogram (min, max, number of intervals)
+        size_t m_count;                       ///< Total number of values inserted into the histogram
+        bool m_sub_histograms_used;           ///< Flag indicating whether there are values in the copies of the intervals
     };
 }
 
@@ -0,0 +1,187 @@
+#include <thread>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <cstring>
+#include <filesystem>
+
+#include "program_cache.h"
+#include "../utils/utils.h"
+
+namespace kiv_ppr
+{
+    void CProgram_Cache::Set_Directory(const std::string& directory)
+    {
+        const std::lock_guard<std::mutex> lock(m_mtx);
+
+        m_directory = directory;
+    }
+
+    cl::Program CProgram_Cache::Build(const cl::Context& context, const cl::Device& device, const char* src, const char* options)
+    {
+        const std::string key = Create_Key(device, src, options);
+        const std::string path = Get_Path(key);
+
+        // Try to create the program from a binary stored in the cache.
+        std::vector<unsigned char> binary;
+        if (!path.empty() && Load_Binary(path, key, binary))
+        {
+            try
+            {
+                cl::Program program(context, { device }, cl::Program::Binaries{ binary });
+                program.build(options);
+                ++m_hits;
+                return program;
+            }
+            catch (const cl::Error&)
+            {
+                // The device refused the binary (e.g. the driver has been updated without changing its version).
+                // Build the program from the source code instead.
+            }
+        }
+
+        // Create a program (context + sources) and compile the source code (kernel).
+        cl::Program::Sources sources(1, { src, strlen(src) + 1 });
+        cl::Program program(context, sources);
+        program.build(options);
+        ++m_misses;
+
+        // Store the binary into the cache, so the next run does not have to compile it again.
+        if (!path.empty())
+        {
+            const auto binaries = program.getInfo<CL_PROGRAM_BINARIES>();
+            if (!binaries.empty() && !binaries.front().empty())
+            {
+                Store_Binary(path, key, binaries.front());
+            }
+        }
+
+        return program;
+    }
+
+    size_t CProgram_Cache::Get_Hits() const noexcept
+    {
+        return m_hits;
+    }
+
+    size_t CProgram_Cache::Get_Misses() const noexcept
+    {
+        return m_misses;
+    }
+
+    std::string CProgram_Cache::Create_Key(const cl::Device& device, const char* src, const char* options)
+    {
+        std::ostringstream key;
+
+        // The binary depends on the device, its driver, the source code and the build options.
+        key << "device=" << device.getInfo<CL_DEVICE_NAME>().c_str() << "\n"
+            << "device_version=" << device.getInfo<CL_DEVICE_VERSION>().c_str() << "\n"
+            << "driver_version=" << device.getInfo<CL_DRIVER_VERSION>().c_str() << "\n"
+            << "source=" << std::hex << std::setw(16) << std::setfill('0') << utils::serialization::Hash(src, std::strlen(src)) << "\n"
+            << "options=" << options << "\n";
+
+        return key.str();
+    }
+
+    std::string CProgram_Cache::Get_Path(const std::string& key) const
+    {
+        const std::lock_guard<std::mutex> lock(m_mtx);
+
+        // The cache is disabled.
+        if (m_directory.empty())
+        {
+            return {};
+        }
+
+        std::ostringstream filename;
+        filename << std::hex << std::setw(16) << std::setfill('0') << utils::serialization::Hash(key.data(), key.size()) << ".clbin";
+
+        return (std::filesystem::path(m_directory) / filename.str()).string();
+    }
+
+    bool CProgram_Cache::Load_Binary(const std::string& path, const std::string& key, std::vector<unsigned char>& binary)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+
+        // Read the header of the file (magic, key).
+        char magic[8]{};
+        uint64_t key_size = 0;
+        file.read(magic, sizeof(magic));
+        file.read(reinterpret_cast<char*>(&key_size), sizeof(key_size));
+        if (!file || 0 != std::memcmp(magic, Magic, sizeof(magic)) || key_size != key.size())
+        {
+            return false;
+        }
+
+        // The file name is only a hash, so make sure the file really holds the binary of the program.
+        std::string stored_key(key_size, '\0');
+        file.read(stored_key.data(), static_cast<std::streamsize>(key_size));
+        if (!file || stored_key != key)
+        {
+            return false;
+        }
+
+        // Read the binary itself.
+        uint64_t binary_size = 0;
+        file.read(reinterpret_cast<char*>(&binary_size), sizeof(binary_size));
+        if (!file || 0 == binary_size)
+        {
+            return false;
+        }
+        binary.resize(binary_size);
+        file.read(reinterpret_cast<char*>(binary.data()), static_cast<std::streamsize>(binary_size));
+
+        return static_cast<bool>(file);
+    }
+
+    void CProgram_Cache::Store_Binary(const std::string& path, const std::string& key, const std::vector<unsigned char>& binary)
+    {
+        // Create the directory first (if it cannot be created, the binary will simply fail to be stored).
+        std::error_code dir_error;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), dir_error);
+
+        // Each thread writes into a temporary file of its own.
+        std::ostringstream tmp_path;
+        tmp_path << path << "." << std::hash<std::thread::id>{}(std::this_thread::get_id()) << ".tmp";
+
+        {
+            std::ofstream file(tmp_path.str(), std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                return;
+            }
+
+            const uint64_t key_size = key.size();
+            const uint64_t binary_size = binary.size();
+
+            file.write(Magic, 8);
+            file.write(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
+            file.write(key.data(), static_cast<std::streamsize>(key_size));
+            file.write(reinterpret_cast<const char*>(&binary_size), sizeof(binary_size));
+            file.write(reinterpret_cast<const char*>(binary.data()), static_cast<std::streamsize>(binary_size));
+
+            if (!file)
+            {
+                file.close();
+                std::error_code error;
+                std::filesystem::remove(tmp_path.str(), error);
+                return;
+            }
+        }
+
+        // Move the file into its place. If another thread has already stored the same binary
+        // (renaming fails on Windows if the file exists), just remove the temporary file.
+        std::error_code error;
+        std::filesystem::rename(tmp_path.str(), path, error);
+        if (error)
+        {
+            std::filesystem::remove(tmp_path.str(), error);
+        }
+    }
+}
+
+// EOF
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "../opencl.h"
+
+namespace kiv_ppr
+{
+    /// \author Jakub Silhavy
+    ///
+    /// This class represents an on-disk cache of compiled OpenCL programs. A program is looked up
+    /// by a key made of the name of the device, the version of its driver, the hash of the source code
+    /// (kernel) and the build options. If there is a matching binary in the cache, the program is created
+    /// from it. Otherwise (or if the device refuses the binary), the program is built from the source code
+    /// and its binary is stored into the cache for the next run. This class is used as a singleton (see singleton.h).
+    class CProgram_Cache
+    {
+    public:
+        /// Default constructor (the cache is disabled until a directory is set).
+        CProgram_Cache() = default;
+
+        /// Default destructor.
+        ~CProgram_Cache() = default;
+
+        /// Sets the directory the binaries are stored in.
+        /// \param directory Path to the directory (it is created once the first binary is stored). An empty path disables the cache.
+        void Set_Directory(const std::string& directory);
+
+        /// Returns a built program for the given device (either loaded from the cache or built from the source code).
+        /// If the program has to be built from the source code and the build fails, cl::Error is thrown.
+        /// \param context OpenCL context (created with the device)
+        /// \param device OpenCL device the program is built for
+        /// \param src Source code of the kernel
+        /// \param options Build options
+        /// \return Built program
+        [[nodiscard]] cl::Program Build(const cl::Context& context, const cl::Device& device, const char* src, const char* options);
+
+        /// Returns how many programs have been loaded from the cache.
+        /// \return Number of programs loaded from the cache
+        [[nodiscard]] size_t Get_Hits() const noexcept;
+
+        /// Returns how many programs have been built from the source code.
+        /// \return Number of programs built from the source code
+        [[nodiscard]] size_t Get_Misses() const noexcept;
+
+    private:
+        /// Creates the key of a program (everything its binary depends on).
+        /// \param device OpenCL device the program is built for
+        /// \param src Source code of the kernel
+        /// \param options Build options
+        /// \return Key of the program
+        [[nodiscard]] static std::string Create_Key(const cl::Device& device, const char* src, const char* options);
+
+        /// Returns the path to the file holding the binary of a program.
+        /// \param key Key of the program
+        /// \return Path to the file
+        [[nodiscard]] std::string Get_Path(const std::string& key) const;
+
+        /// Reads the binary of a program from the cache.
+        /// \param path Path to the file holding the binary
+        /// \param key Key of the program (it has to match the key stored in the file)
+        /// \param binary Binary of the program
+        /// \return true, if the binary has been found, false otherwise.
+        [[nodiscard]] static bool Load_Binary(const std::string& path, const std::string& key, std::vector<unsigned char>& binary);
+
+        /// Stores the binary of a program into the cache. The binary is written into a temporary file
+        /// first, so other threads (or processes) never read a half-written file.
+        /// \param path Path to the file holding the binary
+        /// \param key Key of the program
+        /// \param binary Binary of the program
+        static void Store_Binary(const std::string& path, const std::string& key, const std::vector<unsigned char>& binary);
+
+    private:
+        /// Identification of a file holding a binary.
+        static constexpr const char* Magic = "KIVPPRCL";
+
+    private:
+        std::string m_directory{};      ///< Directory the binaries are stored in (empty = the cache is disabled)
+        mutable std::mutex m_mtx;       ///< Mutex guarding the directory
+        std::atomic<size_t> m_hits{};   ///< Number of programs loaded from the cache
+        std::atomic<size_t> m_misses{}; ///< Number of programs built from the source code
+    };
+}
+
+// EOF
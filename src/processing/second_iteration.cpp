@@ -2,9 +2,10 @@
 #include <cmath>
 
 #include "second_iteration.h"
+#include "cpu_kernels.h"
 #include "../utils/utils.h"
 #include "../utils/singleton.h"
-#include "../utils/resource_guard.h"
+#include "../utils/thread_pool.h"
 #include "../utils/resource_manager.h"
 
 namespace kiv_ppr
@@ -53,11 +54,31 @@ namespace kiv_ppr
         // Create a new watchdog instance.
         CWatchdog watchdog(thread_config->watchdog_expiration_sec);
 
-        // Create a container for all the workers.
-        std::vector<std::future<int>> workers(thread_config->number_of_threads);
-        for (auto& worker : workers)
+        // Make sure that the thread pool is not NULL.
+        auto thread_pool = Singleton<CThread_Pool>::Get_Instance();
+        if (nullptr == thread_pool)
+        {
+            std::cout << "Error: thread pool is NULL" << std::endl;
+            std::exit(24);
+        }
+
+        // Make sure that the resource manager is not NULL.
+        auto resource_manager = Singleton<CResource_Manager>::Get_Instance();
+        if (nullptr == resource_manager)
+        {
+            std::cout << "Error: resource manager is NULL" << std::endl;
+            std::exit(23);
+        }
+
+        // Create a scheduler that sizes the blocks claimed by the workers based on their throughput.
+        CWork_Scheduler scheduler(thread_config->number_of_elements_per_file_read, config::processing::Min_Block_Size_Per_Read / sizeof(double));
+
+        // Create a container for all the workers (they are executed by the thread pool) along with their result slots.
+        std::vector<std::future<int>> workers(resource_manager->Get_Number_Of_Workers(thread_config->number_of_threads));
+        CResult_Slots<TValues> results(workers.size());
+        for (size_t i = 0; i < workers.size(); ++i)
         {
-            worker = std::async(std::launch::async, &CSecond_Iteration::Worker, this, thread_config, &watchdog);
+            workers[i] = thread_pool->Submit(&CSecond_Iteration::Worker, this, thread_config, &watchdog, &scheduler, &results, i);
         }
 
         // Execute the workers and add up their return values.
@@ -71,6 +92,26 @@ namespace kiv_ppr
         // Stop the watchdog.
         watchdog.Stop();
 
+        // Print out how much of the work each OpenCL device (and the CPU) has done.
+        if (scheduler.Has_Devices())
+        {
+            std::cout << "Share of the work (second iteration):\n" << scheduler;
+        }
+
+        // Merge the results of the workers (the variance and the histograms).
+        const double merge_time = utils::Time_Call_Ms([&]() {
+            const auto merged_values = results.Reduce([](TValues& dest, const TValues& src) {
+                dest.var += src.var;
+                *dest.histogram += *src.histogram;
+            });
+            if (nullptr != merged_values)
+            {
+                m_values.var = merged_values->var;
+                m_values.histogram = merged_values->histogram;
+            }
+        });
+        std::cout << "Time of merging the results of the workers (second iteration) = " << merge_time << " ms" << std::endl;
+
         // Calculate the standard deviation.
         m_values.sd = std::sqrt(m_values.var);
 
@@ -83,58 +124,57 @@ namespace kiv_ppr
         return 0;
     }
 
-    void CSecond_Iteration::Report_Worker_Results(const TValues& values)
+    CSecond_Iteration::TOpenCL_Slot CSecond_Iteration::Create_OpenCL_Slot(kernels::TOpenCL_Settings& opencl, size_t capacity)
     {
-        const std::lock_guard<std::mutex> lock(m_mtx);
-        
-        // Update the variance.
-        m_values.var += values.var;
-
-        // Merge the local histogram with the global one.
-        m_values.histogram->operator+=(*values.histogram);
-    }
-
-    CSecond_Iteration::TOpenCL_Report CSecond_Iteration::Execute_OpenCL(kernels::TOpenCL_Settings& opencl, const CFile_Reader<double>::TData_Block& data_block, TValues& local_values)
-    {
-        // Calculate how many work groups will be needed.
-        const auto work_groups_count = data_block.count / opencl.work_group_size;
-
-        // Calculate how many values we will be able calculate (must be a multiple of the size of one work group).
-        const size_t count = data_block.count - (data_block.count % opencl.work_group_size);
+        TOpenCL_Slot slot{};
+        slot.capacity = capacity;
 
-        // The number of input values is less than the size of one work group.
-        // All work will be done by the CPU.
-        if (0 == work_groups_count)
-        {
-            return { false, false };
-        }
+        // Maximum number of work groups (the last one may be only partially filled, at least one, so no buffer is empty).
+        const size_t max_work_groups_count = std::max<size_t>((capacity + opencl.work_group_size - 1) / opencl.work_group_size, 1);
 
         // Retrieve the interval size (bin width) as well as the number of intervals. 
-        const size_t number_of_intervals = local_values.histogram->Get_Number_Of_Intervals();
-        const double interval_size = local_values.histogram->Get_Interval_Size();
+        const size_t number_of_intervals = m_values.histogram->Get_Number_Of_Intervals();
+        const double interval_size = m_values.histogram->Get_Interval_Size();
 
-        // Create a vector (histogram) that will be passed to the OpenCL device.
         // The histogram is twice the size of the original one - not every OpenCL device
         // can perform an atomic operation on size_t (bin), therefore each bin is represented as 
         // two uint values (carry bit).
-        std::vector<cl_uint> out_histogram(2 * number_of_intervals, 0);
+        slot.bins.resize(2 * number_of_intervals);
+        slot.var.resize(max_work_groups_count);
 
-        // Create output buffers (results calculated by each work group).
-        cl::Buffer data_buff(opencl.context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_USE_HOST_PTR, count * sizeof(double), data_block.data.get());
-        cl::Buffer out_var_buff(opencl.context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, work_groups_count * sizeof(double));
-        cl::Buffer histogram_buff(opencl.context, CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR, out_histogram.size() * sizeof(cl_uint), out_histogram.data());
+        // Number of bins each work group can keep in its local memory. If the whole histogram does not fit,
+        // it is split up into tiles and the kernel is executed once per tile.
+        const size_t free_local_mem_size = opencl.local_mem_size - opencl.work_group_size * kernels::Second_Iteration_Get_Size_Of_Local_Params;
+        slot.tile_size = static_cast<cl_uint>(std::max<size_t>(std::min(number_of_intervals, free_local_mem_size / sizeof(cl_uint)), 1));
+        slot.number_of_tiles = (number_of_intervals + slot.tile_size - 1) / slot.tile_size;
 
-        // Pass the arguments into the kernel. 
         try
         {
-            opencl.kernel.setArg(0, data_buff);
-            opencl.kernel.setArg(1, opencl.work_group_size * sizeof(double), nullptr);
-            opencl.kernel.setArg(2, out_var_buff);
-            opencl.kernel.setArg(3, histogram_buff);
-            opencl.kernel.setArg(4, sizeof(double), &m_basic_values->mean);
-            opencl.kernel.setArg(5, sizeof(cl_ulong), &m_basic_values->count);
-            opencl.kernel.setArg(6, sizeof(double), &m_basic_values->min);
-            opencl.kernel.setArg(7, sizeof(double), &interval_size);
+            // Each slot has a kernel of its own, so the arguments of the kernel do not need to be set for every block.
+            slot.kernel = cl::Kernel(opencl.program, kernels::Second_Iteration_Kernel_Name);
+
+            // Create a buffer for the input values (the values are copied into it for every block).
+            slot.data = cl::Buffer(opencl.context, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, std::max<size_t>(capacity, 1) * sizeof(double));
+
+            // Create output buffers (results calculated by each work group).
+            slot.out_var = cl::Buffer(opencl.context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, max_work_groups_count * sizeof(double));
+            slot.histogram = cl::Buffer(opencl.context, CL_MEM_READ_WRITE | CL_MEM_HOST_READ_ONLY, slot.bins.size() * sizeof(cl_uint));
+
+            // Pass the arguments into the kernel. They stay the same for all blocks of data.
+            slot.kernel.setArg(0, slot.data);
+            slot.kernel.setArg(1, opencl.work_group_size * sizeof(double), nullptr);
+            slot.kernel.setArg(2, slot.out_var);
+            slot.kernel.setArg(3, slot.histogram);
+            slot.kernel.setArg(4, sizeof(double), &m_basic_values->mean);
+            slot.kernel.setArg(5, sizeof(cl_ulong), &m_basic_values->count);
+            slot.kernel.setArg(6, sizeof(double), &m_basic_values->min);
+            slot.kernel.setArg(7, sizeof(double), &interval_size);
+
+            // The local histogram takes up the local memory that is not used by the variance.
+            slot.kernel.setArg(8, slot.tile_size * sizeof(cl_uint), nullptr);
+            slot.kernel.setArg(9, cl_uint{0});
+            slot.kernel.setArg(10, slot.tile_size);
+            slot.kernel.setArg(11, cl_ulong{0});
         }
         catch (const cl::Error& e)
         {
@@ -142,20 +182,56 @@ namespace kiv_ppr
             std::exit(11);
         }
 
-        // Create output CPU buffers to store the results from the OpenCL device to.
-        std::vector<double> out_var(work_groups_count);
-   
+        return slot;
+    }
+
+    size_t CSecond_Iteration::Enqueue_OpenCL(kernels::TOpenCL_Settings& opencl, TOpenCL_Slot& slot, const CFile_Reader<double>::TData_Block& data_block)
+    {
+        // Calculate how many work groups will be needed (the last one may be only partially filled).
+        const auto work_groups_count = (data_block.count + opencl.work_group_size - 1) / opencl.work_group_size;
+
+        // The global size must be a multiple of the size of one work group. The work items
+        // past the end of the block are masked out by the kernel, so the whole block is processed on the device.
+        const size_t padded_count = work_groups_count * opencl.work_group_size;
+
+        // The block is empty or it does not fit into the buffers. All work will be done by the CPU.
+        if (0 == work_groups_count || data_block.count > slot.capacity)
+        {
+            return 0;
+        }
+
         try
         {
-            // Create a command queue to communicate with the OpenCL device.
-            cl::CommandQueue cmd_queue(opencl.context, *opencl.device);
+            // Copy the input values into the device and clear the histogram.
+            std::vector<cl::Event> kernel_dependencies(2);
+            opencl.cmd_queue.enqueueWriteBuffer(slot.data, CL_FALSE, 0, data_block.count * sizeof(double), data_block.data.get(), nullptr, &kernel_dependencies[0]);
+            opencl.cmd_queue.enqueueFillBuffer(slot.histogram, cl_uint{0}, 0, slot.bins.size() * sizeof(cl_uint), nullptr, &kernel_dependencies[1]);
+
+            // The block is released as soon as it has been copied into the device (the slot does not hold it).
+            kernels::Release_After_Write(kernel_dependencies[0], data_block.data);
 
-            // Pass the kernel into the OpenCL device ("start the program").
-            cmd_queue.enqueueNDRangeKernel(opencl.kernel, cl::NullRange, cl::NDRange(count), cl::NDRange(opencl.work_group_size));
+            // Pass the number of values in the block into the kernel (the rest of the work items is masked out).
+            slot.kernel.setArg(11, static_cast<cl_ulong>(data_block.count));
 
-            // Read the results from the OpenCL device.
-            cmd_queue.enqueueReadBuffer(out_var_buff, CL_TRUE, 0, out_var.size() * sizeof(double), out_var.data());
-            cmd_queue.enqueueReadBuffer(histogram_buff, CL_TRUE, 0, out_histogram.size() * sizeof(cl_uint), out_histogram.data());
+            // Pass the kernel into the OpenCL device ("start the program") once both are done.
+            // The tiles cover disjoint bins of the histogram, so they do not have to wait for each other.
+            std::vector<cl::Event> read_dependencies(slot.number_of_tiles);
+            for (size_t tile = 0; tile < slot.number_of_tiles; ++tile)
+            {
+                if (slot.number_of_tiles > 1)
+                {
+                    slot.kernel.setArg(9, static_cast<cl_uint>(tile * slot.tile_size));
+                }
+                opencl.cmd_queue.enqueueNDRangeKernel(slot.kernel, cl::NullRange, cl::NDRange(padded_count), cl::NDRange(opencl.work_group_size), &kernel_dependencies, &read_dependencies[tile]);
+            }
+
+            // Read the results from the OpenCL device once the kernel has finished.
+            slot.read_events.assign(2, cl::Event{});
+            opencl.cmd_queue.enqueueReadBuffer(slot.out_var, CL_FALSE, 0, work_groups_count * sizeof(double), slot.var.data(), &read_dependencies, &slot.read_events[0]);
+            opencl.cmd_queue.enqueueReadBuffer(slot.histogram, CL_FALSE, 0, slot.bins.size() * sizeof(cl_uint), slot.bins.data(), &read_dependencies, &slot.read_events[1]);
+
+            // Make sure the device starts working while we are reading the next block.
+            opencl.cmd_queue.flush();
         }
         catch (const cl::Error& e)
         {
@@ -163,11 +239,32 @@ namespace kiv_ppr
             std::exit(13);
         }
 
+        slot.busy = true;
+        slot.work_groups_count = work_groups_count;
+
+        return data_block.count;
+    }
+
+    void CSecond_Iteration::Finish_OpenCL(TValues& local_values, kernels::TOpenCL_Settings& opencl, TOpenCL_Slot& slot)
+    {
+        try
+        {
+            // Wait for the results to be copied back from the device.
+            cl::Event::waitForEvents(slot.read_events);
+        }
+        catch (const cl::Error& e)
+        {
+            kernels::Print_OpenCL_Error(e, *opencl.device);
+            std::exit(13);
+        }
+
+        const size_t number_of_intervals = local_values.histogram->Get_Number_Of_Intervals();
+
         // Update the local histogram (add up the values calculated on the OpenCL device)
         for (size_t i = 0; i < number_of_intervals; ++i)
         {
-            // Each interval is represented as two uint variable. 
-            const size_t value = static_cast<size_t>(out_histogram.at(2 * i)) + static_cast<size_t>(out_histogram.at(2 * i + 1)) * sizeof(cl_uint);
+            // Each interval is represented as two uint variable (the lower and the upper 32 bits).
+            const size_t value = static_cast<size_t>(slot.bins.at(2 * i)) + (static_cast<size_t>(slot.bins.at(2 * i + 1)) << 32);
 
             if (false == local_values.histogram->Add(i, value))
             {
@@ -178,18 +275,33 @@ namespace kiv_ppr
 
         // Add up the variance values from the individual work groups.
         double gpu_var = 0.0;
-        for (const auto& value : out_var)
+        for (size_t i = 0; i < slot.work_groups_count; ++i)
         {
-            gpu_var += value;
+            gpu_var += slot.var.at(i);
         }
 
         // Update the local variance.
         local_values.var += gpu_var;
 
-        return { true, count == data_block.count };
+        // Release the slot.
+        slot.read_events.clear();
+        slot.busy = false;
+    }
+
+    void CSecond_Iteration::Flush_OpenCL(TValues& local_values, kernels::TOpenCL_Settings& opencl, TOpenCL_Stream& stream)
+    {
+        // The slot the next block would go to holds the oldest block.
+        for (size_t i = 0; i < stream.slots.size(); ++i)
+        {
+            auto& slot = stream.slots.at((stream.next + i) % stream.slots.size());
+            if (slot.busy)
+            {
+                Finish_OpenCL(local_values, opencl, slot);
+            }
+        }
     }
 
-    int CSecond_Iteration::Worker(const config::TThread_Params* thread_config, CWatchdog* watchdog)
+    int CSecond_Iteration::Worker(const config::TThread_Params* thread_config, CWatchdog* watchdog, CWork_Scheduler* scheduler, CResult_Slots<TValues>* results, size_t slot)
     {
         // Local values (each worker has its own).
         TValues local_values{}; 
@@ -211,8 +323,8 @@ namespace kiv_ppr
         }
 
         const cl::Device* device = nullptr;
-        kernels::TOpenCL_Settings opencl;
-        CResource_Guard opencl_device_guard;
+        kernels::TOpenCL_Settings* opencl = nullptr;
+        TOpenCL_Stream opencl_stream{};
         bool use_cpu = false;
 
         // Get the mode in which the program was started (SMP, ALL, ...).
@@ -225,8 +337,8 @@ namespace kiv_ppr
         }
         if (run_type == CArg_Parser::NRun_Type::All || run_type == CArg_Parser::NRun_Type::OpenCL_Devs)
         {
-            // Find any OpenCL device available.
-            device = resource_manager->Get_Available_Device();
+            // Get the OpenCL device of this thread (the thread holds it across both iterations).
+            device = kernels::Get_Worker_Device();
 
             // If there is no device available and the user ran the program in the 'ALL' mode, use the CPU.
             // Otherwise, return (the user only wants to use OpenCL device).
@@ -240,21 +352,27 @@ namespace kiv_ppr
             }
         }
 
-        // If the worker obtained an OpenCL device.
+        // If the worker obtained an OpenCL device, get the kernel (it is compiled only once per thread).
         if (nullptr != device)
         {
-            opencl = kernels::Init_OpenCL(device, kernels::Second_Iteration_Kernel, kernels::Second_Iteration_Kernel_Name);
-            kernels::Adjust_Work_Group_Size(opencl, kernels::Second_Iteration_Get_Size_Of_Local_Params);
-            opencl_device_guard.Set_Device(device);
+            opencl = &kernels::Get_Worker_OpenCL(device, kernels::Second_Iteration_Kernel, kernels::Second_Iteration_Kernel_Name, kernels::Second_Iteration_Get_Size_Of_Local_Params,
+                                                kernels::Second_Iteration_Min_Local_Histogram_Bins * sizeof(cl_uint));
+            for (uint32_t i = 0; i < config::processing::OpenCL_Blocks_In_Flight; ++i)
+            {
+                opencl_stream.slots.push_back(Create_OpenCL_Slot(*opencl, thread_config->number_of_elements_per_file_read));
+            }
         }
 
+        // Register the worker in the scheduler (the workers feeding an OpenCL device are reported under its name).
+        const size_t worker_id = scheduler->Register_Worker(nullptr == device ? CWork_Scheduler::CPU_Name : device->getInfo<CL_DEVICE_NAME>().c_str());
+
         // Start the watchdog
         watchdog->Start();
 
         while (true)
         {
-            // Read a block of data.
-            auto data_block = m_file->Read_Data(thread_config->number_of_elements_per_file_read);
+            // Read a block of data (its size is given by the throughput of the worker and the remaining work).
+            auto data_block = m_file->Read_Data(scheduler->Get_Block_Size(worker_id, m_file->Get_Number_Of_Remaining_Elements()));
 
             switch (data_block.status)
             {
@@ -266,17 +384,23 @@ namespace kiv_ppr
                     }
                     else
                     {
-                        Execute_On_GPU(local_values, data_block, opencl);
+                        Execute_On_GPU(local_values, data_block, *opencl, opencl_stream);
                     }
 
-                    // Kick the watchdog.
+                    // Kick the watchdog and let the scheduler know how much work has been done.
                     watchdog->Kick(data_block.count);
+                    scheduler->Report(worker_id, data_block.count);
                     break;
 
-                // The end of the file has been reached, so report
-                // the results (local values to the farmer).
+                // The end of the file has been reached, so publish
+                // the results (local values) into the slot of the worker.
                 case CFile_Reader<double>::NRead_Status::EOF_:
-                    Report_Worker_Results(local_values);
+                    if (!use_cpu)
+                    {
+                        // Wait for the blocks still being processed on the OpenCL device.
+                        Flush_OpenCL(local_values, *opencl, opencl_stream);
+                    }
+                    results->Publish(slot, local_values);
                     return 0;
 
                 // An error has ocurred. Inform the farmer that we failed to read the file.
@@ -294,94 +418,42 @@ namespace kiv_ppr
 
     void CSecond_Iteration::Execute_On_CPU(TValues& local_values, const CFile_Reader<double>::TData_Block& data_block, size_t offset)
     {
-        const __m256d _count_minus_1 = _mm256_set1_pd(static_cast<double>(m_basic_values->count) - 1);
-        const __m256d _mean = _mm256_set1_pd(m_basic_values->mean);
-        __m256d _var = _mm256_set1_pd(0);
-
-        std::array<double, 4> valid_doubles{};
-        std::size_t index = 0;
-
-        for (auto i = offset; i < data_block.count; ++i)
+        // Make sure that the CPU kernels are not NULL.
+        const auto cpu_kernels = Singleton<CCPU_Kernels>::Get_Instance();
+        if (nullptr == cpu_kernels)
         {
-            double value = data_block.data[i];
-
-            // The value has to to be a valid double.
-            if (utils::Is_Valid_Double(value))
-            {
-                // Scale the value down if necessary.
-                if (m_basic_values->min < 0)
-                {
-                    value /= config::processing::Scale_Factor;
-                }
+            std::cout << "Error: CPU kernels are NULL" << std::endl;
+            std::exit(26);
+        }
 
-                // Add the value into the array of valid doubles.
-                valid_doubles.at(index) = value;
+        // Scale the values down if necessary (the flag selects the specialization of the kernel, so it is not tested per value).
+        const kernels::cpu::TSecond_Iteration_Params params{
+            m_basic_values->mean,
+            m_basic_values->min < 0,
+            static_cast<double>(m_basic_values->count) - 1
+        };
 
-                // Once we have 4 valid doubles, udpate the variance
-                // using SIMD instructions of the CPU.
-                if (index == 3)
-                {
-                    index = 0;
-                    Update_Variance(valid_doubles, _var, _mean, _count_minus_1);
-                }
-                else
-                {
-                    ++index;
-                }
+        local_values.var += cpu_kernels->Second_Iteration(data_block.data.get() + offset, data_block.count - offset, params, *local_values.histogram);
+    }
 
-                // Update the local histogram.
-                local_values.histogram->Add(value);
-            }
-        }
-        // There might be some values left.
-        if (index != 0)
+    void CSecond_Iteration::Execute_On_GPU(TValues& local_values, const CFile_Reader<double>::TData_Block& data_block, kernels::TOpenCL_Settings& opencl, TOpenCL_Stream& stream)
+    {
+        // Take the next slot. If it is still busy, wait for its block (the oldest one in flight) first.
+        auto& slot = stream.slots.at(stream.next);
+        stream.next = (stream.next + 1) % stream.slots.size();
+        if (slot.busy)
         {
-            // The "unused" spots are set to m_basic_values->mean, which
-            // does not have any impact on the final result as the difference will be 0.
-            for (std::size_t i = index; i < 4; ++i)
-            {
-                valid_doubles.at(i) = m_basic_values->mean;
-            }
-            Update_Variance(valid_doubles, _var, _mean, _count_minus_1);
+            Finish_OpenCL(local_values, opencl, slot);
         }
 
-        // Aggeregate (sum up) all the values.
-        local_values.var = utils::vectorization::Aggregate(_var, 0.0, [](double x, double y) { return x + y; });
-    }
-
-    void CSecond_Iteration::Execute_On_GPU(TValues& local_values, const CFile_Reader<double>::TData_Block& data_block, kernels::TOpenCL_Settings& opencl)
-    {
         // Process as much data of the block of data on the OpenCL device as you can.
-        const auto opencl_report = Execute_OpenCL(opencl, data_block, local_values);
+        const size_t count = Enqueue_OpenCL(opencl, slot, data_block);
 
-        // If the number of values < work_group_size, we have to process it all on the CPU.
-        if (!opencl_report.success)
+        // The block does not fit into the buffers of the device, so we have to process it all on the CPU.
+        if (0 == count)
         {
             Execute_On_CPU(local_values, data_block);
         }
-        else if (!opencl_report.all_processed)
-        {
-            // Process the remaining part on the CPU.
-            const size_t offset = data_block.count - (data_block.count % opencl.work_group_size);
-            Execute_On_CPU(local_values, data_block, offset);
-        }
-    }
-
-    void CSecond_Iteration::Update_Variance(const std::array<double, 4>& valid_doubles, __m256d& _var, const __m256d& _mean, const __m256d& _count_minus_1) noexcept
-    {
-        // Add the four doubles into __m256d.
-        const __m256d _vals = _mm256_set_pd(
-            valid_doubles.at(0),
-            valid_doubles.at(1),
-            valid_doubles.at(2),
-            valid_doubles.at(3)
-        );
-
-        __m256d _delta = _mm256_sub_pd(_vals, _mean);
-        const __m256d _tmp_value = _delta;
-        _delta = _mm256_div_pd(_delta, _count_minus_1);
-        _delta = _mm256_mul_pd(_delta, _tmp_value);
-        _var = _mm256_add_pd(_var, _delta);
     }
 }
 
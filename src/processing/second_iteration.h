@@ -5,8 +5,10 @@
 
 #include "first_iteration.h"
 #include "histogram.h"
+#include "work_scheduler.h"
 #include "../utils/file_reader.h"
 #include "../utils/watchdog.h"
+#include "../utils/result_slots.h"
 
 namespace kiv_ppr
 {
@@ -46,33 +48,50 @@ namespace kiv_ppr
         /// \return 0, if all goes well. 1, if it failed to process the input file. 
         [[nodiscard]] int Run(config::TThread_Params* thread_config);
 
+        /// Helper function that calculates how many intervals should make up the histogram
+        /// based on the total number of valid doubles.
+        /// Idea taken from: 
+        /// https://onlinelibrary.wiley.com/doi/full/10.1002/1097-0320%2820011001%2945%3A2%3C141%3A%3AAID-CYTO1156%3E3.0.CO%3B2-M#bib11
+        /// \param n Number of values
+        /// \return Number of intervals
+        [[nodiscard]] static size_t Calculate_Number_Of_Intervals(size_t n) noexcept;
+
     private:
-        /// Report from an OpenCL device after it finishes given work.
-        struct TOpenCL_Report
+        /// Block of data being processed on an OpenCL device. Each slot has its own kernel and buffers
+        /// (allocated once, sized for the block size), so several blocks can be in flight at the same time.
+        struct TOpenCL_Slot
         {
-            bool success;       ///< Flag indicating if the device successfully finished given work
-            bool all_processed; ///< Flag indicating whether all values have been processed or not
+            size_t capacity = 0;                        ///< Maximum number of values in a block of data
+            cl::Kernel kernel{};                        ///< Kernel (its arguments are set only once)
+            cl::Buffer data{};                          ///< Input values
+            cl::Buffer out_var{};                       ///< Variances calculated by individual work groups
+            cl::Buffer histogram{};                     ///< Histogram (each interval is represented as two uints)
+            std::vector<double> var{};                  ///< Host copy of out_var
+            std::vector<cl_uint> bins{};                ///< Host copy of the histogram
+            cl_uint tile_size = 0;                      ///< Number of bins held in the local memory of a work group
+            size_t number_of_tiles = 0;                 ///< Number of executions of the kernel per block (one per tile of bins)
+            bool busy = false;                          ///< Flag indicating whether a block is being processed
+            size_t work_groups_count = 0;               ///< Number of work groups of the block being processed
+            std::vector<cl::Event> read_events{};       ///< Events of reading the results back from the device
         };
 
-    private:
-        /// Reports local values (from a thread) to the farmer. 
-        /// \param values Values calculated by a worker thread.
-        void Report_Worker_Results(const TValues& values);
+        /// Blocks of data in flight on an OpenCL device (used in a round robin fashion).
+        struct TOpenCL_Stream
+        {
+            std::vector<TOpenCL_Slot> slots{}; ///< Slots
+            size_t next = 0;                   ///< Index of the slot the next block goes to
+        };
 
+    private:
         /// Worker thread that processes one junk of data from the input file.
-        /// After the piece of data is processed, it reports the statistics to the farmer.
+        /// After the piece of data is processed, it publishes the statistics into its slot (the farmer merges the slots).
         /// \param thread_config Configuration containing the size of a data block processed by each thread
         /// \param watchdog Watchdog the thread periodically reports to (health check)
+        /// \param scheduler Scheduler deciding how many values the thread claims at a time
+        /// \param results Slots the workers publish their results into
+        /// \param slot Index of the slot of the worker
         /// \return 0, if all went well, 1 otherwise (e.g. failed to read the input file).
-        [[nodiscard]] int Worker(const config::TThread_Params* thread_config, CWatchdog* watchdog);
-
-        /// Helper function that calculates how many intervals should make up the histogram
-        /// based on the total number of valid doubles.
-        /// Idea taken from: 
-        /// https://onlinelibrary.wiley.com/doi/full/10.1002/1097-0320%2820011001%2945%3A2%3C141%3A%3AAID-CYTO1156%3E3.0.CO%3B2-M#bib11
-        /// \param n Number of values
-        /// \return Number of intervals
-        [[nodiscard]] static size_t Calculate_Number_Of_Intervals(size_t n) noexcept;
+        [[nodiscard]] int Worker(const config::TThread_Params* thread_config, CWatchdog* watchdog, CWork_Scheduler* scheduler, CResult_Slots<TValues>* results, size_t slot);
 
         /// Scales up the basic values calculated in the first iteration.
         /// If the minimum >= 0, we multiple the values as they were before scaling down in the first iteration.
@@ -85,35 +104,52 @@ namespace kiv_ppr
         /// This method directly modifies the local_values structure passed in as a parameter.
         /// \param local_values Local values being calculated within a single worker thread.
         /// \param data_block Block of data to be processed.
-        /// \param offset Offset (remaining part of data that could not be calculated on the OpenCL device).
+        /// \param offset Index of the first value to be processed.
         void Execute_On_CPU(TValues& local_values, const CFile_Reader<double>::TData_Block& data_block, size_t offset = 0);
 
-        /// Processes a block of data read from the input file on an OpenCL device.
+        /// Processes a block of data read from the input file on an OpenCL device. The block is enqueued into the next slot
+        /// of the device (waiting for the results of the block previously held by the slot), so the device works on it
+        /// while the worker reads the next block. The whole block is processed on the device (the launch is padded up to a multiple
+        /// of the work group size and the kernel masks out the extra work items).
         /// This method directly modifies the local_values structure passed in as a parameter.
         /// \param local_values Local values being calculated within a single worker thread.
         /// \param data_block Block of data to be processed.
         /// \param opencl OpenCL configuration (device, context, work group size, ...)
-        void Execute_On_GPU(TValues& local_values, const CFile_Reader<double>::TData_Block& data_block, kernels::TOpenCL_Settings& opencl);
+        /// \param stream Blocks in flight on the device
+        void Execute_On_GPU(TValues& local_values, const CFile_Reader<double>::TData_Block& data_block, kernels::TOpenCL_Settings& opencl, TOpenCL_Stream& stream);
+
+        /// Creates a slot of an OpenCL device: allocates the buffers and passes them into the kernel along with
+        /// the values calculated in the first iteration (the arguments never change during the run).
+        /// \param opencl OpenCL configuration (device, context, work group size, ...)
+        /// \param capacity Maximum number of values in a block of data
+        /// \return Slot of the OpenCL device
+        [[nodiscard]] TOpenCL_Slot Create_OpenCL_Slot(kernels::TOpenCL_Settings& opencl, size_t capacity);
 
-        /// Processes a block of data read from the input file on an OpenCL device.
+        /// Enqueues a block of data into an OpenCL device without waiting for the results.
+        /// The copy into the device, clearing the histogram, the kernel and the copy of the results back are chained using events.
         /// \param opencl OpenCL configuration (device, context, work group size, ...)
+        /// \param slot Free slot of the device
         /// \param data_block Block of data to be processed
-        /// \param local_values Statistical values being calculated in the second interation (var, sd, histogram)
-        /// \return  OpenCL report (whether the data was processed successfully or not and how many values were not processed due to the work group size).
-        [[nodiscard]] TOpenCL_Report Execute_OpenCL(kernels::TOpenCL_Settings& opencl, const CFile_Reader<double>::TData_Block& data_block, TValues& local_values);
+        /// \return Number of values enqueued (the whole block, 0 if the block does not fit into the buffers of the slot).
+        [[nodiscard]] static size_t Enqueue_OpenCL(kernels::TOpenCL_Settings& opencl, TOpenCL_Slot& slot, const CFile_Reader<double>::TData_Block& data_block);
+
+        /// Waits for the results of a slot and adds them into the local values (var, histogram). The slot becomes free.
+        /// \param local_values Local values being calculated within a single worker thread.
+        /// \param opencl OpenCL configuration (device, context, work group size, ...)
+        /// \param slot Busy slot of the device
+        void Finish_OpenCL(TValues& local_values, kernels::TOpenCL_Settings& opencl, TOpenCL_Slot& slot);
+
+        /// Waits for all blocks in flight (the oldest one first) and adds their results into the local values.
+        /// \param local_values Local values being calculated within a single worker thread.
+        /// \param opencl OpenCL configuration (device, context, work group size, ...)
+        /// \param stream Blocks in flight on the device
+        void Flush_OpenCL(TValues& local_values, kernels::TOpenCL_Settings& opencl, TOpenCL_Stream& stream);
 
-        /// Updates the variance using SIMD instructions.
-        /// \valid_doubles Array of four doubles
-        /// \_var Variance
-        /// \_mean Mean
-        /// \_count_minus_1 Number of valid numbers minus 1
-        void Update_Variance(const std::array<double, 4>& valid_doubles, __m256d& _var, const __m256d& _mean, const __m256d& _count_minus_1) noexcept;
 
     private:
         CFile_Reader<double>* m_file;                       ///< Pointer to the input file reader
         typename CFirst_Iteration::TValues* m_basic_values; ///< Statistical values calculated in the first iteration
         TValues m_values;                                   ///< Statistical values calculated in the second iteration
-        std::mutex m_mtx;                                   ///< Mutex used in the Farmer-Worker scheme
         CHistogram::TParams m_histogram_params;             ///< Histogram parameters
     };
 }
@@ -0,0 +1,283 @@
+#include <future>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <iostream>
+
+#include "../utils/utils.h"
+#include "../utils/singleton.h"
+#include "../utils/thread_pool.h"
+#include "single_pass.h"
+#include "cpu_kernels.h"
+
+namespace kiv_ppr
+{
+    CSingle_Pass::TState::TState()
+        : basic{},
+          histogram(config::processing::Fine_Histogram_Bins)
+    {
+
+    }
+
+    CSingle_Pass::CSingle_Pass(CFile_Reader<double>* file)
+        : m_file(file),
+          m_merged{},
+          m_values{}
+    {
+
+    }
+
+    CSingle_Pass::CSingle_Pass(CFile_Reader<double>* file, TState initial_state)
+        : m_file(file),
+          m_merged(std::move(initial_state)),
+          m_values{}
+    {
+
+    }
+
+    typename CSingle_Pass::TValues CSingle_Pass::Get_Values() const noexcept
+    {
+        return m_values;
+    }
+
+    const CSingle_Pass::TState& CSingle_Pass::Get_State() const noexcept
+    {
+        return m_merged;
+    }
+
+    int CSingle_Pass::Run(config::TThread_Params* thread_config)
+    {
+        // Read the input file.
+        if (0 != Read(thread_config))
+        {
+            return 1;
+        }
+
+        // Calculate the final values (variance, histogram, ...).
+        if (!Finalize())
+        {
+            return 1;
+        }
+
+        return 0;
+    }
+
+    int CSingle_Pass::Read(config::TThread_Params* thread_config)
+    {
+        // Seek to the beginning of the input file.
+        m_file->Seek_Beg();
+
+        // Create a new watchdog instance.
+        CWatchdog watchdog(thread_config->watchdog_expiration_sec);
+
+        // Make sure that the thread pool is not NULL.
+        auto thread_pool = Singleton<CThread_Pool>::Get_Instance();
+        if (nullptr == thread_pool)
+        {
+            std::cout << "Error: thread pool is NULL" << std::endl;
+            std::exit(24);
+        }
+
+        // Create a container for all the workers (they are executed by the thread pool).
+        std::vector<std::future<int>> workers(thread_config->number_of_threads);
+        for (auto& worker : workers)
+        {
+            worker = thread_pool->Submit(&CSingle_Pass::Worker, this, thread_config, &watchdog);
+        }
+
+        // Execute the workers and add up their return values.
+        // If all goes well, all return values should be 0.
+        int return_values = 0;
+        for (auto& worker : workers)
+        {
+            return_values += worker.get();
+        }
+
+        // Stop the watchdog.
+        watchdog.Stop();
+
+        // Check if the entire file has been read and none of the workers returned 1 (error).
+        if (return_values != 0 || watchdog.Get_Counter_Value() != m_file->Get_Number_Of_Elements())
+        {
+            return 1;
+        }
+
+        return 0;
+    }
+
+    void CSingle_Pass::Merge_State(const TState& state)
+    {
+        Report_Worker_Results(state);
+    }
+
+    int CSingle_Pass::Run_Merged()
+    {
+        // The variance and the histogram cannot be calculated without any values.
+        if (0 == m_merged.basic.count)
+        {
+            return 1;
+        }
+
+        // Calculate the final values (variance, histogram, ...).
+        if (!Finalize())
+        {
+            return 1;
+        }
+
+        return 0;
+    }
+
+    void CSingle_Pass::Report_Worker_Results(const TState& values)
+    {
+        const std::lock_guard<std::mutex> lock(m_mtx);
+
+        Merge_Moments(m_merged.basic, m_merged.m2, values.basic, values.m2);
+        m_merged.histogram += values.histogram;
+    }
+
+    int CSingle_Pass::Worker(const config::TThread_Params* thread_config, CWatchdog* watchdog)
+    {
+        TState local_values; // Local values (each worker has its own).
+
+        // Make sure that watchdog is not NULL
+        if (nullptr == watchdog)
+        {
+            std::cout << "Error: instance of CWatch_Dog is NULL" << std::endl;
+            std::exit(20);
+        }
+
+        // Start the watchdog
+        watchdog->Start();
+
+        while (true)
+        {
+            // Read a block of data.
+            auto data_block = m_file->Read_Data(thread_config->number_of_elements_per_file_read);
+
+            switch (data_block.status)
+            {
+                // Process the block of data.
+                case kiv_ppr::CFile_Reader<double>::NRead_Status::OK:
+                    Execute_On_CPU(local_values, data_block);
+
+                    // Kick the watchdog.
+                    watchdog->Kick(data_block.count);
+                    break;
+
+                // The end of the file has been reached, so report
+                // the results (local values to the farmer).
+                case CFile_Reader<double>::NRead_Status::EOF_:
+                    Report_Worker_Results(local_values);
+                    return 0;
+
+                // An error has ocurred. Inform the farmer that we failed to read the file.
+                case CFile_Reader<double>::NRead_Status::Error: [[fallthrough]];
+                default:
+                    return 1;
+            }
+        }
+    }
+
+    void CSingle_Pass::Execute_On_CPU(TState& local_values, const CFile_Reader<double>::TData_Block& data_block)
+    {
+        // Make sure that the CPU kernels are not NULL.
+        const auto cpu_kernels = Singleton<CCPU_Kernels>::Get_Instance();
+        if (nullptr == cpu_kernels)
+        {
+            std::cout << "Error: CPU kernels are NULL" << std::endl;
+            std::exit(26);
+        }
+
+        // First, calculate the basic values of the block (the block is already in the memory).
+        // Once a value that is not an integer has been found, the rest of the values do not have to be checked.
+        const auto block_values = cpu_kernels->First_Iteration(data_block.data.get(), data_block.count, local_values.basic.all_ints);
+
+        // There are no valid doubles in the block.
+        if (0 == block_values.count)
+        {
+            return;
+        }
+
+        // Make sure the histogram covers all values of the block.
+        local_values.histogram.Fit(block_values.min * config::processing::Scale_Factor, block_values.max * config::processing::Scale_Factor);
+
+        // Second, calculate M2 of the block and update the histogram.
+        double m2 = 0.0;
+        for (size_t i = 0; i < data_block.count; ++i)
+        {
+            const double value = data_block.data[i];
+            if (utils::Is_Valid_Double(value))
+            {
+                const double delta = value / config::processing::Scale_Factor - block_values.mean;
+                m2 += delta * delta;
+                local_values.histogram.Add_Fitted(value);
+            }
+        }
+
+        // Merge the block into the local values.
+        Merge_Moments(local_values.basic, local_values.m2, block_values, m2);
+    }
+
+    void CSingle_Pass::Merge_Moments(CFirst_Iteration::TValues& dest, double& dest_m2, const CFirst_Iteration::TValues& src, double src_m2) noexcept
+    {
+        // Nothing to merge.
+        if (0 == src.count)
+        {
+            return;
+        }
+
+        // Add up the two sub-counts to the total count.
+        const size_t total_count = dest.count + src.count;
+        const double dest_weight = static_cast<double>(dest.count) / static_cast<double>(total_count);
+        const double src_weight = static_cast<double>(src.count) / static_cast<double>(total_count);
+        const double delta = src.mean - dest.mean;
+
+        // Update M2 (Chan et al.) and the mean (with regards to how many values were used to calculate each sub-mean).
+        dest_m2 += src_m2 + delta * delta * static_cast<double>(dest.count) * src_weight;
+        dest.mean = dest.mean * dest_weight + src.mean * src_weight;
+
+        // Update the minimum, maximum, and all_ints.
+        dest.min = std::min(dest.min, src.min);
+        dest.max = std::max(dest.max, src.max);
+        dest.all_ints = dest.all_ints && src.all_ints;
+
+        // Update the total count.
+        dest.count = total_count;
+    }
+
+    bool CSingle_Pass::Finalize()
+    {
+        auto& basic_values = m_values.first_iteration;
+        basic_values = m_merged.basic;
+
+        // Same as in the second iteration - if the minimum >= 0, the values are scaled up, 
+        // so the poisson distribution is not affected by the scaling. 
+        const bool scale_up = basic_values.min >= 0;
+        const double divisor = scale_up ? 1.0 : config::processing::Scale_Factor;
+        if (scale_up)
+        {
+            basic_values.min *= config::processing::Scale_Factor;
+            basic_values.max *= config::processing::Scale_Factor;
+            basic_values.mean *= config::processing::Scale_Factor;
+        }
+
+        // Calculate the variance and the standard deviation.
+        const double scale_factor_2 = scale_up ? config::processing::Scale_Factor * config::processing::Scale_Factor : 1.0;
+        m_values.second_iteration.var = m_merged.m2 * scale_factor_2 / (static_cast<double>(basic_values.count) - 1);
+        m_values.second_iteration.sd = std::sqrt(m_values.second_iteration.var);
+
+        // Rebin the fine histogram into the histogram used by the Chi-Square test.
+        m_values.second_iteration.histogram = std::make_shared<CHistogram>(CHistogram::TParams{
+            basic_values.min,
+            basic_values.max,
+            CSecond_Iteration::Calculate_Number_Of_Intervals(basic_values.count)
+        });
+
+        return m_merged.histogram.Rebin(*m_values.second_iteration.histogram,
+                                        divisor,
+                                        m_merged.basic.min * config::processing::Scale_Factor,
+                                        basic_values.all_ints);
+    }
+}
+
+// EOF
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <mutex>
+
+#include "../config.h"
+#include "../utils/file_reader.h"
+#include "../utils/watchdog.h"
+#include "first_iteration.h"
+#include "second_iteration.h"
+#include "auto_histogram.h"
+
+namespace kiv_ppr
+{
+    /// \author Jakub Silhavy
+    ///
+    /// This class calculates all statistics (min, max, mean, count, all_ints, variance,
+    /// standard deviation, and histogram) in a single pass over the input file.
+    /// The variance is calculated from partial moments (count, mean, M2) of individual
+    /// data blocks, which are merged using Chan's formula. The histogram is collected
+    /// as a fine-grained auto-ranging histogram (see CAuto_Histogram) and rebinned 
+    /// into the layout used in the second iteration at the end.
+    ///
+    /// Compared to the two passes (CFirst_Iteration + CSecond_Iteration), min, max, count, and all_ints
+    /// are identical. The mean and variance may differ in the last few digits due to a different order 
+    /// of floating point operations. The histogram is identical for integer data (e.g. poisson). For other data, 
+    /// at most one fine bin per interval boundary may end up in the neighbouring interval 
+    /// (a fine bin is at least ~2^20 times narrower than the range of the data).
+    /// The single pass is executed only on the CPU.
+    class CSingle_Pass
+    {
+    public:
+        /// Statistical values calculated in the single pass.
+        struct TValues
+        {
+            CFirst_Iteration::TValues first_iteration;   ///< Values corresponding to the first iteration (min, max, mean, all_ints, count)
+            CSecond_Iteration::TValues second_iteration; ///< Values corresponding to the second iteration (variance, sd, histogram)
+        };
+
+        /// Mergeable state calculated from a part of the data (by a worker thread, in a previous run, ...).
+        /// Two states can be merged together regardless of the order and the range of their values.
+        struct TState
+        {
+            CFirst_Iteration::TValues basic; ///< Min, max, mean, count, all_ints (scaled down values)
+            double m2 = 0.0;                 ///< Sum of squared differences from the mean (scaled down values)
+            CAuto_Histogram histogram;       ///< Fine-grained histogram (original values)
+
+            /// Creates an instance of the struct.
+            TState();
+        };
+
+    public:
+        /// Creates an instance of the class.
+        /// \param file Pointer to an input file reader.
+        explicit CSingle_Pass(CFile_Reader<double>* file);
+
+        /// Creates an instance of the class that continues from a state calculated earlier
+        /// (the data read by Run is merged into the state).
+        /// \param file Pointer to an input file reader.
+        /// \param initial_state State calculated from the data that is not going to be read
+        CSingle_Pass(CFile_Reader<double>* file, TState initial_state);
+
+        /// Default destructor.
+        ~CSingle_Pass() = default;
+
+        /// Returns statistical values calculated in the single pass.
+        /// \return Statistical values: min, max, mean, count, all_ints, variance, sd, histogram
+        [[nodiscard]] TValues Get_Values() const noexcept;
+
+        /// Returns the mergeable state of all the data processed (the initial state included).
+        /// \return Mergeable state (valid after Run)
+        [[nodiscard]] const TState& Get_State() const noexcept;
+
+        /// Reads the input file and calculates the statistical values.
+        /// \param thread_config Configuration containing how many threads should be used to process the input file.
+        /// \return 0, if all goes well. 1, if it failed to process the input file.
+        [[nodiscard]] int Run(config::TThread_Params* thread_config);
+
+        /// Reads the input file and merges the data into the state of the pass without calculating
+        /// the final values (e.g. so the state can be stored as a partial state, see Get_State).
+        /// \param thread_config Configuration containing how many threads should be used to process the input file.
+        /// \return 0, if all goes well. 1, if it failed to process the input file.
+        [[nodiscard]] int Read(config::TThread_Params* thread_config);
+
+        /// Merges a state calculated elsewhere (e.g. a partial state of another node, see CState_File) into the state of the pass.
+        /// \param state State calculated from the data that is not going to be read
+        void Merge_State(const TState& state);
+
+        /// Calculates the statistical values from the merged state without reading the input file
+        /// (all the data has been merged in by Merge_State, the file reader may be NULL).
+        /// \return 0, if all goes well. 1, if the values could not be calculated (e.g. there are no valid doubles).
+        [[nodiscard]] int Run_Merged();
+
+    private:
+        /// Reports local values (from a thread) to the farmer.
+        /// \param values Values calculated by a worker thread.
+        void Report_Worker_Results(const TState& values);
+
+        /// Worker thread that processes one junk of data from the input file.
+        /// After the piece of data is processed, it reports the statistics to the farmer.
+        /// \param thread_config Configuration containing the size of a data block processed by each thread
+        /// \param watchdog Watchdog the thread periodically reports to (health check)
+        /// \return 0, if all went well, 1 otherwise (e.g. failed to read the input file).
+        [[nodiscard]] int Worker(const config::TThread_Params* thread_config, CWatchdog* watchdog);
+
+        /// Processes a block of data read from the input file on the CPU.
+        /// This method directly modifies the local_values structure passed in as a parameter.
+        /// \param local_values Local values being calculated within a single worker thread.
+        /// \param data_block Block of data to be processed.
+        static void Execute_On_CPU(TState& local_values, const CFile_Reader<double>::TData_Block& data_block);
+
+        /// Merges partial moments (count, mean, M2) using Chan's formula. The minimum, maximum, and all_ints are merged as well.
+        /// \param dest Destination values that will be modified (result).
+        /// \param dest_m2 M2 of the destination values
+        /// \param src The other set of values to be merged into the first set of values.
+        /// \param src_m2 M2 of the other set of values
+        static void Merge_Moments(CFirst_Iteration::TValues& dest, double& dest_m2, const CFirst_Iteration::TValues& src, double src_m2) noexcept;
+
+        /// Converts the merged values into the values of both iterations.
+        /// \return true, if all went well, false otherwise.
+        [[nodiscard]] bool Finalize();
+
+    private:
+        CFile_Reader<double>* m_file; ///< Pointer to the input file reader
+        TState m_merged;              ///< Values merged from all the workers (and the initial state)
+        TValues m_values;             ///< Final statistical values
+        std::mutex m_mtx;             ///< Mutex used in the Farmer-Worker scheme
+    };
+}
+
+// EOF
@@ -0,0 +1,136 @@
+#include <cstring>
+#include <filesystem>
+
+#include "state_file.h"
+#include "../utils/utils.h"
+
+namespace kiv_ppr
+{
+    CState_File::CState_File(const std::string& path)
+        : m_path(path)
+    {
+
+    }
+
+    bool CState_File::Load(TRange& range, CSingle_Pass::TState& state) const
+    {
+        using utils::serialization::Extract;
+
+        std::string data;
+        if (!utils::serialization::Load_File(m_path, data) || data.size() < sizeof(uint64_t))
+        {
+            return false;
+        }
+
+        // The file is damaged (e.g. it has been truncated).
+        uint64_t checksum = 0;
+        size_t checksum_offset = data.size() - sizeof(checksum);
+        if (!Extract(data, checksum_offset, checksum) || checksum != utils::serialization::Hash(data.data(), data.size() - sizeof(checksum)))
+        {
+            return false;
+        }
+        data.resize(data.size() - sizeof(checksum));
+
+        // Read the header of the file (magic, version, range).
+        size_t offset = 0;
+        char magic[8]{};
+        uint32_t version = 0;
+        TRange stored_range{};
+        if (!Extract(data, offset, magic) || 0 != std::memcmp(magic, Magic, sizeof(magic)) ||
+            !Extract(data, offset, version) || Version != version ||
+            !Extract(data, offset, stored_range.first_byte) ||
+            !Extract(data, offset, stored_range.end_byte) ||
+            !Extract(data, offset, stored_range.content_hash) ||
+            !Extract(data, offset, stored_range.file_size) ||
+            !Extract(data, offset, stored_range.file_hash) ||
+            stored_range.first_byte > stored_range.end_byte || stored_range.end_byte > stored_range.file_size)
+        {
+            return false;
+        }
+
+        // Read the state itself (min, max, mean, count, all_ints, M2, histogram).
+        CSingle_Pass::TState stored_state;
+        uint64_t count = 0;
+        uint8_t all_ints = 0;
+        if (!Extract(data, offset, stored_state.basic.min) ||
+            !Extract(data, offset, stored_state.basic.max) ||
+            !Extract(data, offset, stored_state.basic.mean) ||
+            !Extract(data, offset, count) ||
+            !Extract(data, offset, all_ints) ||
+            !Extract(data, offset, stored_state.m2) ||
+            !stored_state.histogram.Deserialize(data, offset))
+        {
+            return false;
+        }
+        stored_state.basic.count = static_cast<size_t>(count);
+        stored_state.basic.all_ints = 0 != all_ints;
+
+        // All the data has to be used up and the histogram has to hold all the values.
+        if (offset != data.size() || stored_state.histogram.Get_Total_Count() != stored_state.basic.count)
+        {
+            return false;
+        }
+
+        range = stored_range;
+        state = std::move(stored_state);
+
+        return true;
+    }
+
+    bool CState_File::Store(const TRange& range, const CSingle_Pass::TState& state) const
+    {
+        using utils::serialization::Append;
+
+        // Header of the file (magic, version, range).
+        std::string data(Magic, 8);
+        Append(data, Version);
+        Append(data, range.first_byte);
+        Append(data, range.end_byte);
+        Append(data, range.content_hash);
+        Append(data, range.file_size);
+        Append(data, range.file_hash);
+
+        // The state itself (min, max, mean, count, all_ints, M2, histogram).
+        Append(data, state.basic.min);
+        Append(data, state.basic.max);
+        Append(data, state.basic.mean);
+        Append(data, static_cast<uint64_t>(state.basic.count));
+        Append(data, static_cast<uint8_t>(state.basic.all_ints ? 1 : 0));
+        Append(data, state.m2);
+        state.histogram.Serialize(data);
+
+        // Checksum of everything.
+        Append(data, utils::serialization::Hash(data.data(), data.size()));
+
+        return utils::serialization::Store_File(m_path, data);
+    }
+
+    const std::string& CState_File::Get_Path() const noexcept
+    {
+        return m_path;
+    }
+
+    bool CState_File::Create_Range(const std::string& filename, uint64_t first_byte, uint64_t end_byte, TRange& range)
+    {
+        if (first_byte > end_byte)
+        {
+            return false;
+        }
+
+        std::error_code error;
+        const uint64_t file_size = std::filesystem::file_size(filename, error);
+        if (error || end_byte > file_size)
+        {
+            return false;
+        }
+
+        range.first_byte = first_byte;
+        range.end_byte = end_byte;
+        range.file_size = file_size;
+
+        return utils::serialization::Hash_File_Samples(filename, first_byte, end_byte - first_byte, range.content_hash) &&
+               utils::serialization::Hash_File_Samples(filename, 0, file_size, range.file_hash);
+    }
+}
+
+// EOF
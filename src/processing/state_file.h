@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#include "single_pass.h"
+
+namespace kiv_ppr
+{
+    /// \author Jakub Silhavy
+    ///
+    /// This class represents a file holding the mergeable state of the single pass (see CSingle_Pass::TState),
+    /// i.e. the count, mean, M2, min, max, all_ints and the fine-grained histogram of a part of an input file.
+    /// Along with the state, it holds the range of bytes the state has been calculated from and the hash
+    /// of evenly spaced samples of the range, so it can be verified that the data has not changed since.
+    /// The histogram lies on a global grid (see CAuto_Histogram), so the state does not depend on the range
+    /// of the values, and states of different parts of the data can be merged in any order. It is used by the append
+    /// mode as well as by the sharded processing (partial states calculated on different nodes are merged together).
+    class CState_File
+    {
+    public:
+        /// Part of an input file a state has been calculated from.
+        struct TRange
+        {
+            uint64_t first_byte = 0;   ///< Offset of the first byte
+            uint64_t end_byte = 0;     ///< Offset past the last byte
+            uint64_t content_hash = 0; ///< Hash of samples of the bytes <first_byte; end_byte) (see utils::serialization::Hash_File_Samples)
+            uint64_t file_size = 0;    ///< Size of the whole input file
+            uint64_t file_hash = 0;    ///< Hash of samples of the whole input file (parts of the same file share it)
+        };
+
+    public:
+        /// Creates an instance of the class.
+        /// \param path Path to the state file
+        explicit CState_File(const std::string& path);
+
+        /// Default destructor.
+        ~CState_File() = default;
+
+        /// Reads the state from the file.
+        /// \param range Part of the input file the state has been calculated from
+        /// \param state Mergeable state
+        /// \return true, if the state has been read, false, if the file does not exist or it is not valid (damaged, different version, ...).
+        [[nodiscard]] bool Load(TRange& range, CSingle_Pass::TState& state) const;
+
+        /// Stores the state into the file. The state is written into a temporary file first,
+        /// so the previous state is not lost if the writing fails.
+        /// \param range Part of the input file the state has been calculated from
+        /// \param state Mergeable state
+        /// \return true, if the state has been stored, false otherwise.
+        [[nodiscard]] bool Store(const TRange& range, const CSingle_Pass::TState& state) const;
+
+        /// Returns the path to the state file.
+        /// \return Path to the state file
+        [[nodiscard]] const std::string& Get_Path() const noexcept;
+
+        /// Creates the range of a part of an input file (the samples of the part as well as of the whole file are hashed).
+        /// \param filename Path to the input file
+        /// \param first_byte Offset of the first byte
+        /// \param end_byte Offset past the last byte
+        /// \param range Range of the part of the input file
+        /// \return true, if the range has been created, false, if the input file could not be read.
+        [[nodiscard]] static bool Create_Range(const std::string& filename, uint64_t first_byte, uint64_t end_byte, TRange& range);
+
+    private:
+        /// Identification of a state file.
+        static constexpr const char* Magic = "KIVPPRSP";
+
+        /// Version of the layout of a state file (files of a different version are ignored).
+        static constexpr uint32_t Version = 2;
+
+    private:
+        std::string m_path; ///< Path to the state file
+    };
+}
+
+// EOF
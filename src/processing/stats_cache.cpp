@@ -0,0 +1,222 @@
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <filesystem>
+
+#include "stats_cache.h"
+#include "../utils/utils.h"
+#include "../config.h"
+
+namespace kiv_ppr
+{
+    CStats_Cache::CStats_Cache(const std::string& filename)
+        : m_filename(filename),
+          m_path(filename + config::processing::Stats_Cache_Extension),
+          m_key{},
+          m_has_key(Create_Key(filename, m_key))
+    {
+
+    }
+
+    bool CStats_Cache::Load(CFile_Stats::TValues& values) const
+    {
+        // The input file could not be inspected, so there is nothing to compare the sidecar file against.
+        std::string data;
+        if (!m_has_key || !utils::serialization::Load_File(m_path, data) || data.size() < sizeof(uint64_t))
+        {
+            return false;
+        }
+
+        // The sidecar file is damaged (e.g. it has been truncated).
+        uint64_t checksum = 0;
+        size_t checksum_offset = data.size() - sizeof(checksum);
+        if (!utils::serialization::Extract(data, checksum_offset, checksum) ||
+            checksum != utils::serialization::Hash(data.data(), data.size() - sizeof(checksum)))
+        {
+            return false;
+        }
+        data.resize(data.size() - sizeof(checksum));
+
+        // Read the header of the file (magic, version, key).
+        size_t offset = 0;
+        char magic[8]{};
+        uint32_t version = 0;
+        uint64_t key_size = 0;
+        if (!utils::serialization::Extract(data, offset, magic) || 0 != std::memcmp(magic, Magic, sizeof(magic)) ||
+            !utils::serialization::Extract(data, offset, version) || Version != version ||
+            !utils::serialization::Extract(data, offset, key_size) || key_size != m_key.size() || data.size() - offset < key_size)
+        {
+            return false;
+        }
+
+        // The input file has been modified (or replaced) since the statistics were stored.
+        if (0 != data.compare(offset, key_size, m_key))
+        {
+            return false;
+        }
+
+        return Deserialize(data, offset + key_size, values);
+    }
+
+    bool CStats_Cache::Store(const CFile_Stats::TValues& values) const
+    {
+        // The input file could not be inspected or there is no histogram to be stored.
+        if (!m_has_key || nullptr == values.second_iteration.histogram)
+        {
+            return false;
+        }
+
+        // The input file has been modified while it was being processed, so the statistics may not match its content.
+        std::string key;
+        if (!Create_Key(m_filename, key) || key != m_key)
+        {
+            std::error_code error;
+            std::filesystem::remove(m_path, error);
+            return false;
+        }
+
+        // Header of the file (magic, version, key), the statistics and the checksum of everything.
+        std::string data(Magic, 8);
+        utils::serialization::Append(data, Version);
+        utils::serialization::Append(data, static_cast<uint64_t>(m_key.size()));
+        data += m_key;
+        Serialize(data, values);
+        utils::serialization::Append(data, utils::serialization::Hash(data.data(), data.size()));
+
+        return utils::serialization::Store_File(m_path, data);
+    }
+
+    const std::string& CStats_Cache::Get_Path() const noexcept
+    {
+        return m_path;
+    }
+
+    bool CStats_Cache::Create_Key(const std::string& filename, std::string& key)
+    {
+        std::error_code error;
+        const auto path = std::filesystem::absolute(filename, error);
+        if (error)
+        {
+            return false;
+        }
+        const uint64_t file_size = std::filesystem::file_size(path, error);
+        if (error)
+        {
+            return false;
+        }
+        const auto modified = std::filesystem::last_write_time(path, error);
+        if (error)
+        {
+            return false;
+        }
+
+        // The time of the last modification may not change if the file is rewritten quickly (coarse timestamps),
+        // so the content of the file is sampled as well.
+        uint64_t content_hash = 0;
+        if (!utils::serialization::Hash_File_Samples(path.string(), 0, file_size, content_hash))
+        {
+            return false;
+        }
+
+        std::ostringstream stream;
+        stream << "path=" << path.string() << "\n"
+               << "size=" << file_size << "\n"
+               << "modified=" << modified.time_since_epoch().count() << "\n"
+               << "samples=" << std::hex << std::setw(16) << std::setfill('0') << content_hash << "\n";
+
+        key = stream.str();
+        return true;
+    }
+
+    void CStats_Cache::Serialize(std::string& data, const CFile_Stats::TValues& values)
+    {
+        using utils::serialization::Append;
+
+        const auto& first_iteration = values.first_iteration;
+        const auto& second_iteration = values.second_iteration;
+        const auto& histogram = *second_iteration.histogram;
+        const auto params = histogram.Get_Params();
+
+        // Values of the first iteration.
+        Append(data, first_iteration.min);
+        Append(data, first_iteration.max);
+        Append(data, first_iteration.mean);
+        Append(data, static_cast<uint64_t>(first_iteration.count));
+        Append(data, static_cast<uint8_t>(first_iteration.all_ints ? 1 : 0));
+
+        // Values of the second iteration.
+        Append(data, second_iteration.var);
+        Append(data, second_iteration.sd);
+
+        // Parameters of the histogram and its intervals.
+        Append(data, params.min);
+        Append(data, params.max);
+        Append(data, static_cast<uint64_t>(params.number_of_intervals));
+        Append(data, static_cast<uint64_t>(histogram.Get_Number_Of_Intervals()));
+        for (size_t i = 0; i < histogram.Get_Number_Of_Intervals(); ++i)
+        {
+            Append(data, static_cast<uint64_t>(histogram.at(i)));
+        }
+    }
+
+    bool CStats_Cache::Deserialize(const std::string& data, size_t offset, CFile_Stats::TValues& values)
+    {
+        using utils::serialization::Extract;
+
+        CFirst_Iteration::TValues first_iteration{};
+        CSecond_Iteration::TValues second_iteration{};
+        uint64_t count = 0;
+        uint8_t all_ints = 0;
+
+        // Values of the first and the second iteration.
+        if (!Extract(data, offset, first_iteration.min) ||
+            !Extract(data, offset, first_iteration.max) ||
+            !Extract(data, offset, first_iteration.mean) ||
+            !Extract(data, offset, count) ||
+            !Extract(data, offset, all_ints) ||
+            !Extract(data, offset, second_iteration.var) ||
+            !Extract(data, offset, second_iteration.sd))
+        {
+            return false;
+        }
+        first_iteration.count = static_cast<size_t>(count);
+        first_iteration.all_ints = 0 != all_ints;
+
+        // Parameters of the histogram.
+        CHistogram::TParams params{};
+        uint64_t number_of_intervals = 0;
+        uint64_t stored_intervals = 0;
+        if (!Extract(data, offset, params.min) ||
+            !Extract(data, offset, params.max) ||
+            !Extract(data, offset, number_of_intervals) ||
+            !Extract(data, offset, stored_intervals))
+        {
+            return false;
+        }
+        params.number_of_intervals = static_cast<size_t>(number_of_intervals);
+
+        // The number of the stored intervals has to match the parameters of the histogram and the rest of the data.
+        if (stored_intervals != number_of_intervals + 1 || (data.size() - offset) != stored_intervals * sizeof(uint64_t))
+        {
+            return false;
+        }
+
+        // Restore the intervals of the histogram.
+        second_iteration.histogram = std::make_shared<CHistogram>(params);
+        for (size_t i = 0; i < stored_intervals; ++i)
+        {
+            uint64_t value = 0;
+            if (!Extract(data, offset, value) || !second_iteration.histogram->Add(i, static_cast<size_t>(value)))
+            {
+                return false;
+            }
+        }
+
+        values.first_iteration = first_iteration;
+        values.second_iteration = second_iteration;
+
+        return true;
+    }
+}
+
+// EOF
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#include "file_stats.h"
+
+namespace kiv_ppr
+{
+    /// \author Jakub Silhavy
+    ///
+    /// This class represents a sidecar file (<input file>.pprstats) the statistics calculated from an input file
+    /// are cached in (values of the first iteration, variance, standard deviation and the bins of the histogram).
+    /// The statistics are looked up by a key made of the absolute path to the input file, its size, the time of its last
+    /// modification and the hash of evenly spaced samples of its content. If the key stored in the sidecar file does not match
+    /// or the sidecar file is damaged (its checksum does not match), the statistics are considered not cached and calculated again.
+    /// Repeated runs on the same input file (e.g. with a different critical P-value) then do not have to read the whole file.
+    class CStats_Cache
+    {
+    public:
+        /// Creates an instance of the class. The key of the input file is created right away,
+        /// so a modification of the file while it is being processed is detected by Store.
+        /// \param filename Path to the input file
+        explicit CStats_Cache(const std::string& filename);
+
+        /// Default destructor.
+        ~CStats_Cache() = default;
+
+        /// Reads the statistics of the input file from the sidecar file.
+        /// \param values Statistics of the input file (they are left untouched unless they are found)
+        /// \return true, if the statistics have been found, false otherwise.
+        [[nodiscard]] bool Load(CFile_Stats::TValues& values) const;
+
+        /// Stores the statistics of the input file into the sidecar file. The statistics are written into a temporary file
+        /// first, so another process never reads a half-written file. If the input file has been modified since the instance was
+        /// created, the statistics are not stored and the (now stale) sidecar file is removed.
+        /// \param values Statistics calculated from the input file
+        /// \return true, if the statistics have been stored, false otherwise.
+        [[nodiscard]] bool Store(const CFile_Stats::TValues& values) const;
+
+        /// Returns the path to the sidecar file.
+        /// \return Path to the sidecar file
+        [[nodiscard]] const std::string& Get_Path() const noexcept;
+
+    private:
+        /// Creates the key of the input file (everything the statistics depend on).
+        /// \param filename Path to the input file
+        /// \param key Key of the input file
+        /// \return true, if the key has been created, false, if the input file could not be inspected.
+        [[nodiscard]] static bool Create_Key(const std::string& filename, std::string& key);
+
+        /// Serializes the statistics into a sequence of bytes.
+        /// \param data Sequence of bytes the statistics are appended to
+        /// \param values Statistics of the input file
+        static void Serialize(std::string& data, const CFile_Stats::TValues& values);
+
+        /// Restores the statistics from a sequence of bytes.
+        /// \param data Serialized statistics
+        /// \param offset Position of the statistics within the data
+        /// \param values Statistics of the input file
+        /// \return true, if the statistics have been restored, false, if the data is not valid.
+        [[nodiscard]] static bool Deserialize(const std::string& data, size_t offset, CFile_Stats::TValues& values);
+
+    private:
+        /// Identification of a sidecar file.
+        static constexpr const char* Magic = "KIVPPRST";
+
+        /// Version of the layout of a sidecar file (files of a different version are ignored).
+        static constexpr uint32_t Version = 1;
+
+    private:
+        std::string m_filename; ///< Path to the input file
+        std::string m_path;     ///< Path to the sidecar file
+        std::string m_key;      ///< Key of the input file at the time the instance was created
+        bool m_has_key;         ///< Flag indicating whether the key has been created (the input file could be inspected)
+    };
+}
+
+// EOF
@@ -0,0 +1,110 @@
+#include <map>
+#include <iomanip>
+#include <algorithm>
+
+#include "work_scheduler.h"
+
+namespace kiv_ppr
+{
+    CWork_Scheduler::CWork_Scheduler(size_t max_block_size, size_t min_block_size)
+        : m_max_block_size(std::max<size_t>(max_block_size, 1)),
+          m_min_block_size(std::clamp<size_t>(min_block_size, 1, std::max<size_t>(max_block_size, 1)))
+    {
+
+    }
+
+    size_t CWork_Scheduler::Register_Worker(const std::string& name)
+    {
+        const std::lock_guard<std::mutex> lock(m_mtx);
+
+        m_workers.push_back({ name, std::chrono::steady_clock::now(), 0, 0.0 });
+        return m_workers.size() - 1;
+    }
+
+    size_t CWork_Scheduler::Get_Block_Size(size_t worker_id, size_t remaining)
+    {
+        const std::lock_guard<std::mutex> lock(m_mtx);
+
+        // The worker has not been measured yet, so it claims a full block.
+        const double throughput = m_workers.at(worker_id).throughput;
+        if (throughput <= 0.0)
+        {
+            return m_max_block_size;
+        }
+
+        // Total throughput of all workers (the ones that have not been measured yet are counted as the slowest one).
+        double total_throughput = 0.0;
+        double min_throughput = throughput;
+        for (const auto& worker : m_workers)
+        {
+            if (worker.throughput > 0.0)
+            {
+                min_throughput = std::min(min_throughput, worker.throughput);
+            }
+        }
+        for (const auto& worker : m_workers)
+        {
+            total_throughput += (worker.throughput > 0.0) ? worker.throughput : min_throughput;
+        }
+
+        // Take a part of the share of the worker in the remaining work.
+        const double share = throughput / total_throughput;
+        const auto block_size = static_cast<size_t>(static_cast<double>(remaining) * share / Guided_Divisor);
+
+        return std::clamp(block_size, m_min_block_size, m_max_block_size);
+    }
+
+    void CWork_Scheduler::Report(size_t worker_id, size_t count)
+    {
+        const std::lock_guard<std::mutex> lock(m_mtx);
+
+        auto& worker = m_workers.at(worker_id);
+        worker.count += count;
+
+        // Throughput of the worker since it registered (it includes reading the input file).
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - worker.start;
+        if (elapsed.count() > 0.0)
+        {
+            worker.throughput = static_cast<double>(worker.count) / elapsed.count();
+        }
+    }
+
+    bool CWork_Scheduler::Has_Devices() const
+    {
+        const std::lock_guard<std::mutex> lock(m_mtx);
+
+        return std::any_of(m_workers.begin(), m_workers.end(), [](const TWorker& worker) { return worker.name != CPU_Name; });
+    }
+
+    std::ostream& operator<<(std::ostream& out, const CWork_Scheduler& scheduler)
+    {
+        const std::lock_guard<std::mutex> lock(scheduler.m_mtx);
+
+        const auto precision = out.precision();
+
+        // Add up the work done by the workers using the same device (name -> number of workers, values).
+        std::map<std::string, std::pair<size_t, size_t>> devices;
+        size_t total_count = 0;
+        for (const auto& worker : scheduler.m_workers)
+        {
+            auto& [workers, count] = devices[worker.name];
+            ++workers;
+            count += worker.count;
+            total_count += worker.count;
+        }
+
+        for (const auto& [name, stats] : devices)
+        {
+            const auto& [workers, count] = stats;
+            const double share = (0 == total_count) ? 0.0 : 100.0 * static_cast<double>(count) / static_cast<double>(total_count);
+
+            out << "    " << name << " (" << workers << (1 == workers ? " worker" : " workers") << ") = "
+                << std::fixed << std::setprecision(1) << share << "% [" << count << " values]" << std::defaultfloat << '\n';
+        }
+
+        out.precision(precision);
+        return out;
+    }
+}
+
+// EOF
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <ostream>
+
+namespace kiv_ppr
+{
+    /// \author Jakub Silhavy
+    ///
+    /// This class decides how many values a worker claims from the input file at a time (guided self-scheduling).
+    /// It measures the throughput of each worker (values per second since the worker registered) and hands out
+    /// claims proportional to the share of the worker in the total throughput of all workers. While there is a lot
+    /// of work left, every worker claims full blocks. Towards the end of the file, the claims shrink, so a slow device
+    /// does not take up the last large block and keep everybody else waiting. The class also keeps track of how much
+    /// work each device (or the CPU) has done, so it can be reported at the end.
+    class CWork_Scheduler
+    {
+    public:
+        /// Creates an instance of the class.
+        /// \param max_block_size Maximum number of values claimed at once (the size of the buffers of the workers)
+        /// \param min_block_size Minimum number of values claimed at once (unless there is less work left)
+        CWork_Scheduler(size_t max_block_size, size_t min_block_size);
+
+        /// Default destructor.
+        ~CWork_Scheduler() = default;
+
+        /// Registers a worker. The throughput of the worker is measured from this moment.
+        /// \param name Name of the device the worker uses (workers with the same name are reported together)
+        /// \return ID of the worker
+        [[nodiscard]] size_t Register_Worker(const std::string& name);
+
+        /// Returns how many values the worker should claim next.
+        /// \param worker_id ID of the worker (see Register_Worker)
+        /// \param remaining Number of values that have not been claimed yet
+        /// \return Number of values to be claimed
+        [[nodiscard]] size_t Get_Block_Size(size_t worker_id, size_t remaining);
+
+        /// Reports that a worker has processed a block of data.
+        /// \param worker_id ID of the worker (see Register_Worker)
+        /// \param count Number of values in the block
+        void Report(size_t worker_id, size_t count);
+
+        /// Returns whether any OpenCL device (a worker not named CPU_Name) has been registered.
+        /// \return true, if a device has been involved, false otherwise.
+        [[nodiscard]] bool Has_Devices() const;
+
+        /// Prints out how much of the work each device (and the CPU) has done.
+        /// \param out Output stream
+        /// \param scheduler Scheduler
+        /// \return Output stream
+        friend std::ostream& operator<<(std::ostream& out, const CWork_Scheduler& scheduler);
+
+    public:
+        /// Name the CPU workers are registered under.
+        static constexpr const char* CPU_Name = "CPU";
+
+    private:
+        /// Statistics of a worker.
+        struct TWorker
+        {
+            std::string name;                                ///< Name of the device the worker uses
+            std::chrono::steady_clock::time_point start;     ///< Time the worker registered
+            size_t count = 0;                                ///< Number of values processed by the worker
+            double throughput = 0.0;                         ///< Measured throughput (values per second, 0 = not measured yet)
+        };
+
+    private:
+        /// Each worker takes at most 1 / Guided_Divisor of its share of the remaining work at a time.
+        static constexpr double Guided_Divisor = 2.0;
+
+    private:
+        size_t m_max_block_size;        ///< Maximum number of values claimed at once
+        size_t m_min_block_size;        ///< Minimum number of values claimed at once
+        std::vector<TWorker> m_workers; ///< Registered workers
+        mutable std::mutex m_mtx;       ///< Mutex guarding the workers
+    };
+}
+
+// EOF
@@ -21,6 +21,27 @@ namespace kiv_ppr
             ("w,watchdog_period", "How often the watchdog checks if the program is working correctly [s]", cxxopts::value<uint32_t>()->default_value(std::to_string(config::processing::Watchdog_Sleep_Sec)))
             ("t,thread_count", "Number of threads created by the application", cxxopts::value<uint32_t>()->default_value(std::to_string(config::default_thread_params.number_of_threads)))
             ("g,gpu_only", "Do not use an OpenCL device which is not a GPU", cxxopts::value<bool>()->default_value("false"))
+            ("s,single_pass", "Read the input file only once (CPU only)", cxxopts::value<bool>()->default_value("false"))
+            ("r,reader", "Backend used to read the input file (stream | mmap | async | pread)", cxxopts::value<std::string>()->default_value(Stream_Reader_Type_Str))
+            ("q,queue_depth", "Maximum number of reads in flight (async reader)", cxxopts::value<uint32_t>()->default_value(std::to_string(config::TReader_Params{}.queue_depth)))
+            ("buffer_count", "Number of read buffers, 0 = queue depth + number of threads (async reader)", cxxopts::value<uint32_t>()->default_value(std::to_string(config::TReader_Params{}.buffer_count)))
+            ("m,memory_budget", "Maximum memory held by the read buffers [MB], 0 = unlimited", cxxopts::value<uint32_t>()->default_value("0"))
+            ("huge_pages", "Back the read buffers by huge pages (if available)", cxxopts::value<bool>()->default_value("false"))
+            ("reader_threads", "Number of dedicated reader threads feeding the workers, 0 = the workers read the file themselves", cxxopts::value<uint32_t>()->default_value(std::to_string(config::TReader_Params{}.reader_threads)))
+            ("pipeline_depth", "Maximum number of blocks read ahead by the reader threads", cxxopts::value<uint32_t>()->default_value(std::to_string(config::TReader_Params{}.pipeline_depth)))
+            ("queues_per_device", "Number of command queues (workers) per OpenCL device, 0 = detected by the compute units of the device", cxxopts::value<uint32_t>()->default_value("0"))
+            ("cpu_sub_devices", "Number of sub-devices a CPU OpenCL device is partitioned into, 0 = no partitioning", cxxopts::value<uint32_t>()->default_value("0"))
+            ("isa", "Instruction set of the CPU kernels (auto | scalar | sse42 | avx2 | avx512)", cxxopts::value<std::string>()->default_value(Auto_Instruction_Set_Str))
+            ("cl_cache", "Directory of the cache of compiled OpenCL programs (empty = disabled)", cxxopts::value<std::string>()->default_value(config::processing::OpenCL_Cache_Dir))
+            ("stats_cache", "Cache the statistics of the input file in a sidecar file (<filename>.pprstats) and reuse them in the next runs", cxxopts::value<bool>()->default_value("false"))
+            ("recompute", "Recalculate the statistics of the input file even if they are cached (the cache is updated)", cxxopts::value<bool>()->default_value("false"))
+            ("append", "Append mode - merge only the data appended to the input file since the last run into the state saved in the given file (CPU only)", cxxopts::value<std::string>()->default_value(""))
+            ("partial", "Partial mode - store the mergeable state of a part of the input file into the given file instead of running the tests (CPU only)", cxxopts::value<std::string>()->default_value(""))
+            ("shard", "Part of the input file processed in the partial mode given as <index>/<count> of equally large shards", cxxopts::value<std::string>()->default_value(""))
+            ("range", "Part of the input file processed in the partial mode given as <first byte>:<end byte> (the end is exclusive, empty = end of file)", cxxopts::value<std::string>()->default_value(""))
+            ("merge", "Merge mode - merge the given comma-separated partial states and run the tests (no input file is given)", cxxopts::value<std::vector<std::string>>())
+            ("test_kernels", "Check the CPU kernels of all supported instruction sets against the scalar ones and exit (no input file is given)", cxxopts::value<bool>()->default_value("false"))
+            ("benchmark_kernels", "Measure the throughput of the CPU kernels of all supported instruction sets and exit (no input file is given)", cxxopts::value<bool>()->default_value("false"))
             ("h,help", "Print out this help menu");
     }
 
@@ -45,6 +66,110 @@ namespace kiv_ppr
         return m_args["gpu_only"].as<bool>();
     }
 
+    bool CArg_Parser::Should_Use_Single_Pass()
+    {
+        return m_args["single_pass"].as<bool>();
+    }
+
+    config::NReader_Type CArg_Parser::Get_Reader_Type() noexcept
+    {
+        return m_reader_type;
+    }
+
+    config::NInstruction_Set CArg_Parser::Get_Instruction_Set() noexcept
+    {
+        return m_instruction_set;
+    }
+
+    uint32_t CArg_Parser::Get_Queue_Depth()
+    {
+        return m_args["queue_depth"].as<uint32_t>();
+    }
+
+    uint32_t CArg_Parser::Get_Buffer_Count()
+    {
+        return m_args["buffer_count"].as<uint32_t>();
+    }
+
+    size_t CArg_Parser::Get_Memory_Budget()
+    {
+        return static_cast<size_t>(m_args["memory_budget"].as<uint32_t>()) * 1024 * 1024;
+    }
+
+    bool CArg_Parser::Should_Use_Huge_Pages()
+    {
+        return m_args["huge_pages"].as<bool>();
+    }
+
+    uint32_t CArg_Parser::Get_Reader_Threads()
+    {
+        return m_args["reader_threads"].as<uint32_t>();
+    }
+
+    uint32_t CArg_Parser::Get_Pipeline_Depth()
+    {
+        return m_args["pipeline_depth"].as<uint32_t>();
+    }
+
+    uint32_t CArg_Parser::Get_Queues_Per_Device()
+    {
+        return m_args["queues_per_device"].as<uint32_t>();
+    }
+
+    uint32_t CArg_Parser::Get_CPU_Sub_Devices()
+    {
+        return m_args["cpu_sub_devices"].as<uint32_t>();
+    }
+
+    std::string CArg_Parser::Get_OpenCL_Cache_Dir()
+    {
+        return m_args["cl_cache"].as<std::string>();
+    }
+
+    bool CArg_Parser::Should_Use_Stats_Cache()
+    {
+        return m_args["stats_cache"].as<bool>();
+    }
+
+    bool CArg_Parser::Should_Recompute_Stats()
+    {
+        return m_args["recompute"].as<bool>();
+    }
+
+    bool CArg_Parser::Should_Test_Kernels()
+    {
+        return m_args["test_kernels"].as<bool>();
+    }
+
+    bool CArg_Parser::Should_Benchmark_Kernels()
+    {
+        return m_args["benchmark_kernels"].as<bool>();
+    }
+
+    std::string CArg_Parser::Get_Append_State_File()
+    {
+        return m_args["append"].as<std::string>();
+    }
+
+    std::string CArg_Parser::Get_Partial_State_File()
+    {
+        return m_args["partial"].as<std::string>();
+    }
+
+    const config::TPart_Params& CArg_Parser::Get_Part() const noexcept
+    {
+        return m_part;
+    }
+
+    std::vector<std::string> CArg_Parser::Get_Partial_States_To_Merge()
+    {
+        if (0 == m_args.count("merge"))
+        {
+            return {};
+        }
+        return m_args["merge"].as<std::vector<std::string>>();
+    }
+
     uint32_t CArg_Parser::Get_Block_Size_Per_Read()
     {
         // The program reads the input file as double.
@@ -83,6 +208,89 @@ namespace kiv_ppr
     }
 
     void CArg_Parser::Parse()
+    {
+        // In the merge mode, there is no input file and the tests are run on the CPU.
+        if (!Get_Partial_States_To_Merge().empty())
+        {
+            m_run_type = NRun_Type::SMP;
+        }
+        else
+        {
+            Parse_Run_Type();
+        }
+
+        // Part of the input file processed in the partial mode.
+        Parse_Part();
+
+        // Backend used to read the input file.
+        std::string reader_type = m_args["reader"].as<std::string>();
+        std::transform(reader_type.begin(), reader_type.end(), reader_type.begin(), [](unsigned char c) noexcept {
+            return std::tolower(c);
+        });
+
+        if (reader_type == Stream_Reader_Type_Str)
+        {
+            m_reader_type = config::NReader_Type::Stream;
+        }
+        else if (reader_type == Mmap_Reader_Type_Str)
+        {
+            m_reader_type = config::NReader_Type::Mmap;
+        }
+        else if (reader_type == Async_Reader_Type_Str)
+        {
+            m_reader_type = config::NReader_Type::Async;
+        }
+        else if (reader_type == Pread_Reader_Type_Str)
+        {
+            m_reader_type = config::NReader_Type::Pread;
+        }
+        else
+        {
+            throw std::invalid_argument{"Unknown reader type (" + reader_type + ")"};
+        }
+
+        // Instruction set of the CPU kernels.
+        std::string instruction_set = m_args["isa"].as<std::string>();
+        std::transform(instruction_set.begin(), instruction_set.end(), instruction_set.begin(), [](unsigned char c) noexcept {
+            return std::tolower(c);
+        });
+
+        if (instruction_set == Auto_Instruction_Set_Str)
+        {
+            m_instruction_set = config::NInstruction_Set::Auto;
+        }
+        else if (instruction_set == Scalar_Instruction_Set_Str)
+        {
+            m_instruction_set = config::NInstruction_Set::Scalar;
+        }
+        else if (instruction_set == SSE42_Instruction_Set_Str)
+        {
+            m_instruction_set = config::NInstruction_Set::SSE42;
+        }
+        else if (instruction_set == AVX2_Instruction_Set_Str)
+        {
+            m_instruction_set = config::NInstruction_Set::AVX2;
+        }
+        else if (instruction_set == AVX512_Instruction_Set_Str)
+        {
+            m_instruction_set = config::NInstruction_Set::AVX512;
+        }
+        else
+        {
+            throw std::invalid_argument{"Unknown instruction set (" + instruction_set + ")"};
+        }
+
+        if (0 == Get_Queue_Depth())
+        {
+            throw std::invalid_argument{"The queue depth must be a positive number"};
+        }
+        if (0 == Get_Pipeline_Depth())
+        {
+            throw std::invalid_argument{"The pipeline depth must be a positive number"};
+        }
+    }
+
+    void CArg_Parser::Parse_Run_Type()
     {
         // Name of the program, input file, and mode.
         if (m_argc < 3)
@@ -136,6 +344,85 @@ namespace kiv_ppr
         }
     }
 
+    void CArg_Parser::Parse_Part()
+    {
+        // Shard of the input file (<index>/<count>).
+        const std::string shard = m_args["shard"].as<std::string>();
+        if (!shard.empty())
+        {
+            const size_t separator = shard.find('/');
+            if (std::string::npos == separator || !Parse_Number(shard.substr(0, separator), m_part.shard_index) ||
+                !Parse_Number(shard.substr(separator + 1), m_part.shard_count) || 0 == m_part.shard_count || m_part.shard_index >= m_part.shard_count)
+            {
+                throw std::invalid_argument{"Invalid shard (" + shard + "), it must be given as <index>/<count> where index < count"};
+            }
+        }
+
+        // Range of bytes of the input file (<first byte>:<end byte>).
+        const std::string range = m_args["range"].as<std::string>();
+        if (!range.empty())
+        {
+            const size_t separator = range.find(':');
+            const std::string end_byte = std::string::npos == separator ? "" : range.substr(separator + 1);
+            if (std::string::npos == separator || !Parse_Number(range.substr(0, separator), m_part.first_byte) ||
+                (!end_byte.empty() && !Parse_Number(end_byte, m_part.end_byte)) || m_part.first_byte > m_part.end_byte)
+            {
+                throw std::invalid_argument{"Invalid range (" + range + "), it must be given as <first byte>:<end byte> where first byte <= end byte"};
+            }
+        }
+
+        // The part only makes sense in the partial mode.
+        if ((!shard.empty() || !range.empty()) && Get_Partial_State_File().empty())
+        {
+            throw std::invalid_argument{"A shard or a range can only be given in the partial mode (--partial)"};
+        }
+    }
+
+    const char* CArg_Parser::Get_Reader_Type_Str(config::NReader_Type reader_type) noexcept
+    {
+        switch (reader_type)
+        {
+            case config::NReader_Type::Stream:
+                return Stream_Reader_Type_Str;
+
+            case config::NReader_Type::Mmap:
+                return Mmap_Reader_Type_Str;
+
+            case config::NReader_Type::Async:
+                return Async_Reader_Type_Str;
+
+            case config::NReader_Type::Pread:
+                return Pread_Reader_Type_Str;
+
+            default:
+                return "Unknown";
+        }
+    }
+
+    const char* CArg_Parser::Get_Instruction_Set_Str(config::NInstruction_Set instruction_set) noexcept
+    {
+        switch (instruction_set)
+        {
+            case config::NInstruction_Set::Auto:
+                return Auto_Instruction_Set_Str;
+
+            case config::NInstruction_Set::Scalar:
+                return Scalar_Instruction_Set_Str;
+
+            case config::NInstruction_Set::SSE42:
+                return SSE42_Instruction_Set_Str;
+
+            case config::NInstruction_Set::AVX2:
+                return AVX2_Instruction_Set_Str;
+
+            case config::NInstruction_Set::AVX512:
+                return AVX512_Instruction_Set_Str;
+
+            default:
+                return "Unknown";
+        }
+    }
+
     const char* CArg_Parser::Get_Run_Type_Str() noexcept
     {
         switch (m_run_type)
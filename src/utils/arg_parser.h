@@ -3,9 +3,11 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <charconv>
 #include <unordered_set>
 
 #include "../cxxopts/cxxopts.h"
+#include "../config.h"
 
 namespace kiv_ppr
 {
@@ -57,6 +59,86 @@ namespace kiv_ppr
         /// \return true, if the user wishes to use only OpenCL devices, false otherwise.
         [[nodiscard]] bool Should_Use_GPUs_Only();
 
+        /// Returns whether or not the input file should be read only once (single pass).
+        /// \return true, if the user wishes to use the single pass mode, false otherwise.
+        [[nodiscard]] bool Should_Use_Single_Pass();
+
+        /// Returns the backend used to read the input file (stream, mmap, ...).
+        /// \return Backend used to read the input file.
+        [[nodiscard]] config::NReader_Type Get_Reader_Type() noexcept;
+
+        /// Returns the instruction set of the CPU kernels (auto, scalar, sse42, ...).
+        /// \return Instruction set of the CPU kernels.
+        [[nodiscard]] config::NInstruction_Set Get_Instruction_Set() noexcept;
+
+        /// Returns the maximum number of reads in flight (async reader).
+        /// \return Queue depth of the asynchronous reader.
+        [[nodiscard]] uint32_t Get_Queue_Depth();
+
+        /// Returns the number of read buffers (async reader).
+        /// \return Number of read buffers (0 = queue depth + number of threads).
+        [[nodiscard]] uint32_t Get_Buffer_Count();
+
+        /// Returns the maximum memory held by the read buffers.
+        /// \return Memory budget in bytes (0 = unlimited).
+        [[nodiscard]] size_t Get_Memory_Budget();
+
+        /// Returns whether or not the read buffers should be backed by huge pages.
+        /// \return true, if the user wishes to use huge pages, false otherwise.
+        [[nodiscard]] bool Should_Use_Huge_Pages();
+
+        /// Returns the number of dedicated reader threads.
+        /// \return Number of reader threads (0 = the workers read the file themselves).
+        [[nodiscard]] uint32_t Get_Reader_Threads();
+
+        /// Returns the maximum number of blocks read ahead by the reader threads.
+        /// \return Capacity of the queue between the reader threads and the workers.
+        [[nodiscard]] uint32_t Get_Pipeline_Depth();
+
+        /// Returns the number of command queues (workers) per OpenCL device.
+        /// \return Number of queues per device (0 = detected by the compute units of the device).
+        [[nodiscard]] uint32_t Get_Queues_Per_Device();
+
+        /// Returns the number of sub-devices a CPU OpenCL device is partitioned into.
+        /// \return Number of sub-devices (0 = no partitioning).
+        [[nodiscard]] uint32_t Get_CPU_Sub_Devices();
+
+        /// Returns the directory of the cache of compiled OpenCL programs.
+        /// \return Path to the directory (empty = the cache is disabled).
+        [[nodiscard]] std::string Get_OpenCL_Cache_Dir();
+
+        /// Returns whether the statistics of the input file should be cached in a sidecar file.
+        /// \return true, if the cache should be used, false otherwise.
+        [[nodiscard]] bool Should_Use_Stats_Cache();
+
+        /// Returns whether the statistics of the input file should be recalculated even if they are cached.
+        /// \return true, if the statistics should be recalculated, false otherwise.
+        [[nodiscard]] bool Should_Recompute_Stats();
+
+        /// Returns whether the CPU kernels should be checked against the scalar ones (see CCPU_Kernels::Test).
+        /// \return true, if the kernels should be tested instead of processing an input file, false otherwise.
+        [[nodiscard]] bool Should_Test_Kernels();
+
+        /// Returns whether the throughput of the CPU kernels should be measured (see CCPU_Kernels::Benchmark).
+        /// \return true, if the kernels should be benchmarked instead of processing an input file, false otherwise.
+        [[nodiscard]] bool Should_Benchmark_Kernels();
+
+        /// Returns the path to the file holding the state of the append mode.
+        /// \return Path to the state file (empty = the append mode is not used).
+        [[nodiscard]] std::string Get_Append_State_File();
+
+        /// Returns the path to the file the partial state of a part of the input file is stored into.
+        /// \return Path to the partial state file (empty = the partial mode is not used).
+        [[nodiscard]] std::string Get_Partial_State_File();
+
+        /// Returns the part of the input file processed in the partial mode (shard, range).
+        /// \return Part of the input file (the whole file by default).
+        [[nodiscard]] const config::TPart_Params& Get_Part() const noexcept;
+
+        /// Returns the paths to the partial states merged in the merge mode.
+        /// \return Paths to the partial state files (empty = the merge mode is not used).
+        [[nodiscard]] std::vector<std::string> Get_Partial_States_To_Merge();
+
         /// Returns the size of a data block read from the input file.
         /// \return Size of a data block.
         [[nodiscard]] uint32_t Get_Block_Size_Per_Read();
@@ -81,20 +163,61 @@ namespace kiv_ppr
         /// \return Text representation of the mode.
         [[nodiscard]] const char* Get_Run_Type_Str() noexcept;
 
+        /// Returns a text representation of a backend used to read the input file (stream, mmap, ...)
+        /// \param reader_type Backend used to read the input file
+        /// \return Text representation of the backend.
+        [[nodiscard]] static const char* Get_Reader_Type_Str(config::NReader_Type reader_type) noexcept;
+
+        /// Returns the text representation of an instruction set of the CPU kernels.
+        /// \param instruction_set Instruction set
+        /// \return Text representation of the instruction set.
+        [[nodiscard]] static const char* Get_Instruction_Set_Str(config::NInstruction_Set instruction_set) noexcept;
+
         /// Returns the mode of the program (all, smp, ...)
         /// \return Mode of the program.
         [[nodiscard]] NRun_Type Get_Run_Type() noexcept;
 
+    private:
+        /// Parses the input file and the mode in which the program should be executed.
+        void Parse_Run_Type();
+
+        /// Parses the part of the input file processed in the partial mode (--shard, --range).
+        void Parse_Part();
+
+        /// Parses a non-negative integer (the whole text has to be a number).
+        /// \tparam T Type of the number
+        /// \param text Text to be parsed
+        /// \param value Parsed number
+        /// \return true, if the text is a valid number, false otherwise.
+        template<typename T>
+        [[nodiscard]] static bool Parse_Number(const std::string& text, T& value) noexcept
+        {
+            const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+            return std::errc{} == error && text.data() + text.size() == end;
+        }
+
     private:
         static constexpr const char* All_Run_Type_Str = "all"; ///< Text presentation of the 'all' mode
         static constexpr const char* SMP_Run_Type_Str = "smp"; ///< Text presentation of the 'smp' mode
+        static constexpr const char* Stream_Reader_Type_Str = "stream"; ///< Text presentation of the 'stream' reader
+        static constexpr const char* Mmap_Reader_Type_Str = "mmap";     ///< Text presentation of the 'mmap' reader
+        static constexpr const char* Async_Reader_Type_Str = "async";   ///< Text presentation of the 'async' reader
+        static constexpr const char* Pread_Reader_Type_Str = "pread";   ///< Text presentation of the 'pread' reader
+        static constexpr const char* Auto_Instruction_Set_Str = "auto";     ///< Text presentation of the best supported instruction set
+        static constexpr const char* Scalar_Instruction_Set_Str = "scalar"; ///< Text presentation of the scalar kernels
+        static constexpr const char* SSE42_Instruction_Set_Str = "sse42";   ///< Text presentation of the SSE4.2 kernels
+        static constexpr const char* AVX2_Instruction_Set_Str = "avx2";     ///< Text presentation of the AVX2 kernels
+        static constexpr const char* AVX512_Instruction_Set_Str = "avx512"; ///< Text presentation of the AVX-512 kernels
 
     private:
         int m_argc;                                    ///< Total number of input arguments
         char** m_argv;                                 ///< Input arguments
         const char* m_filename = nullptr;              ///< Path to the input file
         NRun_Type m_run_type{};                        ///< Mode of the program (smp, all, ...)
+        config::NReader_Type m_reader_type{};          ///< Backend used to read the input file
+        config::NInstruction_Set m_instruction_set{};  ///< Instruction set of the CPU kernels
         std::unordered_set<std::string> m_opencl_devs; ///< OpenCL devices the user wishes to use
+        config::TPart_Params m_part{};                 ///< Part of the input file processed in the partial mode
         cxxopts::Options m_options;                    ///< Options of the program (-p, -w, ...)
         cxxopts::ParseResult m_args;                   ///< Argument parser
         std::vector<std::string> m_cmd_args;           ///< List of command line arguments
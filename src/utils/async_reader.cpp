@@ -0,0 +1,375 @@
+#include <algorithm>
+
+#include "async_reader.h"
+
+namespace kiv_ppr
+{
+    CAsync_Reader::CAsync_Reader(const std::string& filename, uint32_t queue_depth, uint32_t buffer_count)
+        : m_file(filename),
+          m_engine(NEngine::Pread_Threads),
+          m_queue_depth(std::max<uint32_t>(queue_depth, 1)),
+          m_buffer_count(std::max<uint32_t>(buffer_count, 1)),
+          m_block_size(0),
+          m_end_offset(0),
+          m_number_of_blocks(0),
+          m_delivered_blocks(0),
+          m_next_offset(0),
+          m_stop(false),
+          m_error(false),
+          m_bytes_read(0),
+          m_total_bytes_read(0),
+          m_total_seconds(0)
+#ifdef KIV_PPR_IO_URING
+          , m_ring{},
+          m_buffers_registered(false)
+#endif
+    {
+#ifdef KIV_PPR_IO_URING
+        // If io_uring cannot be set up (e.g. it is disabled by the kernel), the thread pool is used instead.
+        if (Is_Open() && 0 == io_uring_queue_init(m_queue_depth, &m_ring, 0))
+        {
+            m_engine = NEngine::IO_Uring;
+        }
+#endif
+    }
+
+    CAsync_Reader::~CAsync_Reader()
+    {
+        Stop();
+#ifdef KIV_PPR_IO_URING
+        if (NEngine::IO_Uring == m_engine)
+        {
+            io_uring_queue_exit(&m_ring);
+        }
+#endif
+    }
+
+    bool CAsync_Reader::Is_Open() const noexcept
+    {
+        return m_file.Is_Regular_File();
+    }
+
+    void CAsync_Reader::Start(size_t total_size, size_t block_size, size_t start_offset)
+    {
+        Stop();
+        Allocate_Buffers(block_size);
+
+        // All the buffers are free at the beginning of a pass.
+        m_free_buffers.clear();
+        for (size_t i = m_buffer_count; i > 0; --i)
+        {
+            m_free_buffers.push_back(i - 1);
+        }
+        m_completed.clear();
+        m_end_offset = start_offset + total_size;
+        m_number_of_blocks = (total_size + block_size - 1) / block_size;
+        m_delivered_blocks = 0;
+        m_next_offset = start_offset;
+        m_stop = false;
+        m_error = false;
+        m_bytes_read = 0;
+        m_start_time = std::chrono::steady_clock::now();
+        m_end_time = m_start_time;
+
+#ifdef KIV_PPR_IO_URING
+        if (NEngine::IO_Uring == m_engine)
+        {
+            // One thread keeps the submission queue full.
+            m_threads.emplace_back(&CAsync_Reader::Run_IO_Uring, this);
+            return;
+        }
+#endif
+        // One blocking read in flight per thread.
+        for (uint32_t i = 0; i < m_queue_depth; ++i)
+        {
+            m_threads.emplace_back(&CAsync_Reader::Run_Pread_Worker, this);
+        }
+    }
+
+    void CAsync_Reader::Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_stop = true;
+        }
+        m_free_cv.notify_all();
+
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+        if (!m_threads.empty())
+        {
+            // Remember the statistics of the pass.
+            m_total_bytes_read += m_bytes_read;
+            m_total_seconds += std::chrono::duration<double>(m_end_time - m_start_time).count();
+            m_bytes_read = 0;
+            m_start_time = m_end_time;
+        }
+        m_threads.clear();
+    }
+
+    CAsync_Reader::TBlock CAsync_Reader::Pop()
+    {
+        std::unique_lock<std::mutex> lock(m_mtx);
+        m_completed_cv.wait(lock, [&]() {
+            return m_error || !m_completed.empty() || m_delivered_blocks == m_number_of_blocks;
+        });
+
+        if (m_error)
+        {
+            return { NStatus::Error, 0, nullptr, 0 };
+        }
+        if (m_completed.empty())
+        {
+            return { NStatus::EOF_, 0, nullptr, 0 };
+        }
+
+        const auto block = m_completed.front();
+        m_completed.pop_front();
+        ++m_delivered_blocks;
+
+        // Wake up the other workers, so they can see the end of the file.
+        if (m_delivered_blocks == m_number_of_blocks)
+        {
+            m_completed_cv.notify_all();
+        }
+        return block;
+    }
+
+    void CAsync_Reader::Release(size_t buffer_index)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_free_buffers.push_back(buffer_index);
+        }
+        m_free_cv.notify_one();
+    }
+
+    CAsync_Reader::NEngine CAsync_Reader::Get_Engine() const noexcept
+    {
+        return m_engine;
+    }
+
+    const char* CAsync_Reader::Get_Engine_Str() const noexcept
+    {
+        return NEngine::IO_Uring == m_engine ? "io_uring" : "pread thread pool";
+    }
+
+    double CAsync_Reader::Get_Throughput() const
+    {
+        const double seconds = m_total_seconds + std::chrono::duration<double>(m_end_time - m_start_time).count();
+        if (seconds <= 0)
+        {
+            return 0;
+        }
+        return static_cast<double>(m_total_bytes_read + m_bytes_read) / seconds / 1e9;
+    }
+
+    void CAsync_Reader::Allocate_Buffers(size_t block_size)
+    {
+        if (block_size == m_block_size && !m_buffers.empty())
+        {
+            return;
+        }
+
+#ifdef KIV_PPR_IO_URING
+        if (m_buffers_registered)
+        {
+            io_uring_unregister_buffers(&m_ring);
+            m_buffers_registered = false;
+        }
+#endif
+        m_block_size = block_size;
+        m_buffers.clear();
+        m_requests.assign(m_buffer_count, {});
+        for (uint32_t i = 0; i < m_buffer_count; ++i)
+        {
+            m_buffers.emplace_back(static_cast<char*>(::operator new[](block_size, std::align_val_t{Buffer_Alignment})));
+        }
+
+#ifdef KIV_PPR_IO_URING
+        if (NEngine::IO_Uring == m_engine)
+        {
+            // Registered buffers save the kernel from mapping them on every read.
+            // If the registration fails (e.g. RLIMIT_MEMLOCK), regular reads are used.
+            std::vector<iovec> iovecs(m_buffer_count);
+            for (uint32_t i = 0; i < m_buffer_count; ++i)
+            {
+                iovecs[i].iov_base = m_buffers[i].get();
+                iovecs[i].iov_len = block_size;
+            }
+            m_buffers_registered = 0 == io_uring_register_buffers(&m_ring, iovecs.data(), m_buffer_count);
+        }
+#endif
+    }
+
+    void CAsync_Reader::Complete(size_t buffer_index, size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_completed.push_back({ NStatus::OK, size, m_buffers[buffer_index].get(), buffer_index });
+            m_bytes_read += size;
+            m_end_time = std::chrono::steady_clock::now();
+        }
+        m_completed_cv.notify_one();
+    }
+
+    void CAsync_Reader::Fail()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_error = true;
+        }
+        m_completed_cv.notify_all();
+    }
+
+    void CAsync_Reader::Run_Pread_Worker()
+    {
+        while (true)
+        {
+            size_t buffer_index;
+            {
+                std::unique_lock<std::mutex> lock(m_mtx);
+                m_free_cv.wait(lock, [&]() {
+                    return m_stop || m_error || !m_free_buffers.empty();
+                });
+                if (m_stop || m_error)
+                {
+                    return;
+                }
+                buffer_index = m_free_buffers.back();
+                m_free_buffers.pop_back();
+            }
+
+            // Claim the next block of the file.
+            const uint64_t offset = m_next_offset.fetch_add(m_block_size);
+            if (offset >= m_end_offset)
+            {
+                Release(buffer_index);
+                return;
+            }
+            const size_t size = std::min<size_t>(m_block_size, m_end_offset - offset);
+
+            if (m_file.Read(m_buffers[buffer_index].get(), size, offset) != static_cast<int64_t>(size))
+            {
+                Fail();
+                return;
+            }
+            Complete(buffer_index, size);
+        }
+    }
+
+#ifdef KIV_PPR_IO_URING
+    void CAsync_Reader::Run_IO_Uring()
+    {
+        uint32_t in_flight = 0;
+        bool failed = false;
+
+        while (true)
+        {
+            // Fill up the submission queue with reads of the following blocks.
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                while (!m_stop && !failed && in_flight < m_queue_depth && !m_free_buffers.empty() && m_next_offset < m_end_offset)
+                {
+                    const size_t buffer_index = m_free_buffers.back();
+                    const uint64_t offset = m_next_offset.fetch_add(m_block_size);
+                    m_requests[buffer_index] = { offset, std::min<size_t>(m_block_size, m_end_offset - offset), 0 };
+                    if (!Submit_Read(buffer_index))
+                    {
+                        m_next_offset -= m_block_size;
+                        break;
+                    }
+                    m_free_buffers.pop_back();
+                    ++in_flight;
+                }
+            }
+            io_uring_submit(&m_ring);
+
+            if (0 == in_flight)
+            {
+                std::unique_lock<std::mutex> lock(m_mtx);
+                if (m_stop || failed || m_next_offset >= m_end_offset)
+                {
+                    return;
+                }
+
+                // All the buffers are being processed by the workers.
+                m_free_cv.wait(lock, [&]() {
+                    return m_stop || !m_free_buffers.empty();
+                });
+                continue;
+            }
+
+            // Reap a completion (the remaining reads are drained even when stopping).
+            io_uring_cqe* cqe = nullptr;
+            if (io_uring_wait_cqe(&m_ring, &cqe) < 0)
+            {
+                continue;
+            }
+            const auto buffer_index = static_cast<size_t>(cqe->user_data);
+            const int result = cqe->res;
+            io_uring_cqe_seen(&m_ring, cqe);
+            --in_flight;
+
+            if (failed)
+            {
+                continue;
+            }
+            if (result <= 0)
+            {
+                // A read error or an unexpected end of the file.
+                failed = true;
+                Fail();
+                continue;
+            }
+
+            auto& request = m_requests[buffer_index];
+            request.done += static_cast<size_t>(result);
+            if (request.done < request.size)
+            {
+                // Short read - read the rest of the block.
+                if (Submit_Read(buffer_index))
+                {
+                    ++in_flight;
+                }
+                else
+                {
+                    failed = true;
+                    Fail();
+                }
+                continue;
+            }
+            Complete(buffer_index, request.size);
+        }
+    }
+
+    bool CAsync_Reader::Submit_Read(size_t buffer_index)
+    {
+        io_uring_sqe* sqe = io_uring_get_sqe(&m_ring);
+        if (nullptr == sqe)
+        {
+            return false;
+        }
+
+        const auto& request = m_requests[buffer_index];
+        char* buffer = m_buffers[buffer_index].get() + request.done;
+        const auto size = static_cast<unsigned>(request.size - request.done);
+        const auto offset = request.offset + request.done;
+
+        if (m_buffers_registered)
+        {
+            io_uring_prep_read_fixed(sqe, m_file.Get_Descriptor(), buffer, size, offset, static_cast<int>(buffer_index));
+        }
+        else
+        {
+            io_uring_prep_read(sqe, m_file.Get_Descriptor(), buffer, size, offset);
+        }
+        sqe->user_data = buffer_index;
+        return true;
+    }
+#endif
+}
+
+// EOF
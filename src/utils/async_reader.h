@@ -0,0 +1,189 @@
+#pragma once
+
+#include <new>
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <condition_variable>
+
+#if defined(__linux__) && __has_include(<liburing.h>)
+    // io_uring is available (link with -luring).
+    #define KIV_PPR_IO_URING
+    #include <liburing.h>
+#endif
+
+#include "positional_file.h"
+
+namespace kiv_ppr
+{
+    /// \author Jakub Silhavy
+    ///
+    /// This class reads a file asynchronously with many reads in flight, so that fast
+    /// drives (NVMe) get the queue depth they need. The data is read into a ring of
+    /// reusable buffers. Completed blocks are put into a completion queue, from which
+    /// the worker threads take them. Once a worker is done with a block, it returns the buffer
+    /// back to the ring. On Linux, io_uring is used (with the buffers registered, if possible).
+    /// If io_uring is not available, a pool of threads issuing positional reads (pread) is used instead.
+    class CAsync_Reader
+    {
+    public:
+        /// Engine used to issue the reads.
+        enum class NEngine : uint8_t
+        {
+            IO_Uring,     ///< Linux io_uring
+            Pread_Threads ///< Pool of threads issuing positional reads
+        };
+
+        /// Status of a block taken from the completion queue.
+        enum class NStatus : uint8_t
+        {
+            OK,   ///< All good
+            Error,///< An error has ocurred
+            EOF_  ///< All blocks have been handed out
+        };
+
+        /// Block of data that has been read from the file.
+        struct TBlock
+        {
+            NStatus status;      ///< Status of the block
+            size_t size;         ///< Number of bytes read
+            char* data;          ///< Buffer holding the data
+            size_t buffer_index; ///< Index of the buffer (used to return it back to the ring)
+        };
+
+    public:
+        /// Creates an instance of the class.
+        /// \param filename Path to the file
+        /// \param queue_depth Maximum number of reads in flight
+        /// \param buffer_count Number of buffers in the ring
+        CAsync_Reader(const std::string& filename, uint32_t queue_depth, uint32_t buffer_count);
+
+        /// Stops reading the file and releases the resources.
+        ~CAsync_Reader();
+
+        /// Delete copy constructor.
+        CAsync_Reader(const CAsync_Reader&) = delete;
+
+        /// Delete assignment operator.
+        CAsync_Reader& operator=(const CAsync_Reader&) = delete;
+
+        /// Returns whether the file can be read asynchronously (it is an open regular file).
+        /// \return true, if the file can be read, false otherwise.
+        [[nodiscard]] bool Is_Open() const noexcept;
+
+        /// Starts reading the file from an offset. All blocks taken
+        /// in the previous pass must have been released.
+        /// \param total_size Number of bytes to be read
+        /// \param block_size Size of one block in bytes
+        /// \param start_offset Offset of the first byte to be read
+        void Start(size_t total_size, size_t block_size, size_t start_offset = 0);
+
+        /// Stops reading the file (waits for the reads in flight to finish).
+        void Stop();
+
+        /// Takes a completed block from the completion queue. If there is none, it waits for one.
+        /// \return Completed block (or EOF_ once all blocks have been handed out).
+        [[nodiscard]] TBlock Pop();
+
+        /// Returns a buffer back to the ring, so it can be used for another read.
+        /// \param buffer_index Index of the buffer
+        void Release(size_t buffer_index);
+
+        /// Returns the engine used to issue the reads.
+        /// \return Engine used to issue the reads.
+        [[nodiscard]] NEngine Get_Engine() const noexcept;
+
+        /// Returns a text representation of the engine used to issue the reads.
+        /// \return Text representation of the engine.
+        [[nodiscard]] const char* Get_Engine_Str() const noexcept;
+
+        /// Returns the achieved read throughput (over all passes).
+        /// \return Read throughput [GB/s]
+        [[nodiscard]] double Get_Throughput() const;
+
+    private:
+        /// Aligned deleter of the buffers.
+        struct TAligned_Delete
+        {
+            void operator()(char* buffer) const noexcept
+            {
+                ::operator delete[](buffer, std::align_val_t{Buffer_Alignment});
+            }
+        };
+
+        /// Read of one block that is in flight.
+        struct TRequest
+        {
+            uint64_t offset; ///< Offset within the file
+            size_t size;     ///< Number of bytes to be read
+            size_t done;     ///< Number of bytes read so far
+        };
+
+    private:
+        /// Allocates the buffers (if the block size has changed).
+        /// \param block_size Size of one block in bytes
+        void Allocate_Buffers(size_t block_size);
+
+        /// Puts a completed block into the completion queue.
+        /// \param buffer_index Index of the buffer holding the data
+        /// \param size Number of bytes read
+        void Complete(size_t buffer_index, size_t size);
+
+        /// Marks the pass as failed and wakes up all waiting threads.
+        void Fail();
+
+        /// Run function of a thread issuing positional reads (fallback engine).
+        void Run_Pread_Worker();
+
+#ifdef KIV_PPR_IO_URING
+        /// Run function of the thread submitting reads into io_uring and reaping their completions.
+        void Run_IO_Uring();
+
+        /// Submits a read of (the rest of) a block into io_uring.
+        /// \param buffer_index Index of the buffer (and the request)
+        /// \return true, if the read has been submitted, false otherwise.
+        bool Submit_Read(size_t buffer_index);
+#endif
+
+    private:
+        static constexpr size_t Buffer_Alignment = 4096; ///< Alignment of the buffers (page size)
+
+    private:
+        CPositional_File m_file;                                   ///< File being read
+        NEngine m_engine;                                          ///< Engine used to issue the reads
+        uint32_t m_queue_depth;                                    ///< Maximum number of reads in flight
+        uint32_t m_buffer_count;                                   ///< Number of buffers in the ring
+        size_t m_block_size;                                       ///< Size of one block in bytes
+        size_t m_end_offset;                                       ///< Offset past the last byte to be read in the current pass
+        size_t m_number_of_blocks;                                 ///< Number of blocks in the current pass
+        size_t m_delivered_blocks;                                 ///< Number of blocks handed out in the current pass
+        std::atomic<uint64_t> m_next_offset;                       ///< Offset of the next block to be read
+        std::vector<std::unique_ptr<char[], TAligned_Delete>> m_buffers; ///< Ring of buffers
+        std::vector<TRequest> m_requests;                          ///< Reads in flight (one per buffer)
+        std::vector<size_t> m_free_buffers;                        ///< Indexes of the buffers that are not being used
+        std::deque<TBlock> m_completed;                            ///< Completion queue
+        std::mutex m_mtx;                                          ///< Mutex guarding the ring and the completion queue
+        std::condition_variable m_free_cv;                         ///< Signaled when a buffer is returned
+        std::condition_variable m_completed_cv;                    ///< Signaled when a block is completed
+        bool m_stop;                                               ///< Flag indicating that the reading should stop
+        bool m_error;                                              ///< Flag indicating that a read has failed
+        std::vector<std::thread> m_threads;                        ///< Threads issuing the reads
+        std::chrono::steady_clock::time_point m_start_time;        ///< Beginning of the current pass
+        std::chrono::steady_clock::time_point m_end_time;          ///< Time of the last completed read
+        uint64_t m_bytes_read;                                     ///< Number of bytes read in the current pass
+        uint64_t m_total_bytes_read;                               ///< Number of bytes read in the previous passes
+        double m_total_seconds;                                    ///< Duration of the previous passes
+#ifdef KIV_PPR_IO_URING
+        io_uring m_ring;                                           ///< io_uring instance
+        bool m_buffers_registered;                                 ///< Flag indicating whether the buffers are registered
+#endif
+    };
+}
+
+// EOF
@@ -0,0 +1,158 @@
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+#endif
+
+#include <new>
+#include <limits>
+#include <algorithm>
+
+#include "block_pool.h"
+
+namespace kiv_ppr
+{
+    CBlock_Pool::CBlock_Pool(size_t buffer_size, size_t memory_budget, bool huge_pages)
+        : m_buffer_size(std::max<size_t>(buffer_size, 1)),
+          m_allocation_size(m_buffer_size),
+          m_max_buffers(std::numeric_limits<size_t>::max()),
+          m_huge_pages(huge_pages),
+          m_number_of_buffers(0)
+    {
+        if (m_huge_pages)
+        {
+#ifdef _WIN32
+            const size_t huge_page_size = GetLargePageMinimum();
+#else
+            constexpr size_t huge_page_size = 2 * 1024 * 1024;
+#endif
+            // Huge pages are not supported.
+            if (0 == huge_page_size)
+            {
+                m_huge_pages = false;
+            }
+            else
+            {
+                m_allocation_size = (m_buffer_size + huge_page_size - 1) / huge_page_size * huge_page_size;
+            }
+        }
+
+        if (0 != memory_budget)
+        {
+            m_max_buffers = std::max<size_t>(memory_budget / m_allocation_size, 1);
+        }
+    }
+
+    CBlock_Pool::~CBlock_Pool()
+    {
+        // All borrowed buffers keep the pool alive, so they have all been returned by now.
+        for (char* buffer : m_free)
+        {
+            Free(buffer);
+        }
+    }
+
+    std::shared_ptr<char[]> CBlock_Pool::Acquire()
+    {
+        char* buffer = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_mtx);
+
+            // Wait until there is a free buffer or another one can be allocated.
+            m_cv.wait(lock, [&]() {
+                return !m_free.empty() || m_number_of_buffers < m_max_buffers;
+            });
+
+            if (!m_free.empty())
+            {
+                buffer = m_free.back();
+                m_free.pop_back();
+            }
+            else
+            {
+                ++m_number_of_buffers;
+            }
+        }
+
+        // Allocate a new buffer outside the lock (page faults are expensive).
+        if (nullptr == buffer)
+        {
+            buffer = Allocate();
+            if (nullptr == buffer)
+            {
+                const std::lock_guard<std::mutex> lock(m_mtx);
+                --m_number_of_buffers;
+                m_cv.notify_one();
+                return nullptr;
+            }
+        }
+
+        // The buffer keeps the pool alive and goes back to it once it is released.
+        return std::shared_ptr<char[]>(buffer, [pool = shared_from_this()](char* buffer) {
+            pool->Release(buffer);
+        });
+    }
+
+    size_t CBlock_Pool::Get_Buffer_Size() const noexcept
+    {
+        return m_buffer_size;
+    }
+
+    char* CBlock_Pool::Allocate() noexcept
+    {
+        if (!m_huge_pages)
+        {
+            return static_cast<char*>(::operator new[](m_allocation_size, std::align_val_t{Alignment}, std::nothrow));
+        }
+#ifdef _WIN32
+        // Large pages require the SeLockMemoryPrivilege, so fall back to regular pages if it is missing.
+        void* buffer = VirtualAlloc(nullptr, m_allocation_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (nullptr == buffer)
+        {
+            buffer = VirtualAlloc(nullptr, m_allocation_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        }
+        return static_cast<char*>(buffer);
+#else
+        // Explicit huge pages have to be reserved by the administrator,
+        // so fall back to transparent huge pages if there are none.
+        void* buffer = mmap(nullptr, m_allocation_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (MAP_FAILED == buffer)
+        {
+            buffer = mmap(nullptr, m_allocation_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (MAP_FAILED == buffer)
+            {
+                return nullptr;
+            }
+            madvise(buffer, m_allocation_size, MADV_HUGEPAGE);
+        }
+        return static_cast<char*>(buffer);
+#endif
+    }
+
+    void CBlock_Pool::Free(char* buffer) noexcept
+    {
+        if (!m_huge_pages)
+        {
+            ::operator delete[](buffer, std::align_val_t{Alignment});
+            return;
+        }
+#ifdef _WIN32
+        VirtualFree(buffer, 0, MEM_RELEASE);
+#else
+        munmap(buffer, m_allocation_size);
+#endif
+    }
+
+    void CBlock_Pool::Release(char* buffer)
+    {
+        {
+            const std::lock_guard<std::mutex> lock(m_mtx);
+            m_free.push_back(buffer);
+        }
+        m_cv.notify_one();
+    }
+}
+
+// EOF
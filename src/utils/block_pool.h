@@ -0,0 +1,74 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <condition_variable>
+
+namespace kiv_ppr
+{
+    /// \author Jakub Silhavy
+    ///
+    /// This class represents a bounded pool of equally sized buffers the data blocks
+    /// are read into. Instead of allocating (and page-faulting) a new buffer on every read,
+    /// a buffer is borrowed from the pool and it is returned automatically once the last
+    /// reference to it is gone. Buffers are allocated lazily, but never more than the memory
+    /// budget allows. If all of them are in use, Acquire waits until one is returned (back-pressure).
+    /// The buffers are aligned to a cache line (64 B), so they can be loaded using aligned SIMD instructions.
+    class CBlock_Pool : public std::enable_shared_from_this<CBlock_Pool>
+    {
+    public:
+        /// Creates an instance of the class.
+        /// \param buffer_size Size of one buffer in bytes
+        /// \param memory_budget Maximum memory held by the pool in bytes (0 = unlimited, at least one buffer is always allowed)
+        /// \param huge_pages Try to back the buffers by huge pages (falls back to regular pages)
+        CBlock_Pool(size_t buffer_size, size_t memory_budget, bool huge_pages);
+
+        /// Releases all the buffers.
+        ~CBlock_Pool();
+
+        /// Delete copy constructor.
+        CBlock_Pool(const CBlock_Pool&) = delete;
+
+        /// Delete assignment operator.
+        CBlock_Pool& operator=(const CBlock_Pool&) = delete;
+
+        /// Borrows a buffer from the pool. If the memory budget has been
+        /// exhausted, it waits until another buffer is returned.
+        /// \return Buffer (returned to the pool when released), nullptr if the allocation failed.
+        [[nodiscard]] std::shared_ptr<char[]> Acquire();
+
+        /// Returns the size of one buffer.
+        /// \return Size of one buffer in bytes
+        [[nodiscard]] size_t Get_Buffer_Size() const noexcept;
+
+    private:
+        /// Allocates a new buffer.
+        /// \return Buffer, nullptr if the allocation failed.
+        [[nodiscard]] char* Allocate() noexcept;
+
+        /// Frees a buffer.
+        /// \param buffer Buffer allocated by Allocate()
+        void Free(char* buffer) noexcept;
+
+        /// Returns a buffer back to the pool.
+        /// \param buffer Buffer to be returned
+        void Release(char* buffer);
+
+    private:
+        static constexpr size_t Alignment = 64; ///< Alignment of the buffers (cache line)
+
+    private:
+        size_t m_buffer_size;            ///< Size of one buffer in bytes
+        size_t m_allocation_size;        ///< Size of one allocation (rounded up to a huge page)
+        size_t m_max_buffers;            ///< Maximum number of buffers (given by the memory budget)
+        bool m_huge_pages;               ///< Flag indicating whether the buffers are backed by huge pages
+        size_t m_number_of_buffers;      ///< Number of buffers allocated so far
+        std::vector<char*> m_free;       ///< Buffers that are not being used
+        std::mutex m_mtx;                ///< Mutex guarding the free buffers
+        std::condition_variable m_cv;    ///< Signaled when a buffer is returned
+    };
+}
+
+// EOF
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <new>
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <thread>
+#include <semaphore>
+
+namespace kiv_ppr
+{
+    /// \author Jakub Silhavy
+    /// \tparam E Type of the items stored in the queue
+    ///
+    /// This class represents a bounded multi-producer multi-consumer queue. The ring itself is lock-free
+    /// (each cell carries a sequence number telling whether it is ready to be written or read). Two semaphores
+    /// put the producers to sleep when the queue is full and the consumers when it is empty, so the number
+    /// of items in the queue (and therefore the memory) is bounded.
+    template<typename E>
+    class CBlock_Queue
+    {
+    public:
+        /// Creates an instance of the class.
+        /// \param capacity Maximum number of items in the queue (rounded up to a power of two)
+        explicit CBlock_Queue(size_t capacity)
+            : m_capacity(Round_Up_To_Power_Of_Two(capacity)),
+              m_mask(m_capacity - 1),
+              m_cells(std::make_unique<TCell[]>(m_capacity)),
+              m_enqueue_pos(0),
+              m_dequeue_pos(0),
+              m_closed(false),
+              m_items(0),
+              m_slots(static_cast<std::ptrdiff_t>(m_capacity))
+        {
+            for (size_t i = 0; i < m_capacity; ++i)
+            {
+                m_cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        /// Default destructor.
+        ~CBlock_Queue() = default;
+
+        /// Delete copy constructor.
+        CBlock_Queue(const CBlock_Queue&) = delete;
+
+        /// Delete assignment operator.
+        CBlock_Queue& operator=(const CBlock_Queue&) = delete;
+
+        /// Inserts an item into the queue. If the queue is full, it waits until there is a free slot.
+        /// \param item Item to be inserted
+        /// \return true, if the item has been inserted, false if the queue has been closed.
+        [[nodiscard]] bool Push(E item)
+        {
+            m_slots.acquire();
+            if (m_closed)
+            {
+                return false;
+            }
+
+            // A slot is reserved for us, so the ring cannot be full.
+            while (!Try_Push(item))
+            {
+                std::this_thread::yield();
+            }
+            m_items.release();
+            return true;
+        }
+
+        /// Takes an item out of the queue. If the queue is empty, it waits until there is an item.
+        /// \param item Taken item
+        /// \return true, if an item has been taken, false if the queue has been closed.
+        [[nodiscard]] bool Pop(E& item)
+        {
+            m_items.acquire();
+            if (m_closed)
+            {
+                return false;
+            }
+
+            // An item is reserved for us, so the ring cannot be empty.
+            while (!Try_Pop(item))
+            {
+                std::this_thread::yield();
+            }
+            m_slots.release();
+            return true;
+        }
+
+        /// Closes the queue and wakes up all waiting producers and consumers.
+        void Close()
+        {
+            m_closed = true;
+            m_slots.release(Close_Wakeups);
+            m_items.release(Close_Wakeups);
+        }
+
+    private:
+        /// Cell of the ring.
+        struct TCell
+        {
+            std::atomic<size_t> sequence; ///< Position the cell is ready for (pos = writable, pos + 1 = readable)
+            E data;                       ///< Item stored in the cell
+        };
+
+        /// Tries to insert an item into the ring (lock-free).
+        /// \param item Item to be inserted (moved from on success)
+        /// \return true, if the item has been inserted, false if the ring is full.
+        bool Try_Push(E& item)
+        {
+            size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                TCell& cell = m_cells[pos & m_mask];
+                const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+
+                if (0 == diff)
+                {
+                    // The cell is free - try to claim it.
+                    if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        cell.data = std::move(item);
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = m_enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        /// Tries to take an item out of the ring (lock-free).
+        /// \param item Taken item
+        /// \return true, if an item has been taken, false if the ring is empty.
+        bool Try_Pop(E& item)
+        {
+            size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                TCell& cell = m_cells[pos & m_mask];
+                const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+
+                if (0 == diff)
+                {
+                    // The cell holds an item - try to claim it.
+                    if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        item = std::move(cell.data);
+                        cell.data = E{};
+                        cell.sequence.store(pos + m_capacity, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = m_dequeue_pos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        /// Rounds a number up to the nearest power of two.
+        /// \param value Number to be rounded up
+        /// \return Nearest power of two (at least 1)
+        static size_t Round_Up_To_Power_Of_Two(size_t value) noexcept
+        {
+            size_t result = 1;
+            while (result < value)
+            {
+                result <<= 1;
+            }
+            return result;
+        }
+
+    private:
+        /// Number of waiting threads Close() is able to wake up.
+        static constexpr std::ptrdiff_t Close_Wakeups = 1 << 16;
+
+    private:
+        size_t m_capacity;                                           ///< Capacity of the ring (power of two)
+        size_t m_mask;                                               ///< Mask used to map a position onto a cell
+        std::unique_ptr<TCell[]> m_cells;                            ///< Cells of the ring
+        alignas(64) std::atomic<size_t> m_enqueue_pos;               ///< Position of the next insertion (own cache line)
+        alignas(64) std::atomic<size_t> m_dequeue_pos;               ///< Position of the next removal (own cache line)
+        std::atomic<bool> m_closed;                                  ///< Flag indicating whether the queue has been closed
+        std::counting_semaphore<> m_items;                           ///< Number of items in the queue
+        std::counting_semaphore<> m_slots;                           ///< Number of free slots in the queue
+    };
+}
+
+// EOF
@@ -0,0 +1,160 @@
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#include <algorithm>
+
+#include "file_mapping.h"
+
+namespace kiv_ppr
+{
+#ifdef _WIN32
+    CFile_Mapping::CFile_Mapping(const std::string& filename)
+        : m_data(nullptr),
+          m_size(0),
+          m_file(INVALID_HANDLE_VALUE),
+          m_mapping(nullptr)
+    {
+        m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (INVALID_HANDLE_VALUE == m_file)
+        {
+            return;
+        }
+
+        // Only regular files (not pipes, consoles, ...) can be mapped.
+        LARGE_INTEGER size{};
+        if (FILE_TYPE_DISK != GetFileType(m_file) || !GetFileSizeEx(m_file, &size) || 0 == size.QuadPart)
+        {
+            return;
+        }
+
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (nullptr == m_mapping)
+        {
+            return;
+        }
+
+        m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        if (nullptr != m_data)
+        {
+            m_size = static_cast<size_t>(size.QuadPart);
+        }
+    }
+
+    CFile_Mapping::~CFile_Mapping()
+    {
+        if (nullptr != m_data)
+        {
+            UnmapViewOfFile(m_data);
+        }
+        if (nullptr != m_mapping)
+        {
+            CloseHandle(m_mapping);
+        }
+        if (INVALID_HANDLE_VALUE != m_file)
+        {
+            CloseHandle(m_file);
+        }
+    }
+
+    void CFile_Mapping::Advise_Sequential() const noexcept
+    {
+        // There is no equivalent of MADV_SEQUENTIAL for a view of a file on Windows
+        // (the file is opened with FILE_FLAG_SEQUENTIAL_SCAN instead).
+    }
+
+    void CFile_Mapping::Advise_Will_Need(size_t offset, size_t length) const noexcept
+    {
+        if (nullptr == m_data || offset >= m_size)
+        {
+            return;
+        }
+
+        WIN32_MEMORY_RANGE_ENTRY range{};
+        range.VirtualAddress = const_cast<char*>(m_data + offset);
+        range.NumberOfBytes = std::min(length, m_size - offset);
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#else
+    CFile_Mapping::CFile_Mapping(const std::string& filename)
+        : m_data(nullptr),
+          m_size(0)
+    {
+        const int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return;
+        }
+
+        // Only regular files (not pipes, sockets, ...) can be mapped.
+        struct stat info{};
+        if (0 == fstat(fd, &info) && S_ISREG(info.st_mode) && info.st_size > 0)
+        {
+            void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (MAP_FAILED != data)
+            {
+                m_data = static_cast<const char*>(data);
+                m_size = static_cast<size_t>(info.st_size);
+            }
+        }
+
+        // The mapping stays valid after the file descriptor is closed.
+        close(fd);
+    }
+
+    CFile_Mapping::~CFile_Mapping()
+    {
+        if (nullptr != m_data)
+        {
+            munmap(const_cast<char*>(m_data), m_size);
+        }
+    }
+
+    void CFile_Mapping::Advise_Sequential() const noexcept
+    {
+        if (nullptr != m_data)
+        {
+            madvise(const_cast<char*>(m_data), m_size, MADV_SEQUENTIAL);
+        }
+    }
+
+    void CFile_Mapping::Advise_Will_Need(size_t offset, size_t length) const noexcept
+    {
+        if (nullptr == m_data || offset >= m_size)
+        {
+            return;
+        }
+
+        // madvise requires the address to be aligned to the page size.
+        static const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t aligned_offset = offset - (offset % page_size);
+        length = std::min(length + (offset - aligned_offset), m_size - aligned_offset);
+
+        madvise(const_cast<char*>(m_data + aligned_offset), length, MADV_WILLNEED);
+    }
+#endif
+
+    bool CFile_Mapping::Is_Mapped() const noexcept
+    {
+        return nullptr != m_data;
+    }
+
+    const char* CFile_Mapping::Get_Data() const noexcept
+    {
+        return m_data;
+    }
+
+    size_t CFile_Mapping::Get_Size() const noexcept
+    {
+        return m_size;
+    }
+}
+
+// EOF
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace kiv_ppr
+{
+    /// \author Jakub Silhavy
+    ///
+    /// This class maps a file into the address space of the process (read only).
+    /// It is used by the file reader, so the worker threads can access the data
+    /// straight from the page cache (no allocation and no copying). The mapping
+    /// is released when the instance is destroyed.
+    class CFile_Mapping
+    {
+    public:
+        /// Maps the file into the memory. If the file cannot be mapped
+        /// (e.g. it is a pipe), Is_Mapped() returns false.
+        /// \param filename Path to the file
+        explicit CFile_Mapping(const std::string& filename);
+
+        /// Unmaps the file.
+        ~CFile_Mapping();
+
+        /// Delete copy constructor.
+        CFile_Mapping(const CFile_Mapping&) = delete;
+
+        /// Delete assignment operator.
+        CFile_Mapping& operator=(const CFile_Mapping&) = delete;
+
+        /// Returns whether the file has been successfully mapped into the memory.
+        /// \return true, if the file is mapped, false otherwise.
+        [[nodiscard]] bool Is_Mapped() const noexcept;
+
+        /// Returns the beginning of the mapped file.
+        /// \return Pointer to the first byte of the file.
+        [[nodiscard]] const char* Get_Data() const noexcept;
+
+        /// Returns the size of the mapped file.
+        /// \return Size of the file in bytes.
+        [[nodiscard]] size_t Get_Size() const noexcept;
+
+        /// Tells the OS that the file is going to be read sequentially (more aggressive read-ahead).
+        void Advise_Sequential() const noexcept;
+
+        /// Tells the OS that a part of the file is going to be accessed soon, so it can start reading it.
+        /// \param offset Offset of the first byte
+        /// \param length Number of bytes
+        void Advise_Will_Need(size_t offset, size_t length) const noexcept;
+
+    private:
+        const char* m_data; ///< Beginning of the mapped file
+        size_t m_size;      ///< Size of the mapped file
+#ifdef _WIN32
+        void* m_file;       ///< Handle of the file
+        void* m_mapping;    ///< Handle of the file mapping object
+#endif
+    };
+}
+
+// EOF
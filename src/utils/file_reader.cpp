@@ -1,5 +1,6 @@
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 
 #include "file_reader.h"
 #include "../config.h"
@@ -7,9 +8,24 @@
 namespace kiv_ppr
 {
     template<typename T>
-    CFile_Reader<T>::CFile_Reader(const std::string& filename)
+    CFile_Reader<T>::CFile_Reader(const std::string& filename, config::TReader_Params params)
         : m_filename(filename),
-          m_number_of_read_elements(0)
+          m_file_size(0),
+          m_first_element(0),
+          m_number_of_elements(0),
+          m_number_of_read_elements(0),
+          m_mapping(nullptr),
+          m_async(nullptr),
+          m_positional(nullptr),
+          m_pool(nullptr),
+          m_memory_budget(params.memory_budget),
+          m_huge_pages(params.huge_pages),
+          m_reader_threads(params.reader_threads),
+          m_pipeline_depth(std::max<uint32_t>(params.pipeline_depth, 1)),
+          m_pipeline_queue(nullptr),
+          m_active_readers(0),
+          m_pipeline_started(false),
+          m_async_started(false)
     {
         // Open the input file.
         m_file = std::ifstream(filename, std::ios::in | std::ios::binary);
@@ -21,6 +37,54 @@ namespace kiv_ppr
             m_file_size = Calculate_File_Size();
             m_number_of_elements = m_file_size / sizeof(T);
         }
+
+        // Try to map the file into the memory. If it fails (e.g. the file is a pipe),
+        // the stream will be used instead.
+        if (m_file.is_open() && config::NReader_Type::Mmap == params.type)
+        {
+            m_mapping = std::make_shared<CFile_Mapping>(filename);
+            if (m_mapping->Is_Mapped() && m_mapping->Get_Size() == m_file_size)
+            {
+                m_mapping->Advise_Sequential();
+            }
+            else
+            {
+                m_mapping = nullptr;
+            }
+        }
+
+        // Asynchronous reads need positional reads, so again, a pipe falls back to the stream.
+        if (m_file.is_open() && config::NReader_Type::Async == params.type)
+        {
+            // By default, each worker may hold a buffer while queue_depth reads are in flight.
+            const uint32_t buffer_count = 0 != params.buffer_count ? params.buffer_count : params.queue_depth + std::thread::hardware_concurrency();
+            m_async = std::make_unique<CAsync_Reader>(filename, params.queue_depth, buffer_count);
+            if (!m_async->Is_Open())
+            {
+                m_async = nullptr;
+            }
+        }
+
+        // The same goes for positional reads.
+        if (m_file.is_open() && config::NReader_Type::Pread == params.type)
+        {
+            m_positional = std::make_unique<CPositional_File>(filename);
+            if (!m_positional->Is_Regular_File())
+            {
+                m_positional = nullptr;
+            }
+        }
+    }
+
+    template<typename T>
+    CFile_Reader<T>::~CFile_Reader()
+    {
+        // The blocks in the queue may hold buffers of the asynchronous reader, so the pipeline goes first.
+        Stop_Pipeline();
+        if (nullptr != m_async)
+        {
+            m_async->Stop();
+        }
     }
 
     template<typename T>
@@ -41,22 +105,317 @@ namespace kiv_ppr
         return m_number_of_elements;
     }
 
+    template<typename T>
+    size_t CFile_Reader<T>::Get_Number_Of_Remaining_Elements() const noexcept
+    {
+        const size_t number_of_read_elements = m_number_of_read_elements;
+        return number_of_read_elements >= m_number_of_elements ? 0 : m_number_of_elements - number_of_read_elements;
+    }
+
     template<typename T>
     std::string CFile_Reader<T>::Get_Filename() const noexcept
     {
         return m_filename;
     }
 
+    template<typename T>
+    config::NReader_Type CFile_Reader<T>::Get_Reader_Type() const noexcept
+    {
+        if (nullptr != m_async)
+        {
+            return config::NReader_Type::Async;
+        }
+        if (nullptr != m_positional)
+        {
+            return config::NReader_Type::Pread;
+        }
+        return nullptr != m_mapping ? config::NReader_Type::Mmap : config::NReader_Type::Stream;
+    }
+
+    template<typename T>
+    double CFile_Reader<T>::Get_Read_Throughput() const
+    {
+        return nullptr != m_async ? m_async->Get_Throughput() : 0;
+    }
+
+    template<typename T>
+    const char* CFile_Reader<T>::Get_Async_Engine_Str() const noexcept
+    {
+        return nullptr != m_async ? m_async->Get_Engine_Str() : "";
+    }
+
+    template<typename T>
+    size_t CFile_Reader<T>::Get_First_Element() const noexcept
+    {
+        return m_first_element;
+    }
+
+    template<typename T>
+    void CFile_Reader<T>::Set_Range(size_t first_element, size_t number_of_elements)
+    {
+        const size_t total_number_of_elements = m_file_size / sizeof(T);
+        m_first_element = std::min(first_element, total_number_of_elements);
+        m_number_of_elements = std::min(number_of_elements, total_number_of_elements - m_first_element);
+        Seek_Beg();
+    }
+
     template<typename T>
     void CFile_Reader<T>::Seek_Beg()
     {
+        Stop_Pipeline();
         m_number_of_read_elements = 0;
+        if (nullptr != m_async)
+        {
+            // The next pass will start reading from the beginning.
+            m_async->Stop();
+            m_async_started = false;
+        }
         m_file.clear();
-        m_file.seekg(0, std::ios::beg);
+        m_file.seekg(static_cast<std::streamoff>(m_first_element * sizeof(T)), std::ios::beg);
     }
 
     template<typename T>
     typename CFile_Reader<T>::TData_Block CFile_Reader<T>::Read_Data(size_t number_of_elements)
+    {
+        if (0 != m_reader_threads)
+        {
+            return Read_Data_Pipelined(number_of_elements);
+        }
+        return Read_Data_Direct(number_of_elements);
+    }
+
+    template<typename T>
+    typename CFile_Reader<T>::TData_Block CFile_Reader<T>::Read_Data_Pipelined(size_t number_of_elements)
+    {
+        // The block size is not known until the first read, so the reader threads are started here.
+        if (!m_pipeline_started)
+        {
+            const std::lock_guard<std::mutex> lock(m_pipeline_mtx);
+            if (!m_pipeline_started)
+            {
+                m_pipeline_queue = std::make_unique<CBlock_Queue<TData_Block>>(m_pipeline_depth);
+                m_active_readers = m_reader_threads;
+                for (uint32_t i = 0; i < m_reader_threads; ++i)
+                {
+                    m_pipeline_threads.emplace_back(&CFile_Reader<T>::Pipeline_Reader, this, number_of_elements);
+                }
+                m_pipeline_started = true;
+            }
+        }
+
+        // The queue is closed if a reader thread failed to read the file (or the pipeline is being stopped).
+        TData_Block block{};
+        if (!m_pipeline_queue->Pop(block))
+        {
+            return { NRead_Status::Error, 0, nullptr };
+        }
+
+        // EOF is left in the queue for the other workers to see as well.
+        // There is always a free slot for it, as all the reader threads have finished.
+        if (NRead_Status::EOF_ == block.status)
+        {
+            (void)m_pipeline_queue->Push(block);
+        }
+        return block;
+    }
+
+    template<typename T>
+    void CFile_Reader<T>::Pipeline_Reader(size_t number_of_elements)
+    {
+        while (true)
+        {
+            auto block = Read_Data_Direct(number_of_elements);
+            if (NRead_Status::EOF_ == block.status)
+            {
+                // The last reader thread to finish lets the workers know about the end of the file.
+                if (1 == m_active_readers.fetch_sub(1))
+                {
+                    (void)m_pipeline_queue->Push(block);
+                }
+                return;
+            }
+
+            // A failed read ends the pass for everybody. Closing the queue wakes up all the workers
+            // (they get an Error block) as well as the other reader threads waiting for a free slot.
+            if (NRead_Status::Error == block.status)
+            {
+                m_active_readers.fetch_sub(1);
+                m_pipeline_queue->Close();
+                return;
+            }
+
+            // Wait for a free slot in the queue (back-pressure). The queue is closed if the pipeline is being stopped.
+            if (!m_pipeline_queue->Push(std::move(block)))
+            {
+                m_active_readers.fetch_sub(1);
+                return;
+            }
+        }
+    }
+
+    template<typename T>
+    void CFile_Reader<T>::Stop_Pipeline()
+    {
+        if (nullptr == m_pipeline_queue)
+        {
+            return;
+        }
+
+        // Wake up the reader threads waiting for a free slot.
+        m_pipeline_queue->Close();
+        for (auto& thread : m_pipeline_threads)
+        {
+            thread.join();
+        }
+        m_pipeline_threads.clear();
+        m_pipeline_queue = nullptr;
+        m_pipeline_started = false;
+    }
+
+    template<typename T>
+    typename CFile_Reader<T>::TData_Block CFile_Reader<T>::Read_Data_Direct(size_t number_of_elements)
+    {
+        if (nullptr != m_mapping)
+        {
+            return Read_Data_Mapped(number_of_elements);
+        }
+        if (nullptr != m_async)
+        {
+            return Read_Data_Async(number_of_elements);
+        }
+        if (nullptr != m_positional)
+        {
+            return Read_Data_Positional(number_of_elements);
+        }
+        return Read_Data_Stream(number_of_elements);
+    }
+
+    template<typename T>
+    std::shared_ptr<CBlock_Pool> CFile_Reader<T>::Get_Block_Pool(size_t number_of_elements)
+    {
+        const std::lock_guard<std::mutex> lock(m_pool_mtx);
+
+        // The blocks borrowed from the old pool keep it alive until they are released.
+        if (nullptr == m_pool || m_pool->Get_Buffer_Size() < number_of_elements * sizeof(T))
+        {
+            m_pool = std::make_shared<CBlock_Pool>(number_of_elements * sizeof(T), m_memory_budget, m_huge_pages);
+        }
+        return m_pool;
+    }
+
+    template<typename T>
+    std::shared_ptr<T[]> CFile_Reader<T>::Acquire_Buffer(size_t number_of_elements)
+    {
+        auto buffer = Get_Block_Pool(number_of_elements)->Acquire();
+        if (nullptr == buffer)
+        {
+            return nullptr;
+        }
+
+        // The block shares the ownership of the buffer (the buffer is returned to the pool once the block is released).
+#pragma warning(disable:26490)
+        return std::shared_ptr<T[]>(buffer, reinterpret_cast<T*>(buffer.get()));
+#pragma warning(default:26490)
+    }
+
+    template<typename T>
+    typename CFile_Reader<T>::TData_Block CFile_Reader<T>::Read_Data_Positional(size_t number_of_elements)
+    {
+        // Claim the next block of the file (no lock is needed).
+        const size_t offset = m_number_of_read_elements.fetch_add(number_of_elements);
+        if (offset >= m_number_of_elements)
+        {
+            return { NRead_Status::EOF_, 0, nullptr };
+        }
+
+        // Only the remaining elements may be read at the end of the file.
+        number_of_elements = std::min(number_of_elements, m_number_of_elements - offset);
+
+        // Borrow a buffer for the elements to be read from the file.
+        auto buffer = Acquire_Buffer(number_of_elements);
+        if (nullptr == buffer)
+        {
+            return { NRead_Status::Error, 0, nullptr };
+        }
+
+        // Read the block at its offset. Other workers may be reading their blocks at the same time.
+        const size_t size = number_of_elements * sizeof(T);
+        if (m_positional->Read(buffer.get(), size, (m_first_element + offset) * sizeof(T)) != static_cast<int64_t>(size))
+        {
+            return { NRead_Status::Error, 0, nullptr };
+        }
+
+        return { NRead_Status::OK, number_of_elements, buffer };
+    }
+
+    template<typename T>
+    typename CFile_Reader<T>::TData_Block CFile_Reader<T>::Read_Data_Async(size_t number_of_elements)
+    {
+        // The block size is not known until the first read, so the reading is started here.
+        if (!m_async_started)
+        {
+            const std::lock_guard<std::mutex> lock(m_mtx);
+            if (!m_async_started)
+            {
+                m_async->Start(m_number_of_elements * sizeof(T), number_of_elements * sizeof(T), m_first_element * sizeof(T));
+                m_async_started = true;
+            }
+        }
+
+        const auto block = m_async->Pop();
+        switch (block.status)
+        {
+            case CAsync_Reader::NStatus::OK:
+                break;
+
+            case CAsync_Reader::NStatus::EOF_:
+                return { NRead_Status::EOF_, 0, nullptr };
+
+            case CAsync_Reader::NStatus::Error: [[fallthrough]];
+            default:
+                return { NRead_Status::Error, 0, nullptr };
+        }
+        m_number_of_read_elements += block.size / sizeof(T);
+
+        // Once the worker releases the block, the buffer goes back to the asynchronous reader.
+#pragma warning(disable:26490)
+        T* data = reinterpret_cast<T*>(block.data);
+#pragma warning(default:26490)
+
+        CAsync_Reader* async = m_async.get();
+        const size_t buffer_index = block.buffer_index;
+        return { NRead_Status::OK, block.size / sizeof(T), std::shared_ptr<T[]>(data, [async, buffer_index](T*) {
+            async->Release(buffer_index);
+        })};
+    }
+
+    template<typename T>
+    typename CFile_Reader<T>::TData_Block CFile_Reader<T>::Read_Data_Mapped(size_t number_of_elements)
+    {
+        // Claim the next block of the file (no lock is needed).
+        const size_t offset = m_number_of_read_elements.fetch_add(number_of_elements);
+        if (offset >= m_number_of_elements)
+        {
+            return { NRead_Status::EOF_, 0, nullptr };
+        }
+
+        // Only the remaining elements may be read at the end of the file.
+        number_of_elements = std::min(number_of_elements, m_number_of_elements - offset);
+
+        // Let the OS start reading this block as well as the block that is likely to be claimed next.
+        m_mapping->Advise_Will_Need((m_first_element + offset) * sizeof(T), 2 * number_of_elements * sizeof(T));
+
+        // The block points straight into the mapping and keeps it alive. The mapping is read-only,
+        // which is fine as the workers never modify the data.
+#pragma warning(disable:26490)
+        T* data = reinterpret_cast<T*>(const_cast<char*>(m_mapping->Get_Data())) + m_first_element + offset;
+#pragma warning(default:26490)
+
+        return { NRead_Status::OK, number_of_elements, std::shared_ptr<T[]>(m_mapping, data) };
+    }
+
+    template<typename T>
+    typename CFile_Reader<T>::TData_Block CFile_Reader<T>::Read_Data_Stream(size_t number_of_elements)
     {
         // Mutual exclusion
         const std::lock_guard<std::mutex> lock(m_mtx);
@@ -76,8 +435,8 @@ namespace kiv_ppr
         // Update the total number of elements read from the file so far.
         m_number_of_read_elements += number_of_elements;
 
-        // Create a buffer for the elements to be read from the file.
-        auto buffer = std::shared_ptr<T[]>(new(std::nothrow) T[number_of_elements]);
+        // Borrow a buffer for the elements to be read from the file.
+        auto buffer = Acquire_Buffer(number_of_elements);
         if (nullptr == buffer)
         {
             return { NRead_Status::Error, 0, nullptr };
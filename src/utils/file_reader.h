@@ -4,6 +4,16 @@
 #include <memory>
 #include <fstream>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "../config.h"
+#include "file_mapping.h"
+#include "async_reader.h"
+#include "positional_file.h"
+#include "block_pool.h"
+#include "block_queue.h"
 
 namespace kiv_ppr
 {
@@ -12,6 +22,13 @@ namespace kiv_ppr
     ///
     /// This class provides a thread-safe functions for reading a binary file.
     /// It is used by worker threads when processing the input file.
+    /// The file can be read either through a stream (a mutex is held while reading)
+    /// or it can be mapped into the memory, in which case data blocks point straight
+    /// into the mapping and claiming a block is a single atomic operation. Finally, the file
+    /// can be read asynchronously ahead of the workers (see CAsync_Reader), or each worker can
+    /// claim a block atomically and read it using a positional read with no lock held (pread).
+    /// Any backend can be driven by dedicated reader threads, which fill a bounded queue of blocks
+    /// the workers take from, so the I/O overlaps with the computation (pipeline).
     template<typename T>
     class CFile_Reader
     {
@@ -29,16 +46,17 @@ namespace kiv_ppr
         {
             NRead_Status status;       ///< Read status (OK, Error, EOF_)
             size_t count;              ///< Number of values read from the file
-            std::shared_ptr<T[]> data; ///< Data itself (heap allocation)
+            std::shared_ptr<T[]> data; ///< Data itself (a buffer borrowed from the pool, the mapping, ...)
         };
 
     public:
         /// Creates an instance of the class. 
         /// \param filename Path to the input file 
-        explicit CFile_Reader(const std::string& filename);
+        /// \param params Configuration of the reader (backend, ...)
+        explicit CFile_Reader(const std::string& filename, config::TReader_Params params = {});
 
-        /// Default destructor.
-        ~CFile_Reader() = default;
+        /// Destructor (stops the reader threads and the asynchronous reads).
+        ~CFile_Reader();
 
         /// Returns whether the input file is open or not.
         /// \return true, if the input file is open, false otherwise.
@@ -48,20 +66,48 @@ namespace kiv_ppr
         /// \return Size of the input file in bytes.
         [[nodiscard]] size_t Get_File_Size() const noexcept;
 
-        /// Returns the number of elements in the input file.
+        /// Returns the number of elements in the input file (in the range being read, see Set_Range).
         /// This values is given by the datatype T.
         /// \return Number of elements in the input file.
         [[nodiscard]] size_t Get_Number_Of_Elements() const noexcept;
+
+        /// Returns the number of elements that have not been read (claimed) since the last Seek_Beg().
+        /// \return Number of remaining elements.
+        [[nodiscard]] size_t Get_Number_Of_Remaining_Elements() const noexcept;
         
+        /// Returns the backend that is actually used to read the input file.
+        /// It may differ from the requested one (e.g. a pipe cannot be mapped into the memory).
+        /// \return Backend used to read the input file.
+        [[nodiscard]] config::NReader_Type Get_Reader_Type() const noexcept;
+
+        /// Returns the read throughput achieved by the Async backend.
+        /// \return Read throughput [GB/s] (0, if another backend is used)
+        [[nodiscard]] double Get_Read_Throughput() const;
+
+        /// Returns a text representation of the engine used by the Async backend (io_uring, ...).
+        /// \return Text representation of the engine (an empty string, if another backend is used)
+        [[nodiscard]] const char* Get_Async_Engine_Str() const noexcept;
+
         /// Returns the input file name.
         /// \return Name of the input file.
         [[nodiscard]] std::string Get_Filename() const noexcept;
 
-        /// Seeks to the beginning of the input file.
+        /// Returns the index of the first element being read (see Set_Range).
+        /// \return Index of the first element
+        [[nodiscard]] size_t Get_First_Element() const noexcept;
+
+        /// Restricts reading to a range of elements of the input file (e.g. the data appended since the last run).
+        /// The range is clamped to the input file. It also seeks to the beginning of the range.
+        /// \param first_element Index of the first element to be read
+        /// \param number_of_elements Number of elements to be read
+        void Set_Range(size_t first_element, size_t number_of_elements);
+
+        /// Seeks to the beginning of the input file (to the beginning of the range being read).
         void Seek_Beg();
 
         /// Reads a block of data from the input file.
         /// This method is periodically called from the worker threads.
+        /// If the pipeline is enabled, the block is taken from the queue filled by the reader threads.
         /// \param number_of_elements Number of elements to be read from the input file.
         /// \return Block of data read from the input file.
         [[nodiscard]] TData_Block Read_Data(size_t number_of_elements);
@@ -79,13 +125,78 @@ namespace kiv_ppr
         /// \return Size of the input file.
         [[nodiscard]] size_t Calculate_File_Size();
 
+        /// Reads a block of data from the input file using the backend.
+        /// \param number_of_elements Number of elements to be read from the input file.
+        /// \return Block of data read from the input file.
+        [[nodiscard]] TData_Block Read_Data_Direct(size_t number_of_elements);
+
+        /// Takes a block of data from the queue filled by the reader threads.
+        /// The first call after Seek_Beg() starts the reader threads.
+        /// \param number_of_elements Number of elements to be read from the input file.
+        /// \return Block of data read from the input file.
+        [[nodiscard]] TData_Block Read_Data_Pipelined(size_t number_of_elements);
+
+        /// Run function of a reader thread. It reads blocks and puts them into the queue until the end of the file.
+        /// \param number_of_elements Number of elements per block
+        void Pipeline_Reader(size_t number_of_elements);
+
+        /// Stops the reader threads and drops the blocks left in the queue.
+        void Stop_Pipeline();
+
+        /// Returns the pool the data blocks are read into. The pool is created (or replaced
+        /// by a bigger one) the first time a block of the given size is requested.
+        /// \param number_of_elements Number of elements to be read from the input file.
+        /// \return Pool of buffers.
+        [[nodiscard]] std::shared_ptr<CBlock_Pool> Get_Block_Pool(size_t number_of_elements);
+
+        /// Borrows a buffer for a block of data from the pool.
+        /// \param number_of_elements Number of elements to be read from the input file.
+        /// \return Buffer (returned to the pool once released), nullptr if the allocation failed.
+        [[nodiscard]] std::shared_ptr<T[]> Acquire_Buffer(size_t number_of_elements);
+
+        /// Reads a block of data from the input file using the stream.
+        /// \param number_of_elements Number of elements to be read from the input file.
+        /// \return Block of data read from the input file.
+        [[nodiscard]] TData_Block Read_Data_Stream(size_t number_of_elements);
+
+        /// Claims a block of data of the file mapped into the memory.
+        /// \param number_of_elements Number of elements to be read from the input file.
+        /// \return Block of data pointing into the mapping.
+        [[nodiscard]] TData_Block Read_Data_Mapped(size_t number_of_elements);
+
+        /// Claims a block of data and reads it using a positional read (no lock is held while reading).
+        /// \param number_of_elements Number of elements to be read from the input file.
+        /// \return Block of data read from the input file.
+        [[nodiscard]] TData_Block Read_Data_Positional(size_t number_of_elements);
+
+        /// Takes a block of data read ahead by the asynchronous reader. The first call after Seek_Beg() starts the reading.
+        /// \param number_of_elements Number of elements to be read from the input file.
+        /// \return Block of data (its buffer is returned to the asynchronous reader once it is released).
+        [[nodiscard]] TData_Block Read_Data_Async(size_t number_of_elements);
+
     private:
-        std::string m_filename;                ///< Path to the input file
-        std::ifstream m_file;                  ///< Input stream (reading data from a file)
-        std::mutex m_mtx;                      ///< Mutex used when reading from the input file
-        size_t m_file_size;                    ///< Size of the input file
-        std::size_t m_number_of_elements;      ///< Total number of elements in the input file
-        std::size_t m_number_of_read_elements; ///< Number of elements read from the file since the last Seek_Beg()
+        std::string m_filename;                             ///< Path to the input file
+        std::ifstream m_file;                               ///< Input stream (reading data from a file)
+        std::mutex m_mtx;                                   ///< Mutex used when reading from the input file
+        size_t m_file_size;                                 ///< Size of the input file
+        std::size_t m_first_element;                        ///< Index of the first element of the range being read
+        std::size_t m_number_of_elements;                   ///< Total number of elements in the range being read (the whole file by default)
+        std::atomic<std::size_t> m_number_of_read_elements; ///< Number of elements read (claimed) from the range since the last Seek_Beg()
+        std::shared_ptr<CFile_Mapping> m_mapping;           ///< Input file mapped into the memory (Mmap backend only)
+        std::unique_ptr<CAsync_Reader> m_async;             ///< Asynchronous reader (Async backend only)
+        std::unique_ptr<CPositional_File> m_positional;     ///< Input file opened for positional reads (Pread backend only)
+        std::shared_ptr<CBlock_Pool> m_pool;                ///< Pool of buffers the data blocks are read into (Stream and Pread backends)
+        std::mutex m_pool_mtx;                              ///< Mutex used when creating the pool of buffers
+        size_t m_memory_budget;                             ///< Maximum memory held by the pool of buffers (0 = unlimited)
+        bool m_huge_pages;                                  ///< Back the pool of buffers by huge pages
+        uint32_t m_reader_threads;                          ///< Number of dedicated reader threads (0 = no pipeline)
+        uint32_t m_pipeline_depth;                          ///< Capacity of the queue filled by the reader threads
+        std::vector<std::thread> m_pipeline_threads;        ///< Dedicated reader threads
+        std::unique_ptr<CBlock_Queue<TData_Block>> m_pipeline_queue; ///< Queue of blocks read ahead by the reader threads
+        std::atomic<uint32_t> m_active_readers;             ///< Number of reader threads that have not reached the end of the file yet
+        std::mutex m_pipeline_mtx;                          ///< Mutex used when starting the reader threads
+        std::atomic<bool> m_pipeline_started;               ///< Flag indicating whether the reader threads of the current pass have started
+        std::atomic<bool> m_async_started;                  ///< Flag indicating whether the asynchronous reads of the current pass have started
     };
 }
 
@@ -0,0 +1,133 @@
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/stat.h>
+#endif
+
+#include <algorithm>
+
+#include "positional_file.h"
+
+namespace kiv_ppr
+{
+#ifdef _WIN32
+    CPositional_File::CPositional_File(const std::string& filename)
+        : m_handle(CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr))
+    {
+
+    }
+
+    CPositional_File::~CPositional_File()
+    {
+        if (INVALID_HANDLE_VALUE != m_handle)
+        {
+            CloseHandle(m_handle);
+        }
+    }
+
+    bool CPositional_File::Is_Open() const noexcept
+    {
+        return INVALID_HANDLE_VALUE != m_handle;
+    }
+
+    bool CPositional_File::Is_Regular_File() const noexcept
+    {
+        return Is_Open() && FILE_TYPE_DISK == GetFileType(m_handle);
+    }
+
+    int64_t CPositional_File::Read(void* buffer, size_t size, uint64_t offset) const noexcept
+    {
+        size_t total = 0;
+        while (total < size)
+        {
+            // The offset is passed in through the OVERLAPPED structure (the file position is not used).
+            OVERLAPPED overlapped{};
+            overlapped.Offset = static_cast<DWORD>(offset + total);
+            overlapped.OffsetHigh = static_cast<DWORD>((offset + total) >> 32);
+
+            DWORD read = 0;
+            const auto chunk = static_cast<DWORD>(std::min<size_t>(size - total, 1u << 30));
+            if (!ReadFile(m_handle, static_cast<char*>(buffer) + total, chunk, &read, &overlapped))
+            {
+                return GetLastError() == ERROR_HANDLE_EOF ? static_cast<int64_t>(total) : -1;
+            }
+
+            // End of the file.
+            if (0 == read)
+            {
+                break;
+            }
+            total += read;
+        }
+        return static_cast<int64_t>(total);
+    }
+
+    int CPositional_File::Get_Descriptor() const noexcept
+    {
+        return -1;
+    }
+#else
+    CPositional_File::CPositional_File(const std::string& filename)
+        : m_fd(open(filename.c_str(), O_RDONLY))
+    {
+
+    }
+
+    CPositional_File::~CPositional_File()
+    {
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+        }
+    }
+
+    bool CPositional_File::Is_Open() const noexcept
+    {
+        return m_fd >= 0;
+    }
+
+    bool CPositional_File::Is_Regular_File() const noexcept
+    {
+        struct stat info{};
+        return Is_Open() && 0 == fstat(m_fd, &info) && S_ISREG(info.st_mode);
+    }
+
+    int64_t CPositional_File::Read(void* buffer, size_t size, uint64_t offset) const noexcept
+    {
+        size_t total = 0;
+        while (total < size)
+        {
+            const ssize_t read = pread(m_fd, static_cast<char*>(buffer) + total, size - total, static_cast<off_t>(offset + total));
+            if (read < 0)
+            {
+                // Interrupted by a signal, try again.
+                if (EINTR == errno)
+                {
+                    continue;
+                }
+                return -1;
+            }
+
+            // End of the file.
+            if (0 == read)
+            {
+                break;
+            }
+            total += static_cast<size_t>(read);
+        }
+        return static_cast<int64_t>(total);
+    }
+
+    int CPositional_File::Get_Descriptor() const noexcept
+    {
+        return m_fd;
+    }
+#endif
+}
+
+// EOF
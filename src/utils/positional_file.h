@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace kiv_ppr
+{
+    /// \author Jakub Silhavy
+    ///
+    /// This class represents a file opened for positional reads (pread).
+    /// A positional read does not use a shared file position, so any number
+    /// of threads can read from the same file at the same time without a lock.
+    class CPositional_File
+    {
+    public:
+        /// Opens the file (read only).
+        /// \param filename Path to the file
+        explicit CPositional_File(const std::string& filename);
+
+        /// Closes the file.
+        ~CPositional_File();
+
+        /// Delete copy constructor.
+        CPositional_File(const CPositional_File&) = delete;
+
+        /// Delete assignment operator.
+        CPositional_File& operator=(const CPositional_File&) = delete;
+
+        /// Returns whether the file is open or not.
+        /// \return true, if the file is open, false otherwise.
+        [[nodiscard]] bool Is_Open() const noexcept;
+
+        /// Returns whether the file is a regular file (not a pipe, socket, ...).
+        /// \return true, if the file is a regular file, false otherwise.
+        [[nodiscard]] bool Is_Regular_File() const noexcept;
+
+        /// Reads bytes from the file at a given offset. Short reads are retried,
+        /// so fewer bytes are returned only at the end of the file or if an error occurs.
+        /// \param buffer Destination buffer
+        /// \param size Number of bytes to be read
+        /// \param offset Offset within the file
+        /// \return Number of bytes read, or -1 if an error occurred.
+        [[nodiscard]] int64_t Read(void* buffer, size_t size, uint64_t offset) const noexcept;
+
+        /// Returns the native file descriptor (used by io_uring).
+        /// \return File descriptor (-1 on Windows)
+        [[nodiscard]] int Get_Descriptor() const noexcept;
+
+    private:
+#ifdef _WIN32
+        void* m_handle; ///< Handle of the file
+#else
+        int m_fd;       ///< File descriptor
+#endif
+    };
+}
+
+// EOF
@@ -1,11 +1,14 @@
 #include <iostream>
+#include <algorithm>
 
 #include "resource_manager.h"
+#include "../config.h"
 
 namespace kiv_ppr
 {
-    CResource_Manager::TResource::TResource(NDevice_Status status, cl::Device device)
-        : m_status(status),
+    CResource_Manager::TResource::TResource(uint32_t slots, cl::Device device)
+        : m_slots(slots),
+          m_taken(0),
           m_device(device)
     {
 
@@ -17,6 +20,12 @@ namespace kiv_ppr
         m_use_gpu_only = use_gpu_only;
     }
 
+    void CResource_Manager::Set_Device_Slots(uint32_t queues_per_device, uint32_t cpu_sub_devices) noexcept
+    {
+        m_queues_per_device = queues_per_device;
+        m_cpu_sub_devices = cpu_sub_devices;
+    }
+
     void CResource_Manager::Find_Available_GPUs(const std::unordered_set<std::string>& listed_devices)
     {
         if (m_run_type == CArg_Parser::NRun_Type::SMP)
@@ -64,7 +73,7 @@ namespace kiv_ppr
                 if ((m_run_type == CArg_Parser::NRun_Type::OpenCL_Devs && listed_devices.count(name)) ||
                      m_run_type == CArg_Parser::NRun_Type::All)
                 {
-                    m_gpu_devices.emplace_back(NDevice_Status::Available, device);
+                    Add_Device(device);
                 }
 
                 // Add the device to the list of all existing devices.
@@ -76,6 +85,63 @@ namespace kiv_ppr
         Print_Found_Devs(found_devices, listed_devices);
     }
 
+    void CResource_Manager::Add_Device(const cl::Device& device)
+    {
+        // Partition a CPU device into sub-devices of (roughly) the same number of compute units.
+        if (m_cpu_sub_devices > 1 && CL_DEVICE_TYPE_CPU == (device.getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_CPU))
+        {
+            const cl_uint compute_units = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+            const cl_uint units_per_sub_device = std::max<cl_uint>(compute_units / m_cpu_sub_devices, 1);
+            const cl_device_partition_property properties[] = {
+                CL_DEVICE_PARTITION_EQUALLY,
+                static_cast<cl_device_partition_property>(units_per_sub_device),
+                0
+            };
+
+            std::vector<cl::Device> sub_devices;
+            try
+            {
+                cl::Device parent = device;
+                parent.createSubDevices(properties, &sub_devices);
+            }
+            catch (const cl::Error&)
+            {
+                // The device cannot be partitioned, so it is used as a whole.
+                sub_devices.clear();
+            }
+
+            if (!sub_devices.empty())
+            {
+                for (const auto& sub_device : sub_devices)
+                {
+                    m_gpu_devices.emplace_back(Get_Number_Of_Slots(sub_device), sub_device);
+                }
+                return;
+            }
+        }
+
+        m_gpu_devices.emplace_back(Get_Number_Of_Slots(device), device);
+    }
+
+    uint32_t CResource_Manager::Get_Number_Of_Slots(const cl::Device& device) const
+    {
+        // The user has entered the number of slots.
+        if (0 != m_queues_per_device)
+        {
+            return m_queues_per_device;
+        }
+
+        // CPU devices share the cores with the worker threads, so one queue is enough.
+        if (CL_DEVICE_TYPE_CPU == (device.getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_CPU))
+        {
+            return 1;
+        }
+
+        // A large device needs more queues to be kept busy.
+        const cl_uint compute_units = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+        return std::clamp<uint32_t>(compute_units / config::processing::Compute_Units_Per_Queue, 1, config::processing::Max_Queues_Per_Device);
+    }
+
     void CResource_Manager::Print_Found_Devs(const std::unordered_set<std::string>& found_devices,
                                              const std::unordered_set<std::string>& listed_devices)
     {
@@ -131,11 +197,11 @@ namespace kiv_ppr
     const cl::Device* CResource_Manager::Get_Available_Device()
     {
         const std::lock_guard<std::mutex> lock(m_mtx);
-        for (auto& [status, device] : m_gpu_devices)
+        for (auto& [slots, taken, device] : m_gpu_devices)
         {
-            if (NDevice_Status::Available == status)
+            if (taken < slots)
             {
-                status = NDevice_Status::Taken;
+                ++taken;
                 return &device;
             }
         }
@@ -145,15 +211,40 @@ namespace kiv_ppr
     void CResource_Manager::Release_Device(const cl::Device* device)
     {
         const std::lock_guard<std::mutex> lock(m_mtx);
-        for (auto& [status, m_device] : m_gpu_devices)
+        for (auto& [slots, taken, m_device] : m_gpu_devices)
         {
-            if (&m_device == device)
+            if (&m_device == device && taken > 0)
             {
-                status = NDevice_Status::Available;
+                --taken;
             }
         }
     }
 
+    uint32_t CResource_Manager::Get_Number_Of_Workers(uint32_t number_of_threads)
+    {
+        const std::lock_guard<std::mutex> lock(m_mtx);
+
+        // Each slot of a device is fed by a worker of its own.
+        uint32_t number_of_devices = 0;
+        for (const auto& resource : m_gpu_devices)
+        {
+            number_of_devices += resource.m_slots;
+        }
+
+        switch (m_run_type)
+        {
+            case CArg_Parser::NRun_Type::All:
+                return number_of_threads + number_of_devices;
+
+            case CArg_Parser::NRun_Type::OpenCL_Devs:
+                return number_of_devices;
+
+            case CArg_Parser::NRun_Type::SMP: [[fallthrough]];
+            default:
+                return number_of_threads;
+        }
+    }
+
     CArg_Parser::NRun_Type CResource_Manager::Get_Run_Type() const noexcept
     {
         return m_run_type;
@@ -12,7 +12,9 @@ namespace kiv_ppr
     /// \author Jakub Silhavy
     ///
     /// The purpose of this class is to hand out OpenCL devices 
-    /// to worker threads. This class is used as a singleton (see singleton.h).
+    /// to worker threads. Each device has a number of slots (concurrent command queues), so several
+    /// worker threads can feed one large device. CPU OpenCL devices can also be partitioned into sub-devices,
+    /// each of which is handed out on its own. This class is used as a singleton (see singleton.h).
     class CResource_Manager
     {
     public:
@@ -28,19 +30,32 @@ namespace kiv_ppr
         /// \param use_gpu_only Whether or not the program should only use GPUs as OpenCL devices.
         void Set_Run_Type(CArg_Parser::NRun_Type run_type, bool use_gpu_only) noexcept;
 
+        /// Sets how many worker threads can use one OpenCL device and how CPU OpenCL devices are partitioned.
+        /// It has to be called before the devices are found.
+        /// \param queues_per_device Number of slots (concurrent command queues) per device, 0 = detected by the compute units of the device
+        /// \param cpu_sub_devices Number of sub-devices a CPU OpenCL device is partitioned into, 0 or 1 = no partitioning
+        void Set_Device_Slots(uint32_t queues_per_device, uint32_t cpu_sub_devices) noexcept;
+
         /// Finds available OpenCL devices.
         /// \param listed_devices List of OpenCL devices the user entered into the program.
         void Find_Available_GPUs(const std::unordered_set<std::string>& listed_devices);
 
-        /// Finds an available OpenCL device and returns it to the caller.
+        /// Finds an OpenCL device with a free slot and returns it to the caller.
         /// \return Available OpenCL device, if it exists. Otherwise, nullptr.
         [[nodiscard]] const cl::Device* Get_Available_Device();
 
         /// Releases an OpenCL device.
         /// This method is called when the worker thread does not need the device anymore.
-        /// \param device OpenCL device to be released (marked as available again).
+        /// \param device OpenCL device to be released (its slot is marked as available again).
         void Release_Device(const cl::Device* device);
         
+        /// Returns how many workers should process the input file. Each slot of an OpenCL device is fed by a worker of its own.
+        /// The feeding workers spend most of the time waiting for their devices, so in the 'all' mode they are added
+        /// on top of the CPU workers instead of taking their place. In the mode with listed devices, only the feeding workers are needed.
+        /// \param number_of_threads Number of CPU threads the user wishes to use
+        /// \return Number of workers
+        [[nodiscard]] uint32_t Get_Number_Of_Workers(uint32_t number_of_threads);
+
         /// Returns the run type of the program (mode - all, smp, ...)
         /// \return Mode of the program
         [[nodiscard]] CArg_Parser::NRun_Type Get_Run_Type() const noexcept;
@@ -53,24 +68,28 @@ namespace kiv_ppr
         void Print_Found_Devs(const std::unordered_set<std::string>& found_devices,
                               const std::unordered_set<std::string>& listed_devices);
 
-    private:
-        /// Status of an OpenCL device
-        enum class NDevice_Status : uint8_t
-        {
-            Available, ///< Free (ready to be used)
-            Taken      ///< Being used by a worker thread
-        };
+        /// Adds a device into the list of devices to be used by the program. A CPU device is partitioned
+        /// into sub-devices first (if the user wishes so and the device supports it).
+        /// \param device OpenCL device
+        void Add_Device(const cl::Device& device);
+
+        /// Returns how many slots (concurrent command queues) a device has.
+        /// \param device OpenCL device
+        /// \return Number of slots
+        [[nodiscard]] uint32_t Get_Number_Of_Slots(const cl::Device& device) const;
 
-        /// Resource (OpenCL device + its status)
+    private:
+        /// Resource (OpenCL device + its slots)
         struct TResource
         {
-            NDevice_Status m_status; ///< Status of the OpenCL device
-            cl::Device m_device;     ///< OpenCL device
+            uint32_t m_slots;    ///< Number of worker threads that can use the OpenCL device at the same time
+            uint32_t m_taken;    ///< Number of slots being used by worker threads
+            cl::Device m_device; ///< OpenCL device
 
             /// Creates an instance of the struct 
-            /// \param status Status of the OpenCL device
+            /// \param slots Number of worker threads that can use the OpenCL device at the same time
             /// \param device OpenCL device
-            TResource(NDevice_Status status, cl::Device device);
+            TResource(uint32_t slots, cl::Device device);
         };
 
     private:
@@ -78,6 +97,8 @@ namespace kiv_ppr
         CArg_Parser::NRun_Type m_run_type{};  ///< Mode of the program (all, smp, ...)
         std::mutex m_mtx;                     ///< Mutex used when a device is being allocated/released
         bool m_use_gpu_only = false;          ///< Whether or not the program should use only GPUs as OpenCL devices.
+        uint32_t m_queues_per_device = 0;     ///< Number of slots per device (0 = detected by the compute units of the device)
+        uint32_t m_cpu_sub_devices = 0;       ///< Number of sub-devices a CPU OpenCL device is partitioned into
     };
 }
 
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+#include <future>
+#include <cstddef>
+#include <iostream>
+
+#include "singleton.h"
+#include "thread_pool.h"
+
+namespace kiv_ppr
+{
+    /// \author Jakub Silhavy
+    /// \tparam T Type of the results of a worker
+    ///
+    /// This class represents preallocated slots the workers publish their results into (one slot per worker).
+    /// Each slot takes up whole cache lines and a worker only ever writes into its own slot, so no lock is needed
+    /// and the workers do not slow each other down (false sharing). The farmer reads the slots once all workers
+    /// have finished (waiting for their futures orders the writes before the reads). The slots are merged using
+    /// a parallel tree reduction executed by the thread pool, so the merge takes log2(workers) rounds of merges instead
+    /// of the workers waiting for each other to merge their results into the farmer's one by one.
+    template<typename T>
+    class CResult_Slots
+    {
+    public:
+        /// Creates an instance of the class.
+        /// \param count Number of slots (workers)
+        explicit CResult_Slots(size_t count)
+            : m_slots(count)
+        {
+
+        }
+
+        /// Default destructor.
+        ~CResult_Slots() = default;
+
+        /// Delete copy constructor.
+        CResult_Slots(const CResult_Slots&) = delete;
+
+        /// Delete assignment operator.
+        CResult_Slots& operator=(const CResult_Slots&) = delete;
+
+        /// Publishes the results of a worker into its slot.
+        /// \param index Index of the slot (worker)
+        /// \param values Results of the worker
+        void Publish(size_t index, T values)
+        {
+            auto& slot = m_slots.at(index);
+            slot.values = std::move(values);
+            slot.published = true;
+        }
+
+        /// Merges the results of all workers that have published them (it must be called once the workers have finished).
+        /// The merges of each round of the reduction are executed in parallel by the thread pool.
+        /// \tparam Merge Type of the function merging two results
+        /// \param merge Function merging the second result into the first one (merge(dest, src))
+        /// \return Pointer to the merged results, nullptr if no worker has published its results.
+        template<typename Merge>
+        [[nodiscard]] T* Reduce(Merge merge)
+        {
+            // Make sure that the thread pool is not NULL.
+            auto thread_pool = Singleton<CThread_Pool>::Get_Instance();
+            if (nullptr == thread_pool)
+            {
+                std::cout << "Error: thread pool is NULL" << std::endl;
+                std::exit(24);
+            }
+
+            // Slots of the workers that have published their results (e.g. a worker without an OpenCL device may not).
+            std::vector<T*> results;
+            for (auto& slot : m_slots)
+            {
+                if (slot.published)
+                {
+                    results.push_back(&slot.values);
+                }
+            }
+            if (results.empty())
+            {
+                return nullptr;
+            }
+
+            // In each round, every other remaining result is merged into its left neighbour.
+            for (size_t stride = 1; stride < results.size(); stride *= 2)
+            {
+                std::vector<std::future<void>> merges;
+                for (size_t i = 0; i + stride < results.size(); i += 2 * stride)
+                {
+                    merges.push_back(thread_pool->Submit([&merge](T* dest, const T* src) { merge(*dest, *src); }, results[i], results[i + stride]));
+                }
+                for (auto& pending_merge : merges)
+                {
+                    pending_merge.get();
+                }
+            }
+
+            return results.front();
+        }
+
+    private:
+        /// Slot of one worker (it takes up its own cache lines).
+        struct alignas(64) TSlot
+        {
+            T values{};             ///< Results of the worker
+            bool published = false; ///< Flag indicating whether the worker has published its results
+        };
+
+    private:
+        std::vector<TSlot> m_slots; ///< Slots of the workers
+    };
+}
+
+// EOF
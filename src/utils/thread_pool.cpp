@@ -0,0 +1,145 @@
+#include <algorithm>
+
+#include "thread_pool.h"
+
+namespace kiv_ppr
+{
+    /// Index of the current thread within the pool (-1 for threads outside of the pool).
+    static thread_local int64_t t_worker_index = -1;
+
+    CThread_Pool::CThread_Pool()
+        : m_number_of_threads(0),
+          m_next_queue(0),
+          m_pending(0),
+          m_stop(false)
+    {
+        m_queues.reserve(Max_Threads);
+        m_threads.reserve(Max_Threads);
+    }
+
+    CThread_Pool::~CThread_Pool()
+    {
+        {
+            const std::lock_guard<std::mutex> lock(m_mtx);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+
+        for (auto& thread : m_threads)
+        {
+            // The program may be terminated (std::exit) from within the pool,
+            // in which case the threads cannot be waited for.
+            if (t_worker_index >= 0)
+            {
+                thread.detach();
+            }
+            else
+            {
+                thread.join();
+            }
+        }
+    }
+
+    void CThread_Pool::Ensure_Threads(uint32_t number_of_threads)
+    {
+        const std::lock_guard<std::mutex> lock(m_mtx);
+
+        number_of_threads = std::min(number_of_threads, Max_Threads);
+        while (m_number_of_threads < number_of_threads)
+        {
+            // The queue has to exist before any thread may try to steal from it.
+            const size_t index = m_queues.size();
+            m_queues.push_back(std::make_unique<TWorker_Queue>());
+            m_threads.emplace_back(&CThread_Pool::Run_Worker, this, index);
+            ++m_number_of_threads;
+        }
+    }
+
+    uint32_t CThread_Pool::Get_Number_Of_Threads() const noexcept
+    {
+        return m_number_of_threads;
+    }
+
+    void CThread_Pool::Enqueue(std::function<void()> task)
+    {
+        // There has to be at least one thread to execute the task.
+        if (0 == m_number_of_threads)
+        {
+            Ensure_Threads(1);
+        }
+
+        // A task submitted from within the pool goes to the queue of the current thread.
+        const size_t index = t_worker_index >= 0 ? static_cast<size_t>(t_worker_index) : m_next_queue++ % m_number_of_threads;
+        {
+            auto& queue = *m_queues[index];
+            const std::lock_guard<std::mutex> lock(queue.mtx);
+            queue.tasks.push_back(std::move(task));
+        }
+        {
+            const std::lock_guard<std::mutex> lock(m_mtx);
+            ++m_pending;
+        }
+        m_cv.notify_one();
+    }
+
+    bool CThread_Pool::Try_Take(size_t index, std::function<void()>& task)
+    {
+        // Take the most recently added task of the thread's own queue first.
+        {
+            auto& queue = *m_queues[index];
+            const std::lock_guard<std::mutex> lock(queue.mtx);
+            if (!queue.tasks.empty())
+            {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+                return true;
+            }
+        }
+
+        // Steal the oldest task of another thread.
+        const size_t number_of_queues = m_number_of_threads;
+        for (size_t i = 1; i < number_of_queues; ++i)
+        {
+            auto& queue = *m_queues[(index + i) % number_of_queues];
+            const std::lock_guard<std::mutex> lock(queue.mtx);
+            if (!queue.tasks.empty())
+            {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void CThread_Pool::Run_Worker(size_t index)
+    {
+        t_worker_index = static_cast<int64_t>(index);
+
+        while (true)
+        {
+            // Wait until there is a task to be executed.
+            {
+                std::unique_lock<std::mutex> lock(m_mtx);
+                m_cv.wait(lock, [&]() {
+                    return m_stop || m_pending > 0;
+                });
+                if (m_stop)
+                {
+                    return;
+                }
+                --m_pending;
+            }
+
+            // A task is reserved for us, but it may be sitting in the queue of another thread.
+            std::function<void()> task;
+            while (!Try_Take(index, task))
+            {
+                std::this_thread::yield();
+            }
+            task();
+        }
+    }
+}
+
+// EOF
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+
+namespace kiv_ppr
+{
+    /// \author Jakub Silhavy
+    ///
+    /// This class represents a process-wide pool of threads that lives for the whole
+    /// run of the program. It is shared by both iterations over the input file as well as
+    /// the Chi-Square tests, so no threads are created on the critical path. Each thread has
+    /// a queue of its own. Tasks submitted from outside of the pool are spread over the queues
+    /// and an idle thread steals tasks from the queues of other threads (work stealing).
+    /// Because the threads are long-lived, they can keep state across phases (see kernels::Get_Worker_OpenCL).
+    /// This class is used as a singleton (see singleton.h).
+    class CThread_Pool
+    {
+    public:
+        /// Creates an instance of the class (no threads are created yet).
+        CThread_Pool();
+
+        /// Stops all the threads.
+        ~CThread_Pool();
+
+        /// Delete copy constructor.
+        CThread_Pool(const CThread_Pool&) = delete;
+
+        /// Delete assignment operator.
+        CThread_Pool& operator=(const CThread_Pool&) = delete;
+
+        /// Makes sure the pool has at least the given number of threads.
+        /// \param number_of_threads Minimum number of threads
+        void Ensure_Threads(uint32_t number_of_threads);
+
+        /// Returns the number of threads of the pool.
+        /// \return Number of threads
+        [[nodiscard]] uint32_t Get_Number_Of_Threads() const noexcept;
+
+        /// Submits a task into the pool.
+        /// \tparam F Type of the function to be called
+        /// \tparam Args Types of the arguments of the function
+        /// \param function Function to be called
+        /// \param args Arguments of the function
+        /// \return Future holding the return value of the function.
+        template<typename F, typename... Args>
+        [[nodiscard]] auto Submit(F&& function, Args&&... args) -> std::future<std::invoke_result_t<F, Args...>>
+        {
+            using Result_t = std::invoke_result_t<F, Args...>;
+
+            auto task = std::make_shared<std::packaged_task<Result_t()>>(
+                std::bind(std::forward<F>(function), std::forward<Args>(args)...)
+            );
+            auto future = task->get_future();
+            Enqueue([task]() {
+                (*task)();
+            });
+            return future;
+        }
+
+    private:
+        /// Queue of tasks of one thread.
+        struct TWorker_Queue
+        {
+            std::mutex mtx;                           ///< Mutex guarding the queue
+            std::deque<std::function<void()>> tasks;  ///< Tasks waiting to be executed
+        };
+
+    private:
+        /// Inserts a task into one of the queues and wakes up a thread.
+        /// \param task Task to be executed
+        void Enqueue(std::function<void()> task);
+
+        /// Takes a task out of the thread's own queue or steals one from another queue.
+        /// \param index Index of the thread
+        /// \param task Taken task
+        /// \return true, if a task has been taken, false if all queues are empty.
+        [[nodiscard]] bool Try_Take(size_t index, std::function<void()>& task);
+
+        /// Run function of a thread of the pool.
+        /// \param index Index of the thread
+        void Run_Worker(size_t index);
+
+    private:
+        /// Maximum number of threads (the queues are never reallocated, so the threads can access them without a lock).
+        static constexpr uint32_t Max_Threads = 4096;
+
+    private:
+        std::vector<std::unique_ptr<TWorker_Queue>> m_queues; ///< Queues of the threads
+        std::vector<std::thread> m_threads;                   ///< Threads of the pool
+        std::atomic<uint32_t> m_number_of_threads;            ///< Number of threads (and queues) that have been started
+        std::atomic<uint32_t> m_next_queue;                   ///< Queue the next task from outside of the pool goes to (round robin)
+        std::mutex m_mtx;                                     ///< Mutex used when the threads go to sleep
+        std::condition_variable m_cv;                         ///< Signaled when a task is submitted
+        size_t m_pending;                                     ///< Number of tasks waiting to be executed
+        bool m_stop;                                          ///< Flag indicating that the threads should finish
+    };
+}
+
+// EOF
@@ -1,48 +1,147 @@
+#include <thread>
+#include <vector>
+#include <sstream>
+#include <filesystem>
+
 #include "utils.h"
+#include "../config.h"
 
 namespace kiv_ppr::utils
 {
-    bool Is_Valid_Double(double value) noexcept
+    namespace vectorization
     {
-        const auto type = std::fpclassify(value);
-        return type == FP_NORMAL || type == FP_ZERO;
+        __m256d Create_4Doubles(std::array<double, 4>& data, const std::size_t offset, double value)
+        {
+            for (std::size_t i = offset; i < 4; ++i)
+            {
+                data.at(i) = value;
+            }
+
+            return _mm256_set_pd(
+                data.at(0),
+                data.at(1),
+                data.at(2),
+                data.at(3)
+            );
+        }
     }
 
-    namespace vectorization
+    namespace serialization
     {
-        double Aggregate(const __m256d& vals, double default_value, std::function<double(double, double)> fce)
+        uint64_t Hash(const char* data, std::size_t size, uint64_t hash) noexcept
         {
-            double result = default_value;
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                hash ^= static_cast<unsigned char>(data[i]);
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
 
-#pragma warning(disable:26490)
-            // So we have access, to individual values.
-            const auto raw_values = reinterpret_cast<const double*>(&vals);
-#pragma warning(default:26490)
+        bool Hash_File_Samples(const std::string& filename, uint64_t offset, uint64_t size, uint64_t& hash)
+        {
+            std::ifstream file(filename, std::ios::binary);
+            if (!file)
+            {
+                return false;
+            }
 
-            // Aggregate the values.
-            for (std::size_t i = 0; i < 4; ++i)
+            constexpr uint64_t samples = config::processing::Content_Hash_Samples;
+            constexpr uint64_t sample_size = config::processing::Content_Hash_Sample_Size;
+            std::vector<char> buffer(sample_size);
+            hash = Hash_Offset_Basis;
+
+            // The part is small enough to be hashed as a whole.
+            if (size <= samples * sample_size)
             {
-                result = fce(result, raw_values[i]);
+                file.seekg(static_cast<std::streamoff>(offset));
+                for (uint64_t remaining = size; remaining > 0;)
+                {
+                    const auto count = static_cast<std::streamsize>(std::min<uint64_t>(remaining, sample_size));
+                    if (!file.read(buffer.data(), count))
+                    {
+                        return false;
+                    }
+                    hash = Hash(buffer.data(), static_cast<std::size_t>(count), hash);
+                    remaining -= static_cast<uint64_t>(count);
+                }
+                return true;
             }
 
-            return result;
+            // The samples are spread evenly, so the first one starts at the beginning of the part and the last one ends at its end.
+            const uint64_t gap = (size - sample_size) / (samples - 1);
+            for (uint64_t i = 0; i < samples; ++i)
+            {
+                const uint64_t sample_offset = (samples - 1 == i) ? (size - sample_size) : (i * gap);
+                file.seekg(static_cast<std::streamoff>(offset + sample_offset));
+                if (!file.read(buffer.data(), static_cast<std::streamsize>(buffer.size())))
+                {
+                    return false;
+                }
+                hash = Hash(buffer.data(), buffer.size(), hash);
+            }
+            return true;
         }
 
-        __m256d Create_4Doubles(std::array<double, 4>& data, const std::size_t offset, double value)
+        bool Load_File(const std::string& path, std::string& data)
         {
-            for (std::size_t i = offset; i < 4; ++i)
+            std::ifstream file(path, std::ios::binary);
+            if (!file)
             {
-                data.at(i) = value;
+                return false;
             }
 
-            return _mm256_set_pd(
-                data.at(0),
-                data.at(1),
-                data.at(2),
-                data.at(3)
-            );
+            std::ostringstream content;
+            content << file.rdbuf();
+            if (file.bad())
+            {
+                return false;
+            }
+
+            data = content.str();
+            return true;
+        }
+
+        bool Store_File(const std::string& path, const std::string& data)
+        {
+            // Each thread writes into a temporary file of its own.
+            std::ostringstream tmp_path;
+            tmp_path << path << "." << std::hash<std::thread::id>{}(std::this_thread::get_id()) << ".tmp";
+
+            {
+                std::ofstream file(tmp_path.str(), std::ios::binary | std::ios::trunc);
+                if (!file)
+                {
+                    return false;
+                }
+
+                file.write(data.data(), static_cast<std::streamsize>(data.size()));
+                if (!file)
+                {
+                    file.close();
+                    std::error_code error;
+                    std::filesystem::remove(tmp_path.str(), error);
+                    return false;
+                }
+            }
+
+            // Replace the file by the temporary file (renaming may fail if the file exists, so it is removed and the renaming is retried).
+            std::error_code error;
+            std::filesystem::rename(tmp_path.str(), path, error);
+            if (error)
+            {
+                std::filesystem::remove(path, error);
+                std::filesystem::rename(tmp_path.str(), path, error);
+            }
+            if (error)
+            {
+                std::filesystem::remove(tmp_path.str(), error);
+                return false;
+            }
+
+            return true;
         }
     }
 }
 
-// EOF
\ No newline at end of file
+// EOF
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <bit>
 #include <cstddef>
 #include <string>
 #include <array>
@@ -7,7 +8,9 @@
 #include <random>
 #include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <type_traits>
 #include <functional>
 #include <immintrin.h>
 
@@ -69,24 +72,162 @@ namespace kiv_ppr::utils
         return std::chrono::duration_cast<std::chrono::seconds>(end_time - start_time).count();
     }
 
-    /// Check if a value is a valid double or not.
+    /// Measures how much time it takes to execute a function given as a parameter (with a sub-second precision).
+    /// \tparam Function Type of the function
+    /// \param function Function to be called
+    /// \return Number of milliseconds it took to call the function
+    template<typename Function>
+    double Time_Call_Ms(Function&& function)
+    {
+        const auto start_time = std::chrono::steady_clock::now();
+        function();
+        const auto end_time = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double, std::milli>(end_time - start_time).count();
+    }
+
+    /// Mask of the exponent of a double.
+    static constexpr uint64_t Double_Exponent_Mask = 0x7FF0000000000000ULL;
+
+    /// Mask of everything but the sign of a double.
+    static constexpr uint64_t Double_Abs_Mask = 0x7FFFFFFFFFFFFFFFULL;
+
+    /// Check if a value is a valid double or not (a normal number or a zero).
+    /// The exponent bits are tested directly, so the check is cheap enough for the hot loops.
     /// \param value Value to be tested
     /// \return true, if the value is a valid double, false otherwise.
-    bool Is_Valid_Double(double value) noexcept;
+    inline bool Is_Valid_Double(double value) noexcept
+    {
+        const auto bits = std::bit_cast<uint64_t>(value);
+        const uint64_t exponent = bits & Double_Exponent_Mask;
+
+        // Infinities and NaNs have all exponent bits set, subnormal numbers have none of them set (but they are not zeros).
+        return exponent != Double_Exponent_Mask && (exponent != 0 || (bits & Double_Abs_Mask) == 0);
+    }
 
     namespace vectorization
     {
-        /// Aggregates results calculated using SIMD instructions.
+        /// Aggregates results calculated using SIMD instructions. The function is a template parameter,
+        /// so it can be inlined (e.g. a lambda) into the hot loops of the CPU kernels.
         /// \vals Resluts (final values)
         /// \default_value Default value of the final aggregation
         /// \fce Function used to aggregate the values
-        double Aggregate(const __m256d& vals, double default_value, std::function<double(double, double)> fce);
+        template<typename Function>
+        inline double Aggregate(const __m256d& vals, double default_value, Function fce)
+        {
+            double result = default_value;
+
+            // So we have access, to individual values.
+            alignas(32) double raw_values[4];
+            _mm256_store_pd(raw_values, vals);
+
+            // Aggregate the values.
+            for (std::size_t i = 0; i < 4; ++i)
+            {
+                result = fce(result, raw_values[i]);
+            }
+
+            return result;
+        }
 
         /// Creates an __m256d (four doubles) - used for SIMD instructions.
         /// \data Data the __m256d will be created out of
         /// \offset Offset within the array (indexes higher than the offset are not used)
         /// \value Default value for the unused indexes
         __m256d Create_4Doubles(std::array<double, 4>& data, const std::size_t offset, double value);
+
+        /// Returns a mask of the valid doubles (see Is_Valid_Double) held by an __m256d. It tests the exponent
+        /// bits of all four values at once, so the values can be masked out without any branches.
+        /// \param vals Four doubles to be tested
+        /// \return Mask (all bits of a lane are set if the value is valid, none of them otherwise)
+        inline __m256d Get_Valid_Mask(const __m256d& vals) noexcept
+        {
+            const __m256i bits = _mm256_castpd_si256(vals);
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i exponent_mask = _mm256_set1_epi64x(static_cast<int64_t>(Double_Exponent_Mask));
+            const __m256i exponent = _mm256_and_si256(bits, exponent_mask);
+
+            // Infinities and NaNs (all exponent bits set) and subnormal numbers (no exponent bits set, but not a zero).
+            const __m256i inf_or_nan = _mm256_cmpeq_epi64(exponent, exponent_mask);
+            const __m256i no_exponent = _mm256_cmpeq_epi64(exponent, zero);
+            const __m256i is_zero = _mm256_cmpeq_epi64(_mm256_and_si256(bits, _mm256_set1_epi64x(static_cast<int64_t>(Double_Abs_Mask))), zero);
+            const __m256i invalid = _mm256_or_si256(inf_or_nan, _mm256_andnot_si256(is_zero, no_exponent));
+
+            return _mm256_castsi256_pd(_mm256_xor_si256(invalid, _mm256_set1_epi64x(-1)));
+        }
+
+        /// Returns a mask of the first count lanes of an __m256d (used to load the last values of a block).
+        /// \param count Number of lanes to be set (0-4)
+        /// \return Mask (all bits of the first count lanes are set)
+        inline __m256i Get_Lane_Mask(std::size_t count) noexcept
+        {
+            return _mm256_cmpgt_epi64(_mm256_set1_epi64x(static_cast<int64_t>(count)), _mm256_setr_epi64x(0, 1, 2, 3));
+        }
+    }
+
+    namespace serialization
+    {
+        /// Initial value of the 64-bit FNV-1a hash.
+        static constexpr uint64_t Hash_Offset_Basis = 14695981039346656037ULL;
+
+        /// Appends the bytes of a value to a sequence of bytes.
+        /// \tparam T Type of the value
+        /// \param data Sequence of bytes
+        /// \param value Value to be appended
+        template<typename T>
+        inline void Append(std::string& data, const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        /// Extracts a value from a sequence of bytes.
+        /// \tparam T Type of the value
+        /// \param data Sequence of bytes
+        /// \param offset Position of the value (it is moved past the value)
+        /// \param value Extracted value
+        /// \return true, if there are enough bytes left, false otherwise.
+        template<typename T>
+        [[nodiscard]] inline bool Extract(const std::string& data, std::size_t& offset, T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            if (offset > data.size() || data.size() - offset < sizeof(T))
+            {
+                return false;
+            }
+            std::memcpy(&value, data.data() + offset, sizeof(T));
+            offset += sizeof(T);
+            return true;
+        }
+
+        /// Calculates the 64-bit FNV-1a hash of a sequence of bytes.
+        /// \param data Sequence of bytes
+        /// \param size Number of bytes
+        /// \param hash Hash the bytes are added into (allows hashing in parts)
+        /// \return Hash of the bytes
+        [[nodiscard]] uint64_t Hash(const char* data, std::size_t size, uint64_t hash = Hash_Offset_Basis) noexcept;
+
+        /// Calculates the hash of evenly spaced samples of a part of a file (the first and the last one included).
+        /// If the part is smaller than all the samples put together (see config::processing::Content_Hash_Samples), it is hashed as a whole.
+        /// \param filename Path to the file
+        /// \param offset Offset of the first byte of the part
+        /// \param size Number of bytes of the part
+        /// \param hash Hash of the samples
+        /// \return true, if the samples have been read, false otherwise.
+        [[nodiscard]] bool Hash_File_Samples(const std::string& filename, uint64_t offset, uint64_t size, uint64_t& hash);
+
+        /// Reads a whole file into the memory.
+        /// \param path Path to the file
+        /// \param data Content of the file
+        /// \return true, if the file has been read, false otherwise.
+        [[nodiscard]] bool Load_File(const std::string& path, std::string& data);
+
+        /// Stores a sequence of bytes into a file. The bytes are written into a temporary file first, which then replaces
+        /// the file, so another process never reads a half-written file. If the bytes cannot be written, the file is left untouched.
+        /// \param path Path to the file
+        /// \param data Bytes to be stored
+        /// \return true, if the file has been stored, false otherwise.
+        [[nodiscard]] bool Store_File(const std::string& path, const std::string& data);
     }
 }
 